@@ -0,0 +1,98 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+// compare LuaPoolAlloc with general purpose allocator on lua workloads,
+// FMemory isn't available out of engine, so malloc is used as backend and baseline
+
+#include "lua.hpp"
+#include "LuaPoolAlloc.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace NS_SLUA;
+
+namespace {
+
+	void* alignedMalloc(size_t size, size_t align) {
+#ifdef _WIN32
+		return _aligned_malloc(size, align);
+#else
+		void* p = nullptr;
+		return posix_memalign(&p, align, size) == 0 ? p : nullptr;
+#endif
+	}
+
+	void alignedFree(void* ptr) {
+#ifdef _WIN32
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+
+	void* mallocAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+		if (nsize == 0) {
+			free(ptr);
+			return nullptr;
+		}
+		return realloc(ptr, nsize);
+	}
+
+	void* poolAlloc(void* ud, void* ptr, size_t osize, size_t nsize) {
+		return ((LuaPoolAlloc*)ud)->realloc(ptr, osize, nsize);
+	}
+
+	struct Workload {
+		const char* name;
+		const char* code;
+	};
+
+	const Workload workloads[] = {
+		{ "small tables",
+			"local t = {} for i = 1, 2000000 do t[i % 1000 + 1] = { x = i, y = i } end" },
+		{ "strings",
+			"local t = {} for i = 1, 1000000 do t[i % 1000 + 1] = 'key' .. i end" },
+		{ "closures",
+			"local t = {} for i = 1, 1000000 do t[i % 1000 + 1] = function() return i end end" },
+		{ "coroutines",
+			"for i = 1, 100000 do local co = coroutine.wrap(function(a) return a end) co(i) end" },
+	};
+
+	double run(lua_Alloc f, void* ud, const char* code) {
+		lua_State* L = lua_newstate(f, ud);
+		luaL_openlibs(L);
+		auto start = std::chrono::steady_clock::now();
+		if (luaL_dostring(L, code) != 0)
+			printf("error: %s\n", lua_tostring(L, -1));
+		lua_gc(L, LUA_GCCOLLECT, 0);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		lua_close(L);
+		return ms;
+	}
+}
+
+int main(int argc, char** argv) {
+	LuaPoolAlloc::Backend backend = { alignedMalloc, alignedFree,
+		[](void* ptr, size_t size) { return realloc(ptr, size); },
+		[](void* ptr) { free(ptr); } };
+
+	printf("%-16s %12s %12s %8s\n", "workload", "malloc(ms)", "pool(ms)", "speedup");
+	for (auto& w : workloads) {
+		double base = run(mallocAlloc, nullptr, w.code);
+		LuaPoolAlloc pool(backend);
+		double pooled = run(poolAlloc, &pool, w.code);
+		printf("%-16s %12.2f %12.2f %7.2fx\n", w.name, base, pooled, base / pooled);
+	}
+	return 0;
+}
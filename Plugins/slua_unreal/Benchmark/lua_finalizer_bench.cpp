@@ -0,0 +1,125 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+// cost of finalizing short lived binding userdata, like vectors and struct copies
+// created and dropped each frame, __gc metamethod vs native finalizer tag
+
+#include "lua.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace NS_SLUA;
+
+namespace {
+
+	// same layout as GenericUserData
+	struct Box {
+		unsigned int flag;
+		void* parent;
+		void* ud;
+	};
+
+	struct Vec {
+		float x, y, z;
+	};
+
+	const char* frameCode = R"(
+		local newVec = newVec
+		return function(n)
+			local sum = 0
+			for i = 1, n do
+				local v = newVec()
+				sum = sum + i
+			end
+			return sum
+		end
+	)";
+
+	const int Frames = 200;
+	const int PerFrame = 20000;
+	const int NativeTag = 1;
+
+	long finalized = 0;
+
+	double now() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	int newVec(lua_State* L) {
+		Box* box = (Box*)lua_newuserdata(L, sizeof(Box));
+		box->flag = 1;
+		box->parent = nullptr;
+		box->ud = new Vec();
+		luaL_setmetatable(L, "Vec");
+		return 1;
+	}
+
+	int gcVec(lua_State* L) {
+		Box* box = (Box*)lua_touserdata(L, 1);
+		delete (Vec*)box->ud;
+		finalized++;
+		return 0;
+	}
+
+	void finalizeVec(lua_State* L, int tag, void* ud) {
+		if (tag != NativeTag) return;
+		delete (Vec*)((Box*)ud)->ud;
+		finalized++;
+	}
+
+	void bench(const char* name, bool native) {
+		lua_State* L = luaL_newstate();
+		luaL_openlibs(L);
+		luaL_newmetatable(L, "Vec");
+		if (native) {
+			lua_setudfinalizer(L, finalizeVec);
+			lua_pushlightuserdata(L, (void*)(size_t)NativeTag);
+		}
+		else
+			lua_pushcfunction(L, gcVec);
+		lua_setfield(L, -2, "__gc");
+		lua_pop(L, 1);
+		lua_register(L, "newVec", newVec);
+		if (luaL_dostring(L, frameCode) != 0) {
+			printf("error: %s\n", lua_tostring(L, -1));
+			exit(1);
+		}
+		int frame = lua_gettop(L);
+
+		finalized = 0;
+		double gcMs = 0;
+		double start = now();
+		for (int i = 0; i < Frames; i++) {
+			lua_pushvalue(L, frame);
+			lua_pushinteger(L, PerFrame);
+			lua_call(L, 1, 0);
+			double gcStart = now();
+			// step like LuaState::Tick and finalize collected userdata in batch
+			lua_gc(L, LUA_GCSTEP, 0);
+			if (native) lua_finalizeud(L);
+			gcMs += now() - gcStart;
+		}
+		double total = now() - start;
+		lua_close(L);
+		printf("%-8s %10.2f %10.2f %12ld\n", name, total / Frames, gcMs / Frames, finalized);
+	}
+}
+
+int main(int argc, char** argv) {
+	printf("%d frames, %d userdata per frame\n", Frames, PerFrame);
+	printf("%-8s %10s %10s %12s\n", "", "frame ms", "step ms", "finalized");
+	bench("__gc", false);
+	bench("native", true);
+	return 0;
+}
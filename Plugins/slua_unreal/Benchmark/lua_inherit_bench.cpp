@@ -0,0 +1,193 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+
+// cost of calling a method and a field declared by root class on an object of derived class,
+// __base walk of findMember vs members flattened into derived metatable by finishType
+
+#include "lua.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace NS_SLUA;
+
+namespace {
+
+	const char* callCode = R"(
+		local obj = newObj()
+		return function(n)
+			local sum = 0
+			for i = 1, n do
+				sum = sum + obj:get() + obj.value
+			end
+			return sum
+		end
+	)";
+
+	// Derived3 -> Derived2 -> Derived1 -> Base
+	const char* chain[] = { "Base", "Derived1", "Derived2", "Derived3" };
+	const int Depth = sizeof(chain) / sizeof(chain[0]);
+	const int Calls = 5000000;
+
+	double now() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// same as findMember in LuaObject.cpp
+	int findMember(lua_State* L, const char* name) {
+		int popn = 0;
+		if ((++popn, lua_getfield(L, -1, name) != 0)) {
+			lua_remove(L, -2);
+			return 1;
+		}
+		else if ((++popn, lua_getfield(L, -2, ".get")) && (++popn, lua_getfield(L, -1, name))) {
+			lua_pushvalue(L, 1);
+			lua_call(L, 1, 1);
+			lua_remove(L, -2);
+			return 1;
+		}
+		lua_pop(L, popn);
+		lua_getfield(L, -1, "__base");
+		luaL_checktype(L, -1, LUA_TTABLE);
+		size_t cnt = lua_rawlen(L, -1);
+		for (size_t n = 0; n < cnt; n++) {
+			lua_geti(L, -1, n + 1);
+			const char* tn = lua_tostring(L, -1);
+			lua_pop(L, 1);
+			luaL_getmetatable(L, tn);
+			luaL_checktype(L, -1, LUA_TTABLE);
+			if (findMember(L, name)) return 1;
+		}
+		lua_remove(L, -2);
+		return 0;
+	}
+
+	int classIndex(lua_State* L) {
+		lua_getmetatable(L, 1);
+		const char* name = luaL_checkstring(L, 2);
+		if (!findMember(L, name))
+			luaL_error(L, "can't get %s", name);
+		lua_remove(L, -2);
+		return 1;
+	}
+
+	bool hasField(lua_State* L, int t, const char* k) {
+		bool has = lua_getfield(L, t, k) != LUA_TNIL;
+		lua_pop(L, 1);
+		return has;
+	}
+
+	// same as mergeAbsent and mergeMembers in LuaObject.cpp
+	void mergeAbsent(lua_State* L, int dst, int skip) {
+		lua_pushnil(L);
+		while (lua_next(L, -2)) {
+			if (lua_type(L, -2) == LUA_TSTRING) {
+				const char* k = lua_tostring(L, -2);
+				bool own = k[0] == '.' || (k[0] == '_' && k[1] == '_');
+				if (!own && !hasField(L, dst, k) && !(skip && hasField(L, skip, k))) {
+					lua_pushvalue(L, -2);
+					lua_pushvalue(L, -2);
+					lua_rawset(L, dst);
+				}
+			}
+			lua_pop(L, 1);
+		}
+	}
+
+	void mergeMembers(lua_State* L, int mt) {
+		int base = lua_gettop(L);
+		lua_getfield(L, mt, ".get");
+		int get = lua_gettop(L);
+		lua_getfield(L, mt, ".set");
+		int set = lua_gettop(L);
+		lua_pushvalue(L, base);
+		mergeAbsent(L, mt, get);
+		lua_pop(L, 1);
+		lua_getfield(L, base, ".get");
+		mergeAbsent(L, get, mt);
+		lua_pop(L, 1);
+		lua_getfield(L, base, ".set");
+		mergeAbsent(L, set, 0);
+		lua_settop(L, base);
+	}
+
+	int get(lua_State* L) {
+		lua_pushinteger(L, 1);
+		return 1;
+	}
+
+	int newObj(lua_State* L) {
+		lua_newuserdata(L, sizeof(void*));
+		luaL_setmetatable(L, chain[Depth - 1]);
+		return 1;
+	}
+
+	void registerChain(lua_State* L, bool flatten) {
+		for (int i = 0; i < Depth; i++) {
+			luaL_newmetatable(L, chain[i]);
+			lua_newtable(L);
+			if (i == 0) {
+				lua_pushcfunction(L, get);
+				lua_setfield(L, -2, "value");
+			}
+			lua_setfield(L, -2, ".get");
+			lua_newtable(L);
+			lua_setfield(L, -2, ".set");
+			lua_pushcfunction(L, classIndex);
+			lua_setfield(L, -2, "__index");
+			if (i == 0) {
+				lua_pushcfunction(L, get);
+				lua_setfield(L, -2, "get");
+			}
+			else {
+				lua_newtable(L);
+				lua_pushstring(L, chain[i - 1]);
+				lua_seti(L, -2, 1);
+				lua_setfield(L, -2, "__base");
+				if (flatten) {
+					luaL_getmetatable(L, chain[i - 1]);
+					mergeMembers(L, lua_gettop(L) - 1);
+					lua_pop(L, 1);
+				}
+			}
+			lua_pop(L, 1);
+		}
+	}
+
+	void bench(const char* name, bool flatten) {
+		lua_State* L = luaL_newstate();
+		luaL_openlibs(L);
+		registerChain(L, flatten);
+		lua_register(L, "newObj", newObj);
+		if (luaL_dostring(L, callCode) != 0) {
+			printf("error: %s\n", lua_tostring(L, -1));
+			exit(1);
+		}
+		double start = now();
+		lua_pushinteger(L, Calls);
+		lua_call(L, 1, 1);
+		double total = now() - start;
+		long long sum = lua_tointeger(L, -1);
+		lua_close(L);
+		printf("%-8s %10.2f %10.2f %12lld\n", name, total, total * 1e6 / Calls, sum);
+	}
+}
+
+int main(int argc, char** argv) {
+	printf("%d iterations, depth %d\n", Calls, Depth);
+	printf("%-8s %10s %10s %12s\n", "", "total ms", "ns/iter", "sum");
+	bench("walk", false);
+	bench("flat", true);
+	return 0;
+}
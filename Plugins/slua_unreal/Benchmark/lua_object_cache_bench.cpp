@@ -0,0 +1,169 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+// cost of keeping identity of pushed objects, weak "kv" registry table
+// vs LuaObjectCache dropped by native finalizer
+
+#include "lua.hpp"
+#include "LuaObjectCache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace NS_SLUA;
+
+namespace {
+
+	// same layout as GenericUserData
+	struct Box {
+		unsigned int flag;
+		void* parent;
+		void* ud;
+	};
+
+	const int Frames = 200;
+	// objects held by lua, like actors and components
+	const int Live = 100000;
+	// pushed each frame, most of them are cache hit
+	const int PerFrame = 50000;
+	// temporary objects pushed and dropped each frame
+	const int Temp = 5000;
+	const int NativeTag = 1;
+	const char* TypeName = "UObject";
+
+	bool native = false;
+	int cacheRef = LUA_NOREF;
+	LuaObjectCache cache;
+	// id of TypeName, see LuaObject::typeIdOf
+	const uint32_t typeId = 1;
+
+	double now() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	void finalizeBox(lua_State* L, int tag, void* ud) {
+		if (void* key = lua_touduservalue(ud))
+			cache.remove(key, ud);
+	}
+
+	bool getFromCache(lua_State* L, void* obj) {
+		if (native) {
+			void* ud = cache.find(obj, typeId);
+			return ud && lua_pushudata(L, ud);
+		}
+		lua_geti(L, LUA_REGISTRYINDEX, cacheRef);
+		lua_pushlightuserdata(L, obj);
+		lua_rawget(L, -2);
+		lua_remove(L, -2);
+		if (lua_isnil(L, -1)) {
+			lua_pop(L, 1);
+			return false;
+		}
+		// same as checkType
+		luaL_getmetafield(L, -1, "__name");
+		bool match = lua_isstring(L, -1) && strcmp(TypeName, lua_tostring(L, -1)) == 0;
+		lua_pop(L, 1);
+		if (match) return true;
+		lua_pop(L, 1);
+		return false;
+	}
+
+	void push(lua_State* L, void* obj) {
+		if (getFromCache(L, obj)) return;
+		Box* box = (Box*)lua_newuserdata(L, sizeof(Box));
+		box->flag = 0;
+		box->parent = nullptr;
+		box->ud = obj;
+		luaL_setmetatable(L, TypeName);
+		if (native) {
+			lua_pushlightuserdata(L, obj);
+			lua_setuservalue(L, -2);
+			cache.add(obj, typeId, box);
+			return;
+		}
+		lua_geti(L, LUA_REGISTRYINDEX, cacheRef);
+		lua_pushlightuserdata(L, obj);
+		lua_pushvalue(L, -3);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+	}
+
+	void bench(const char* name, bool useNative) {
+		native = useNative;
+		lua_State* L = luaL_newstate();
+		luaL_newmetatable(L, TypeName);
+		if (native) {
+			lua_setudfinalizer(L, finalizeBox);
+			lua_pushlightuserdata(L, (void*)(size_t)NativeTag);
+			lua_setfield(L, -2, "__gc");
+		}
+		lua_pop(L, 1);
+		lua_newtable(L);
+		lua_newtable(L);
+		lua_pushstring(L, "kv");
+		lua_setfield(L, -2, "__mode");
+		lua_setmetatable(L, -2);
+		cacheRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+		// fake object addresses
+		std::vector<char> objects(Live + Temp * Frames);
+		lua_createtable(L, Live, 0);
+		int holder = lua_gettop(L);
+		for (int i = 0; i < Live; i++) {
+			push(L, &objects[i]);
+			lua_rawseti(L, holder, i + 1);
+		}
+
+		unsigned seed = 1;
+		int mismatch = 0;
+		double gcMs = 0;
+		double start = now();
+		for (int f = 0; f < Frames; f++) {
+			for (int i = 0; i < PerFrame; i++) {
+				seed = seed * 1103515245u + 12345u;
+				int n = (seed >> 8) % Live;
+				push(L, &objects[n]);
+				lua_rawgeti(L, holder, n + 1);
+				if (!lua_rawequal(L, -1, -2)) mismatch++;
+				lua_pop(L, 2);
+			}
+			for (int i = 0; i < Temp; i++) {
+				push(L, &objects[Live + f * Temp + i]);
+				lua_pop(L, 1);
+			}
+			double gcStart = now();
+			lua_gc(L, LUA_GCSTEP, 0);
+			if (native) lua_finalizeud(L);
+			gcMs += now() - gcStart;
+		}
+		double total = now() - start;
+
+		double fullStart = now();
+		lua_gc(L, LUA_GCCOLLECT, 0);
+		if (native) lua_finalizeud(L);
+		double fullMs = now() - fullStart;
+		lua_close(L);
+		printf("%-8s %10.2f %10.2f %10.2f %10d\n", name, total / Frames, gcMs / Frames, fullMs, mismatch);
+		cache.clear();
+	}
+}
+
+int main(int argc, char** argv) {
+	printf("%d frames, %d live objects, %d pushed and %d temporary per frame\n", Frames, Live, PerFrame, Temp);
+	printf("%-8s %10s %10s %10s %10s\n", "", "frame ms", "step ms", "full gc ms", "mismatch");
+	bench("weak", false);
+	bench("native", true);
+	return 0;
+}
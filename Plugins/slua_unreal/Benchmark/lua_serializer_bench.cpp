@@ -0,0 +1,217 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+// round trip and throughput of LuaSerializer on pure lua data,
+// compared with serializing in lua by building source string and loading it back
+
+#include "lua.hpp"
+#include "LuaSerializer.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace NS_SLUA;
+
+namespace {
+
+	const char* setupCode = R"(
+		function makeSave(n)
+			local save = { version = 3, name = 'player', items = {}, quests = {} }
+			for i = 1, n do
+				save.items[i] = { id = i, count = i % 99, name = 'item_' .. i, bound = i % 3 == 0, weight = i * 0.25 }
+			end
+			for i = 1, n // 10 do
+				save.quests['quest_' .. i] = { step = i % 7, flags = { i, i + 1, i + 2 } }
+			end
+			return save
+		end
+
+		function makeNumbers(n)
+			local t = {}
+			for i = 1, n do t[i] = i % 2 == 0 and i or i + 0.5 end
+			return t
+		end
+
+		-- entities share archetypes and point back to parent and itself
+		function makeGraph(n)
+			local kinds = {}
+			for i = 1, 8 do kinds[i] = { kind = i, tags = { 'tag' .. i } } end
+			local nodes = {}
+			for i = 1, n do
+				local node = { id = i, kind = kinds[i % 8 + 1], parent = nodes[i // 2] }
+				node.self = node
+				nodes[i] = node
+			end
+			return nodes
+		end
+
+		local function equal(a, b, seen)
+			if type(a) ~= type(b) then return false end
+			if type(a) ~= 'table' then return a == b end
+			if seen[a] then return seen[a] == b end
+			seen[a] = b
+			for k, v in pairs(a) do
+				if type(k) ~= 'table' and not equal(v, b[k], seen) then return false end
+			end
+			for k in pairs(b) do
+				if type(k) ~= 'table' and a[k] == nil then return false end
+			end
+			return true
+		end
+		function deepEqual(a, b) return equal(a, b, {}) end
+
+		-- baseline, walk table in lua and build source string
+		local function dump(v, out)
+			local t = type(v)
+			if t == 'table' then
+				out[#out + 1] = '{'
+				for k, x in pairs(v) do
+					out[#out + 1] = '['
+					dump(k, out)
+					out[#out + 1] = ']='
+					dump(x, out)
+					out[#out + 1] = ','
+				end
+				out[#out + 1] = '}'
+			elseif t == 'string' then
+				out[#out + 1] = string.format('%q', v)
+			elseif math.type(v) == 'float' then
+				out[#out + 1] = string.format('%.17g', v)
+			else
+				out[#out + 1] = tostring(v)
+			end
+		end
+		function luaPack(v)
+			local out = { 'return ' }
+			dump(v, out)
+			return table.concat(out)
+		end
+		function luaUnpack(s)
+			return load(s)()
+		end
+	)";
+
+	struct Dataset {
+		const char* name;
+		const char* make;
+		// lua baseline can't handle shared reference
+		bool acyclic;
+	};
+
+	const Dataset datasets[] = {
+		{ "save game", "return makeSave(20000)", true },
+		{ "numbers", "return makeNumbers(200000)", true },
+		{ "graph", "return makeGraph(20000)", false },
+	};
+
+	const int Rounds = 10;
+
+	double now() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool check(lua_State* L, int a, int b) {
+		lua_getglobal(L, "deepEqual");
+		lua_pushvalue(L, a);
+		lua_pushvalue(L, b);
+		lua_call(L, 2, 1);
+		bool ok = lua_toboolean(L, -1) != 0;
+		lua_pop(L, 1);
+		return ok;
+	}
+
+	void benchSerializer(lua_State* L, const Dataset& d) {
+		int value = lua_gettop(L);
+		LuaSerializer s;
+
+		double start = now();
+		for (int i = 0; i < Rounds; i++) {
+			s.reset();
+			if (!s.pack(L, value)) {
+				printf("%-10s pack error: %s\n", d.name, s.error());
+				return;
+			}
+		}
+		double packMs = (now() - start) / Rounds;
+
+		start = now();
+		for (int i = 0; i < Rounds; i++) {
+			if (LuaSerializer::unpack(L, s.data(), s.size()) != 1) {
+				printf("%-10s unpack error: %s\n", d.name, lua_tostring(L, -1));
+				lua_settop(L, value);
+				return;
+			}
+			if (i < Rounds - 1) lua_pop(L, 1);
+		}
+		double unpackMs = (now() - start) / Rounds;
+
+		bool ok = check(L, value, value + 1);
+		lua_settop(L, value);
+		printf("%-10s %-10s %10zu %10.2f %10.2f %10s\n", d.name, "slua", s.size(), packMs, unpackMs, ok ? "ok" : "FAILED");
+	}
+
+	void benchLua(lua_State* L, const Dataset& d) {
+		int value = lua_gettop(L);
+		if (!d.acyclic) {
+			printf("%-10s %-10s %10s\n", d.name, "lua", "-");
+			return;
+		}
+
+		double start = now();
+		for (int i = 0; i < Rounds; i++) {
+			lua_settop(L, value);
+			lua_getglobal(L, "luaPack");
+			lua_pushvalue(L, value);
+			lua_call(L, 1, 1);
+		}
+		double packMs = (now() - start) / Rounds;
+		size_t size = lua_rawlen(L, -1);
+		int packed = lua_gettop(L);
+
+		start = now();
+		for (int i = 0; i < Rounds; i++) {
+			lua_settop(L, packed);
+			lua_getglobal(L, "luaUnpack");
+			lua_pushvalue(L, packed);
+			lua_call(L, 1, 1);
+		}
+		double unpackMs = (now() - start) / Rounds;
+
+		bool ok = check(L, value, -1);
+		lua_settop(L, value);
+		printf("%-10s %-10s %10zu %10.2f %10.2f %10s\n", d.name, "lua", size, packMs, unpackMs, ok ? "ok" : "FAILED");
+	}
+}
+
+int main(int argc, char** argv) {
+	lua_State* L = luaL_newstate();
+	luaL_openlibs(L);
+	if (luaL_dostring(L, setupCode) != 0) {
+		printf("error: %s\n", lua_tostring(L, -1));
+		return 1;
+	}
+
+	printf("%-10s %-10s %10s %10s %10s %10s\n", "data", "method", "bytes", "pack(ms)", "unpack(ms)", "roundtrip");
+	for (auto& d : datasets) {
+		if (luaL_dostring(L, d.make) != 0) {
+			printf("error: %s\n", lua_tostring(L, -1));
+			return 1;
+		}
+		benchSerializer(L, d);
+		benchLua(L, d);
+		lua_settop(L, 0);
+		lua_gc(L, LUA_GCCOLLECT, 0);
+	}
+	lua_close(L);
+	return 0;
+}
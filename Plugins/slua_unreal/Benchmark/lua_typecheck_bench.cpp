@@ -0,0 +1,151 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+// cost of validating self of a bound method, like DefLuaMethod in TestPerf.lua,
+// luaL_testudata by type name vs type id in userdata header with cached metatable,
+// and type id trusted without metatable for userdata with native finalizer tag
+
+#include "lua.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+using namespace NS_SLUA;
+
+namespace {
+
+	// same layout as GenericUserData
+	struct Box {
+		unsigned int flag;
+		unsigned int typeId;
+		void* parent;
+		void* ud;
+	};
+
+	struct Foo {
+		int value;
+	};
+
+	const char* callCode = R"(
+		local foo = newFoo()
+		return function(n)
+			local sum = 0
+			for i = 1, n do
+				sum = sum + foo:get()
+			end
+			return sum
+		end
+	)";
+
+	const int Calls = 10000000;
+	const unsigned int FooId = 7;
+	const int FooTag = 1;
+	int fooMetatableRef = LUA_NOREF;
+
+	double now() {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	int newFoo(lua_State* L) {
+		Box* box = (Box*)lua_newuserdata(L, sizeof(Box));
+		box->flag = 0;
+		box->typeId = FooId;
+		box->parent = nullptr;
+		box->ud = new Foo{ 1 };
+		luaL_setmetatable(L, "Foo");
+		return 1;
+	}
+
+	// same as old TypeName<T>::value(), string built every check
+	int getByName(lua_State* L) {
+		std::string tn("Foo");
+		Box* box = (Box*)luaL_testudata(L, 1, tn.c_str());
+		if (!box) luaL_error(L, "expect Foo");
+		lua_pushinteger(L, ((Foo*)box->ud)->value);
+		return 1;
+	}
+
+	// same as LuaObject::testudataById
+	int getById(lua_State* L) {
+		Box* box = nullptr;
+		if (lua_type(L, 1) == LUA_TUSERDATA && lua_rawlen(L, 1) >= sizeof(Box)) {
+			box = (Box*)lua_touserdata(L, 1);
+			if (box->typeId != FooId || !lua_getmetatable(L, 1))
+				box = nullptr;
+			else {
+				lua_rawgeti(L, LUA_REGISTRYINDEX, fooMetatableRef);
+				if (!lua_rawequal(L, -1, -2)) box = nullptr;
+				lua_pop(L, 2);
+			}
+		}
+		if (!box) luaL_error(L, "expect Foo");
+		lua_pushinteger(L, ((Foo*)box->ud)->value);
+		return 1;
+	}
+
+	// same as LuaObject::testudataById for binding userdata
+	int getByTag(lua_State* L) {
+		Box* box = nullptr;
+		if (lua_type(L, 1) == LUA_TUSERDATA && lua_rawlen(L, 1) >= sizeof(Box)
+			&& lua_getudtag(L, 1) == FooTag) {
+			box = (Box*)lua_touserdata(L, 1);
+			if (box->typeId != FooId) box = nullptr;
+		}
+		if (!box) luaL_error(L, "expect Foo");
+		lua_pushinteger(L, ((Foo*)box->ud)->value);
+		return 1;
+	}
+
+	void finalizeFoo(lua_State*, int, void* ud) {
+		delete (Foo*)((Box*)ud)->ud;
+	}
+
+	void bench(const char* name, lua_CFunction get, bool tagged = false) {
+		lua_State* L = luaL_newstate();
+		luaL_openlibs(L);
+		luaL_newmetatable(L, "Foo");
+		lua_pushvalue(L, -1);
+		lua_setfield(L, -2, "__index");
+		if (tagged) {
+			lua_setudfinalizer(L, finalizeFoo);
+			lua_pushlightuserdata(L, (void*)(size_t)FooTag);
+			lua_setfield(L, -2, "__gc");
+		}
+		lua_pushcfunction(L, get);
+		lua_setfield(L, -2, "get");
+		fooMetatableRef = luaL_ref(L, LUA_REGISTRYINDEX);
+		lua_register(L, "newFoo", newFoo);
+		if (luaL_dostring(L, callCode) != 0) {
+			printf("error: %s\n", lua_tostring(L, -1));
+			exit(1);
+		}
+		double start = now();
+		lua_pushinteger(L, Calls);
+		lua_call(L, 1, 1);
+		double total = now() - start;
+		long long sum = lua_tointeger(L, -1);
+		lua_close(L);
+		printf("%-8s %10.2f %10.2f %12lld\n", name, total, total * 1e6 / Calls, sum);
+	}
+}
+
+int main(int argc, char** argv) {
+	printf("%d method calls\n", Calls);
+	printf("%-8s %10s %10s %12s\n", "", "total ms", "ns/call", "sum");
+	bench("name", getByName);
+	bench("id", getById);
+	bench("tag", getByTag, true);
+	return 0;
+}
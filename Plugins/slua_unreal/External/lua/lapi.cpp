@@ -56,7 +56,9 @@ const char lua_ident[] =
 
 
 static TValue *index2addr (lua_State *L, int idx) {
-  CallInfo *ci = L->ci;
+  CallInfo *ci;
+  luai_apisync(L);  /* for functions reading stack without lua_lock */
+  ci = L->ci;
   if (idx > 0) {
     TValue *o = ci->func + idx;
     api_check(L, idx <= ci->top - (ci->func + 1), "unacceptable index");
@@ -156,6 +158,7 @@ LUA_API const lua_Number *lua_version (lua_State *L) {
 ** convert an acceptable stack index into an absolute index
 */
 LUA_API int lua_absindex (lua_State *L, int idx) {
+  luai_apisync(L);
   return (idx > 0 || ispseudo(idx))
          ? idx
          : cast_int(L->top - L->ci->func) + idx;
@@ -163,6 +166,7 @@ LUA_API int lua_absindex (lua_State *L, int idx) {
 
 
 LUA_API int lua_gettop (lua_State *L) {
+  luai_apisync(L);
   return cast_int(L->top - (L->ci->func + 1));
 }
 
@@ -1104,6 +1108,86 @@ LUA_API int lua_gc (lua_State *L, int what, int data) {
 }
 
 
+LUA_API void lua_setudfinalizer (lua_State *L, lua_UDFinalizer f) {
+  lua_lock(L);
+  G(L)->udfinalizer = f;
+  lua_unlock(L);
+}
+
+
+LUA_API int lua_getudtag (lua_State *L, int idx) {
+  StkId o = index2addr(L, idx);
+  if (!ttisfulluserdata(o)) return 0;
+  if (tofinalize(gcvalue(o))) return -1;
+  return uvalue(o)->fintag;
+}
+
+
+LUA_API void lua_setudtag (lua_State *L, int idx, int tag) {
+  StkId o = index2addr(L, idx);
+  api_check(L, ttisfulluserdata(o), "full userdata expected");
+  lua_lock(L);
+  uvalue(o)->fintag = cast(unsigned short, tag);
+  lua_unlock(L);
+}
+
+
+LUA_API int lua_pushudata (lua_State *L, void *p) {
+  Udata *u = cast(Udata *, cast(char *, p) - sizeof(UUdata));
+  lua_lock(L);  /* mark of u may be changed by collector before sync */
+  if (isdead(G(L), obj2gco(u))) {
+    lua_unlock(L);
+    return 0;
+  }
+  setuvalue(L, L->top, u);
+  api_incr_top(L);
+  lua_unlock(L);
+  return 1;
+}
+
+
+LUA_API void *lua_touduservalue (void *p) {
+  Udata *u = cast(Udata *, cast(char *, p) - sizeof(UUdata));
+  return (u->ttuv_ == LUA_TLIGHTUSERDATA) ? u->user_.p : NULL;
+}
+
+
+LUA_API void lua_setapisync (lua_State *L, lua_APISync f) {
+  G(L)->apisync = f;
+}
+
+
+LUA_API void lua_deferfinalizers (lua_State *L, int defer) {
+  lua_lock(L);
+  G(L)->gcdeferfin = cast_byte(defer != 0);
+  lua_unlock(L);
+}
+
+
+LUA_API int lua_callfinalizers (lua_State *L) {
+  int n;
+  lua_lock(L);
+  n = luaC_callfinalizers(L);
+  lua_unlock(L);
+  return n;
+}
+
+
+LUA_API lua_State *lua_getrunning (lua_State *L) {
+  lua_State *running = G(L)->running;
+  return (running != NULL) ? running : G(L)->mainthread;
+}
+
+
+LUA_API int lua_finalizeud (lua_State *L) {
+  int n;
+  lua_lock(L);
+  n = luaC_finalizeud(L);
+  lua_unlock(L);
+  return n;
+}
+
+
 
 /*
 ** miscellaneous functions
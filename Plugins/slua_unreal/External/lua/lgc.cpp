@@ -705,7 +705,17 @@ static void freeobj (lua_State *L, GCObject *o) {
     }
     case LUA_TTABLE: luaH_free(L, gco2t(o)); break;
     case LUA_TTHREAD: luaE_freethread(L, gco2th(o)); break;
-    case LUA_TUSERDATA: luaM_freemem(L, o, sizeudata(gco2u(o))); break;
+    case LUA_TUSERDATA: {
+      global_State *g = G(L);
+      if (gco2u(o)->fintag && g->udfinalizer) {
+        /* keep it for native finalizer, 'next' is free after sweep */
+        o->next = g->udpending;
+        g->udpending = o;
+        o->marked = cast_byte(WHITEBITS);  /* dead whatever current white is */
+      }
+      else luaM_freemem(L, o, sizeudata(gco2u(o)));
+      break;
+    }
     case LUA_TSHRSTR:
       luaS_remove(L, gco2ts(o));  /* remove it from hash table */
       luaM_freemem(L, o, sizelstring(gco2ts(o)->shrlen));
@@ -899,8 +909,16 @@ static void separatetobefnz (global_State *g, int all) {
 */
 void luaC_checkfinalizer (lua_State *L, GCObject *o, Table *mt) {
   global_State *g = G(L);
+  const TValue *tm = gfasttm(g, mt, TM_GC);
+  if (o->tt == LUA_TUSERDATA && tm != NULL && ttislightuserdata(tm) &&
+      !tofinalize(o)) {
+    /* light userdata as finalizer is tag of native finalizer,
+       object stays in 'allgc' */
+    gco2u(o)->fintag = cast(unsigned short, point2uint(pvalue(tm)));
+    return;
+  }
   if (tofinalize(o) ||                 /* obj. is already marked... */
-      gfasttm(g, mt, TM_GC) == NULL)   /* or has no finalizer? */
+      tm == NULL)                      /* or has no finalizer? */
     return;  /* nothing to be done */
   else {  /* move 'o' to 'finobj' list */
     GCObject **p;
@@ -918,6 +936,40 @@ void luaC_checkfinalizer (lua_State *L, GCObject *o, Table *mt) {
   }
 }
 
+/*
+** call native finalizer for userdata collected by sweep and free them,
+** finalizer shouldn't run lua code
+*/
+int luaC_finalizeud (lua_State *L) {
+  global_State *g = G(L);
+  int n = 0;
+  while (g->udpending != NULL) {
+    GCObject *o = g->udpending;
+    Udata *u = gco2u(o);
+    g->udpending = o->next;
+    if (g->udfinalizer)
+      g->udfinalizer(L, u->fintag, getudatamem(u));
+    luaM_freemem(L, o, sizeudata(u));
+    n++;
+  }
+  return n;
+}
+
+
+/*
+** call finalizers left by steps while 'gcdeferfin' is set; error in
+** finalizer is raised like in a step, remaining ones are kept
+*/
+int luaC_callfinalizers (lua_State *L) {
+  global_State *g = G(L);
+  int n = 0;
+  while (g->tobefnz) {
+    GCTM(L, 1);
+    n++;
+  }
+  return n;
+}
+
 /* }====================================================== */
 
 
@@ -972,6 +1024,7 @@ void luaC_freeallobjects (lua_State *L) {
   g->gckind = KGC_NORMAL;
   sweepwholelist(L, &g->finobj);
   sweepwholelist(L, &g->allgc);
+  luaC_finalizeud(L);
   sweepwholelist(L, &g->fixedgc);  /* collect fixed objects */
   lua_assert(g->strt.nuse == 0);
 }
@@ -1081,7 +1134,7 @@ static lu_mem singlestep (lua_State *L) {
       return 0;
     }
     case GCScallfin: {  /* call remaining finalizers */
-      if (g->tobefnz && g->gckind != KGC_EMERGENCY) {
+      if (g->tobefnz && g->gckind != KGC_EMERGENCY && !g->gcdeferfin) {
         int n = runafewfinalizers(L);
         return (n * GCFINALIZECOST);
       }
@@ -1140,7 +1193,8 @@ void luaC_step (lua_State *L) {
   else {
     debt = (debt / g->gcstepmul) * STEPMULADJ;  /* convert 'work units' to Kb */
     luaE_setdebt(g, debt);
-    runafewfinalizers(L);
+    if (!g->gcdeferfin)
+      runafewfinalizers(L);
   }
 }
 
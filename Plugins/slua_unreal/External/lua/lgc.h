@@ -143,6 +143,8 @@ LUAI_FUNC void luaC_barrier_ (lua_State *L, GCObject *o, GCObject *v);
 LUAI_FUNC void luaC_barrierback_ (lua_State *L, Table *o);
 LUAI_FUNC void luaC_upvalbarrier_ (lua_State *L, UpVal *uv);
 LUAI_FUNC void luaC_checkfinalizer (lua_State *L, GCObject *o, Table *mt);
+LUAI_FUNC int luaC_finalizeud (lua_State *L);
+LUAI_FUNC int luaC_callfinalizers (lua_State *L);
 LUAI_FUNC void luaC_upvdeccount (lua_State *L, UpVal *uv);
 
 } // end NS_SLUA
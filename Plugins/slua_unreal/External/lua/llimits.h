@@ -208,10 +208,11 @@ typedef unsigned long Instruction;
 
 /*
 ** macros that are executed whenever program enters the Lua core
-** ('lua_lock') and leaves the core ('lua_unlock')
+** ('lua_lock') and leaves the core ('lua_unlock');
+** entering calls 'apisync' of global state if it's set, see 'lua_setapisync'
 */
 #if !defined(lua_lock)
-#define lua_lock(L)	((void) 0)
+#define lua_lock(L)	luai_apisync(L)
 #define lua_unlock(L)	((void) 0)
 #endif
 
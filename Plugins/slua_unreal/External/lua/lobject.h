@@ -345,6 +345,7 @@ typedef union UTString {
 typedef struct Udata {
   CommonHeader;
   lu_byte ttuv_;  /* user value's tag */
+  unsigned short fintag;  /* tag of native finalizer, 0 if none */
   struct Table *metatable;
   size_t len;  /* number of bytes */
   union Value user_;  /* user value */
@@ -317,6 +317,11 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->strt.hash = NULL;
   setnilvalue(&g->l_registry);
   g->panic = NULL;
+  g->udfinalizer = NULL;
+  g->apisync = NULL;
+  g->udpending = NULL;
+  g->gcdeferfin = 0;
+  g->running = NULL;
   g->version = NULL;
   g->gcstate = GCSpause;
   g->gckind = KGC_NORMAL;
@@ -137,12 +137,17 @@ typedef struct global_State {
   GCObject *allweak;  /* list of all-weak tables */
   GCObject *tobefnz;  /* list of userdata to be GC */
   GCObject *fixedgc;  /* list of objects not to be collected */
+  GCObject *udpending;  /* collected userdata waiting native finalizer */
   struct lua_State *twups;  /* list of threads with open upvalues */
   unsigned int gcfinnum;  /* number of finalizers to call in each GC step */
+  lu_byte gcdeferfin;  /* steps don't call finalizers, see 'lua_deferfinalizers' */
   int gcpause;  /* size of pause between successive GCs */
   int gcstepmul;  /* GC 'granularity' */
   lua_CFunction panic;  /* to be called in unprotected errors */
+  lua_UDFinalizer udfinalizer;  /* called for userdata in 'udpending' */
+  lua_APISync apisync;  /* called when api is entered, if set */
   struct lua_State *mainthread;
+  struct lua_State *running;  /* innermost resumed coroutine, NULL if none */
   const lua_Number *version;  /* pointer to version number */
   TString *memerrmsg;  /* memory-error message */
   TString *tmname[TM_N];  /* array with tag-method names */
@@ -186,6 +191,8 @@ inline global_State* G(lua_State* L) {
   return L->l_G;
 }
 
+#define luai_apisync(L)	{ lua_APISync sync_ = G(L)->apisync; if (sync_) sync_(L); }
+
     /*
 ** Union of all collectable objects (only for conversions)
 */
@@ -241,6 +241,7 @@ Udata *luaS_newudata (lua_State *L, size_t s) {
   u = gco2u(o);
   u->len = s;
   u->metatable = NULL;
+  u->fintag = 0;
   setuservalue(L, u, luaO_nilobject);
   return u;
 }
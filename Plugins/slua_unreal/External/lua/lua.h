@@ -312,6 +312,52 @@ LUA_API int (lua_isyieldable) (lua_State *L);
 
 LUA_API int (lua_gc) (lua_State *L, int what, int data);
 
+/*
+** native finalizer: a light userdata as '__gc' of metatable is a tag,
+** userdata with the tag isn't resurrected when collected, it's kept in
+** a pending list and finalized in batch by 'lua_finalizeud'
+*/
+typedef void (*lua_UDFinalizer) (lua_State *L, int tag, void *ud);
+
+LUA_API void (lua_setudfinalizer) (lua_State *L, lua_UDFinalizer f);
+LUA_API int (lua_finalizeud) (lua_State *L);
+/* tag of userdata, -1 if it has a lua finalizer */
+LUA_API int (lua_getudtag) (lua_State *L, int idx);
+LUA_API void (lua_setudtag) (lua_State *L, int idx, int tag);
+/*
+** push userdata by its memory block, it's only safe for userdata with
+** tag, which memory isn't freed before its native finalizer called;
+** return 0 and push nothing if it had been collected
+*/
+LUA_API int (lua_pushudata) (lua_State *L, void *p);
+/* light userdata set by lua_setuservalue, NULL if not; for native finalizer */
+LUA_API void *(lua_touduservalue) (void *p);
+
+/*
+** api sync: function called whenever api is entered, e.g. host waits for
+** a collector step running on another thread, it's called on that thread
+** too; setting it doesn't call it, so it can be reset in itself
+*/
+typedef void (*lua_APISync) (lua_State *L);
+
+LUA_API void (lua_setapisync) (lua_State *L, lua_APISync f);
+
+/*
+** deferred finalizers: while set, collector steps don't call '__gc' of
+** collected objects, e.g. a step runs on another thread; they're called
+** by 'lua_callfinalizers', which returns count of finalizers called and
+** raises error of finalizer like a step
+*/
+LUA_API void (lua_deferfinalizers) (lua_State *L, int defer);
+LUA_API int (lua_callfinalizers) (lua_State *L);
+
+/*
+** thread running now, the innermost coroutine being resumed or the main
+** thread; it's a plain read, so it can be called from another thread
+** to set a hook on the running code, e.g. by a watchdog
+*/
+LUA_API lua_State *(lua_getrunning) (lua_State *L);
+
 
 /*
 ** miscellaneous functions
@@ -259,6 +259,16 @@
 #define LUA_API extern "C" __declspec(dllexport)
 #endif
 
+/* compiled by slua_lua module of unreal, UBT defines its export or import mark */
+#if defined(SLUA_LUA_API)
+#undef LUA_API
+#if defined(_WIN32)
+#define LUA_API extern "C" SLUA_LUA_API
+#else
+#define LUA_API extern SLUA_LUA_API
+#endif
+#endif
+
 /* more often than not the libs go together with the core */
 #define LUALIB_API	LUA_API
 #define LUAMOD_API	LUALIB_API
@@ -0,0 +1,66 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+
+using UnrealBuildTool;
+using System.IO;
+
+// lua vm and luasocket compiled from External, instead of prebuilt libraries,
+// so vm changes are built for every platform
+public class slua_lua : ModuleRules
+{
+    public slua_lua(ReadOnlyTargetRules Target) : base(Target)
+    {
+        // lua sources can't share pch or unity files with engine code, e.g. macro check
+        PCHUsage = ModuleRules.PCHUsageMode.NoPCHs;
+#if UE_4_22_OR_LATER
+        bUseUnity = false;
+#else
+        bFasterWithoutUnity = true;
+#endif
+        // lua is compiled as c++, error is thrown as exception
+        bEnableExceptions = true;
+        bEnforceIWYU = false;
+        bEnableUndefinedIdentifierWarnings = false;
+
+        var externalSource = Path.Combine(ModuleDirectory, "../../External");
+
+        PublicIncludePaths.AddRange(
+            new string[] {
+                externalSource,
+                Path.Combine(externalSource, "lua"),
+            }
+            );
+
+        // export lua api and luasocket entries to modules depend on slua_lua, see luaconf.h
+#if UE_4_21_OR_LATER
+        PublicDefinitions.Add("LUASOCKET_API=SLUA_LUA_API");
+        PublicDefinitions.Add("MIME_API=SLUA_LUA_API");
+#else
+        Definitions.Add("LUASOCKET_API=SLUA_LUA_API");
+        Definitions.Add("MIME_API=SLUA_LUA_API");
+#endif
+
+        if (Target.Platform == UnrealTargetPlatform.Win32 || Target.Platform == UnrealTargetPlatform.Win64)
+        {
+            PublicAdditionalLibraries.Add("ws2_32.lib");
+        }
+
+        PublicDependencyModuleNames.AddRange(
+            new string[]
+            {
+                "Core",
+            }
+            );
+    }
+}
@@ -19,6 +19,7 @@ const FString ULatentDelegate::NAME_LatentCallback = TEXT("OnLatentCallback");
 ULatentDelegate::ULatentDelegate(const FObjectInitializer& ObjectInitializer)
 	: Super(ObjectInitializer)
 	, luaState(nullptr)
+	, latentUUID(0)
 {
 }
 
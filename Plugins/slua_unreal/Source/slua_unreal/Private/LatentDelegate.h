@@ -32,7 +32,10 @@ public:
 	
 	void bindLuaState(NS_SLUA::LuaState *_luaState);
 	int getThreadRef(NS_SLUA::lua_State *L);
+	// unique id of latent action
+	int32 newLatentUUID() { return ++latentUUID; }
 
 protected:
 	NS_SLUA::LuaState* luaState;
+	int32 latentUUID;
 };
\ No newline at end of file
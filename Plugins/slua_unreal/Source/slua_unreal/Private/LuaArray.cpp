@@ -166,15 +166,15 @@ namespace NS_SLUA {
 
     int LuaArray::push(lua_State* L,UProperty* inner,FScriptArray* data) {
         LuaArray* luaArrray = new LuaArray(inner,data);
-		return LuaObject::pushType(L,luaArrray,"LuaArray",setupMT,gc);
+		return LuaObject::pushType(L,luaArrray,"LuaArray",setupMT,finalize);
     }
 
 	int LuaArray::push(lua_State* L, UArrayProperty* prop, UObject* obj) {
 		auto scriptArray = prop->ContainerPtrToValuePtr<FScriptArray>(obj);
 		if (LuaObject::getFromCache(L, scriptArray, "LuaArray")) return 1;
 		LuaArray* luaArray = new LuaArray(prop, obj);
-		int r = LuaObject::pushType(L, luaArray, "LuaArray", setupMT, gc);
-        if(r) LuaObject::cacheObj(L, luaArray->array);
+		int r = LuaObject::pushType(L, luaArray, "LuaArray", setupMT, finalize);
+        if(r) LuaObject::cacheObj(L, luaArray->array, "LuaArray");
         return 1;
 	}
 
@@ -200,6 +200,9 @@ namespace NS_SLUA {
 			luaL_error(L, "Array get index %d out of range", i);
 			return 0;
 		}
+		// struct elements aren't removed by engine gc, see AddReferencedObjects
+		if (element->GetClass() == UStructProperty::StaticClass())
+			return LuaObject::pushStructView(L, (UStructProperty*)element, UD->getRawPtr(i), 1);
         return LuaObject::push(L,element,UD->getRawPtr(i));
     }
 
@@ -229,6 +232,8 @@ namespace NS_SLUA {
         UProperty* element = UD->inner;
         auto checker = LuaObject::getChecker(element);
         if(checker) {
+            // elements may be moved
+            LuaObject::unlinkProps(L, lua_touserdata(L, 1));
             checker(L,element,UD->add(),2);
             // return num of array
             return LuaObject::push(L,UD->array->Num());
@@ -252,6 +257,7 @@ namespace NS_SLUA {
             if(!UD->isValidIndex(index))
                 luaL_error(L,"Array insert index %d out of range",index);
 
+            LuaObject::unlinkProps(L, lua_touserdata(L, 1));
             checker(L,element,UD->insert(index),3);
             // return num of array
             return LuaObject::push(L,UD->array->Num());
@@ -266,8 +272,10 @@ namespace NS_SLUA {
     int LuaArray::Remove(lua_State* L) {
         CheckUD(LuaArray,L,1);
         int index = LuaObject::checkValue<int>(L,2);
-        if(UD->isValidIndex(index))
+        if(UD->isValidIndex(index)) {
+            LuaObject::unlinkProps(L, lua_touserdata(L, 1));
             UD->remove(index);
+        }
         else
             luaL_error(L,"Array remove index %d out of range",index);
 		return 0;
@@ -275,6 +283,7 @@ namespace NS_SLUA {
 
     int LuaArray::Clear(lua_State* L) {
         CheckUD(LuaArray,L,1);
+        LuaObject::unlinkProps(L, lua_touserdata(L, 1));
         UD->clear();
 		return 0;
     }
@@ -324,11 +333,11 @@ namespace NS_SLUA {
         return 0;
     }
 
-    int LuaArray::gc(lua_State* L) {
-        CheckUD(LuaArray,L,1);
-		LuaObject::deleteFGCObject(L,UD);
-        return 0;   
-    }
+	void LuaArray::finalize(lua_State* L, GenericUserData* ud) {
+		if (ud->flag & UD_HADFREE) return;
+		LuaObject::unlinkProps(L, ud);
+		LuaObject::deleteFGCObject(L, reinterpret_cast<LuaArray*>(ud->ud));
+	}
 
 	int LuaArray::Enumerator::gc(lua_State* L) {
 		CheckUD(LuaArray::Enumerator, L, 1);
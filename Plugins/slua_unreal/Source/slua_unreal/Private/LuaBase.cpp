@@ -15,9 +15,13 @@
 #include "LuaBase.h"
 #include "LuaUserWidget.h"
 #include "LuaActor.h"
+#include "LuaFunctionPlan.h"
 
 extern uint8 GRegisterNative(int32 NativeBytecodeIndex, const FNativeFuncPtr& Func);
 #define Ex_LuaHook (EX_Max-1)
+// table of instance table keeps overrides set to instance,
+// so reassigning them always calls __newindex
+#define SLUA_INSTOVERRIDES "__overrides"
 
 ULuaTableObjectInterface::ULuaTableObjectInterface(const class FObjectInitializer& OI)
 	:Super(OI) {}
@@ -34,10 +38,12 @@ namespace NS_SLUA {
 		if (!luaSelfTable.isTable())
 			return false;
 
-		NS_SLUA::LuaVar lfunc = luaSelfTable.getFromTable<NS_SLUA::LuaVar>((const char*)TCHAR_TO_UTF8(*func->GetName()), true);
-		if (!lfunc.isValid()) return false;
+		// override functions resolved by bindOverrideFunc
+		auto lfunc = findOverrideFunc(func);
+		if (!lfunc) return false;
 
-		return lfunc.callByUFunction(func, (uint8*)params, &luaSelfTable);
+		LuaScriptEntryScope entry(lfunc->getState(), SE_EVENT);
+		return lfunc->callByUFunction(func, (uint8*)params, &luaSelfTable);
 	}
 
 	// Called every frame
@@ -48,6 +54,7 @@ namespace NS_SLUA {
 			superTick();
 			return;
 		}
+		LuaScriptEntryScope entry(tickFunction.getState(), SE_TICK);
 		tickFunction.call(luaSelfTable, DeltaTime);
 	}
 
@@ -57,27 +64,58 @@ namespace NS_SLUA {
 		superTick();
 	}
 
-	int LuaBase::superOrRpcCall(lua_State* L,UFunction* func)
+	int LuaBase::superOrRpcCall(lua_State* L,const LuaFunctionPlan* plan)
 	{
 		UObject* obj = context.Get();
 		if (!obj) return 0;
 
-		FStructOnScope params(func);
-		LuaObject::fillParam(L, 2, func, params.GetStructMemory());
-		{
-			// call function with params
-			LuaObject::callUFunction(L, obj, func, params.GetStructMemory());
-		}
-		// return value to push lua stack
-		return LuaObject::returnValue(L, func, params.GetStructMemory());
+		// skip self at 1
+		return plan->invoke(L, obj, 2);
 	}
 
 	int LuaBase::__index(NS_SLUA::lua_State * L)
 	{
+		// overrides of instance shadow class table
+		lua_pushliteral(L, SLUA_INSTOVERRIDES);
+		if (lua_rawget(L, 1) == LUA_TTABLE) {
+			lua_pushvalue(L, 2);
+			if (lua_rawget(L, -2) != LUA_TNIL)
+				return 1;
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+
+		// search class table at upvalue 1
+		lua_pushvalue(L, 2);
+		if (lua_rawget(L, lua_upvalueindex(1)) != LUA_TNIL)
+			return 1;
+		lua_pop(L, 1);
+
 		lua_pushstring(L, SLUA_CPPINST);
 		lua_rawget(L, 1);
 		if (!lua_isuserdata(L, -1))
 			luaL_error(L, "expect LuaBase table at arg 1");
+
+		// create Super and Rpc proxy on first use
+		if (lua_type(L, 2) == LUA_TSTRING) {
+			const char* key = lua_tostring(L, 2);
+			bool isSuper = strcmp(key, "Super") == 0;
+			if (isSuper || strcmp(key, "Rpc") == 0) {
+				UObject* obj = LuaObject::checkValue<UObject*>(L, -1);
+				LuaBase* lb = obj ? getLuaBase(obj) : nullptr;
+				if (lb) {
+					if (isSuper)
+						LuaObject::pushType(L, new LuaSuper(lb), "LuaSuper", supermt, genericGC<LuaSuper>);
+					else
+						LuaObject::pushType(L, new LuaRpc(lb), "LuaRpc", rpcmt, genericGC<LuaRpc>);
+					// cache it to instance table
+					lua_pushvalue(L, 2);
+					lua_pushvalue(L, -2);
+					lua_rawset(L, 1);
+					return 1;
+				}
+			}
+		}
 		// push key
 		lua_pushvalue(L, 2);
 		// get field from real actor
@@ -108,6 +146,43 @@ namespace NS_SLUA {
 		// set ok?
 		if (lua_pcall(L, 3, 0, 0)) {
 			lua_pop(L, 1);
+
+			if (lua_type(L, 2) == LUA_TSTRING) {
+				lua_pushliteral(L, SLUA_INSTOVERRIDES);
+				int overrides = lua_absindex(L, -1);
+				bool isOverride = false;
+				if (lua_rawget(L, 1) == LUA_TTABLE) {
+					lua_pushvalue(L, 2);
+					isOverride = lua_rawget(L, overrides) != LUA_TNIL;
+					lua_pop(L, 1);
+				}
+				// new function field may add or remove an override of blueprint event
+				int vt = lua_type(L, 3);
+				if (isOverride || vt == LUA_TFUNCTION || vt == LUA_TNIL) {
+					UObject* obj = LuaObject::checkValue<UObject*>(L, 4);
+					LuaBase* lb = obj ? getLuaBase(obj) : nullptr;
+					bool isFunc = vt == LUA_TFUNCTION;
+					if (lb && lb->updateOverrideFunc(obj->GetClass(), lua_tostring(L, 2), isFunc ? LuaVar(L, 3) : LuaVar()) && isFunc) {
+						if (!lua_istable(L, overrides)) {
+							lua_newtable(L);
+							lua_replace(L, overrides);
+							lua_pushliteral(L, SLUA_INSTOVERRIDES);
+							lua_pushvalue(L, overrides);
+							lua_rawset(L, 1);
+						}
+						lua_pushvalue(L, 2);
+						lua_pushvalue(L, 3);
+						lua_rawset(L, overrides);
+						return 0;
+					}
+				}
+				// not an override any more
+				if (isOverride) {
+					lua_pushvalue(L, 2);
+					lua_pushnil(L);
+					lua_rawset(L, overrides);
+				}
+			}
 			// push key
 			lua_pushvalue(L, 2);
 			// push value
@@ -135,7 +210,7 @@ namespace NS_SLUA {
 		}
 	}
 
-	LuaBase* checkBase(UObject* obj) {
+	static LuaBase* checkBase(UObject* obj) {
 		if (auto uit = Cast<ULuaUserWidget>(obj))
 			return uit;
 		else if (auto ait = Cast<ALuaActor>(obj))
@@ -158,11 +233,30 @@ namespace NS_SLUA {
 			return nullptr;
 	}
 
+	LuaBase* LuaBase::getLuaBase(UObject* obj) {
+		// offset from UObject to LuaBase, keyed by native class
+		// native class never be freed, and blueprint class has same layout as its native super
+		static TMap<UClass*, int32> baseOffsets;
+
+		UClass* cls = obj->GetClass();
+		while (cls && !cls->HasAnyClassFlags(CLASS_Native))
+			cls = cls->GetSuperClass();
+
+		int32* offset = baseOffsets.Find(cls);
+		if (!offset) {
+			LuaBase* lb = checkBase(obj);
+			offset = &baseOffsets.Add(cls, lb ? (int32)((uint8*)lb - (uint8*)obj) : INDEX_NONE);
+		}
+		if (*offset == INDEX_NONE)
+			return nullptr;
+		return reinterpret_cast<LuaBase*>((uint8*)obj + *offset);
+	}
+
 	DEFINE_FUNCTION(LuaBase::luaOverrideFunc)
 	{
 		UFunction* func = Stack.Node;
 		ensure(func);
-		LuaBase* lb = checkBase(Stack.Object);
+		LuaBase* lb = getLuaBase(Stack.Object);
 
 		// maybe lb is nullptr, some member function with same name in different class
 		// we don't care about it
@@ -181,9 +275,10 @@ namespace NS_SLUA {
 		void* params = Stack.Locals;
 
 		LuaVar& luaSelfTable = lb->luaSelfTable;
-		NS_SLUA::LuaVar lfunc = luaSelfTable.getFromTable<NS_SLUA::LuaVar>(func->GetName(), true);
-		if (lfunc.isValid()) {
-			lfunc.callByUFunction(func, (uint8*)params, &luaSelfTable, Stack.OutParms);
+		auto lfunc = lb->findOverrideFunc(func);
+		if (lfunc && luaSelfTable.isTable()) {
+			LuaScriptEntryScope entry(lfunc->getState(), SE_EVENT);
+			lfunc->callByUFunction(func, (uint8*)params, &luaSelfTable, Stack.OutParms);
 			*(bool*)RESULT_PARAM = true;
 		}
 		else {
@@ -196,20 +291,130 @@ namespace NS_SLUA {
 		
 	}
 
-	void LuaBase::bindOverrideFunc(UObject* obj)
+	void LuaBase::bindOverrideFunc(UObject* obj, LuaScriptClass* scriptClass)
 	{
-		ensure(obj && luaSelfTable.isValid());
+		ensure(obj && scriptClass);
 		UClass* cls = obj->GetClass();
 		ensure(cls);
 
-		EFunctionFlags availableFlag = FUNC_BlueprintEvent;
+		overrideFuncs.Empty();
+		// resolved once for each blueprint class of script
+		auto& overrides = scriptClass->overrides.FindOrAdd(cls);
+		if (!overrides.IsValid()) {
+			overrides = MakeShareable(new LuaScriptClass::OverrideMap());
+			EFunctionFlags availableFlag = FUNC_BlueprintEvent;
+			for (TFieldIterator<UFunction> it(cls); it; ++it) {
+				if (!(it->FunctionFlags&availableFlag))
+					continue;
+				LuaVar lfunc = scriptClass->table.getFromTable<LuaVar>(it->GetName(), true);
+				if (lfunc.isFunction()) {
+					hookBpScript(*it, (FNativeFuncPtr)&luaOverrideFunc);
+					// super function with same name share lua function
+					overrides->Add(*it, lfunc);
+				}
+			}
+		}
+		classOverrides = overrides;
+	}
+
+	bool LuaBase::initInstance(LuaState* ls, UObject* obj, const char* typeName, const FString& luaPath)
+	{
+		LuaScriptClass* scriptClass = getScriptClass(ls, typeName, luaPath);
+		if (!scriptClass)
+			return false;
+
+		context = obj;
+		classTable = scriptClass->table;
+		auto L = ls->getLuaState();
+		AutoStack as(L);
+		// instance table only hold __cppinst and fields set by instance
+		lua_newtable(L);
+		// we use rawpush to bind objptr and SLUA_CPPINST
+		LuaObject::push(L, obj, true);
+		lua_setfield(L, -2, SLUA_CPPINST);
+		scriptClass->metaTable.push(L);
+		lua_setmetatable(L, -2);
+		luaSelfTable.set(L, -1);
+
+		bindOverrideFunc(obj, scriptClass);
+		return true;
+	}
+
+	LuaScriptClass* LuaBase::getScriptClass(LuaState* ls, const char* typeName, const FString& luaPath)
+	{
+		auto scriptClassPtr = ls->scriptClasses.Find(luaPath);
+		if (scriptClassPtr)
+			return *scriptClassPtr;
+
+		// load script once, failed script isn't cached and will be reloaded next time
+		LuaVar table = ls->doFile(TCHAR_TO_UTF8(*luaPath));
+		if (!table.isTable())
+			return nullptr;
+
+		auto scriptClass = new LuaScriptClass();
+		scriptClass->table = table;
+
+		auto L = ls->getLuaState();
+		lua_newtable(L);
+		lua_pushstring(L, typeName);
+		lua_setfield(L, -2, "__name");
+		table.push(L);
+		lua_pushcclosure(L, __index, 1);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, __newindex);
+		lua_setfield(L, -2, "__newindex");
+		scriptClass->metaTable.set(L, -1);
+		lua_pop(L, 1);
+
+		ls->scriptClasses.Add(luaPath, scriptClass);
+		return scriptClass;
+	}
+
+	LuaVar LuaBase::getSelfField(const char* key, bool rawget) const
+	{
+		LuaVar ret = luaSelfTable.getFromTable<LuaVar>(key, rawget);
+		if (rawget && ret.isNil() && overrideFuncs.Num() > 0) {
+			LuaVar overrides = luaSelfTable.getFromTable<LuaVar>(SLUA_INSTOVERRIDES, true);
+			if (overrides.isTable())
+				ret = overrides.getFromTable<LuaVar>(key, true);
+		}
+		if (rawget && ret.isNil() && classTable.isTable())
+			ret = classTable.getFromTable<LuaVar>(key, true);
+		return ret;
+	}
+
+	const LuaVar* LuaBase::findOverrideFunc(UFunction* func) const
+	{
+		if (overrideFuncs.Num() > 0) {
+			auto lfunc = overrideFuncs.Find(func);
+			if (lfunc) return lfunc;
+		}
+		return classOverrides.IsValid() ? classOverrides->Find(func) : nullptr;
+	}
+
+	bool LuaBase::updateOverrideFunc(UClass* cls, const char* name, const LuaVar& lfunc)
+	{
+		// name never used by any function
+		FName fname(UTF8_TO_TCHAR(name), FNAME_Find);
+		if (fname.IsNone())
+			return false;
+
+		// remove old override with same name
+		for (auto it = overrideFuncs.CreateIterator(); it; ++it)
+			if (it.Key()->GetFName() == fname)
+				it.RemoveCurrent();
+
+		bool found = false;
 		for (TFieldIterator<UFunction> it(cls); it; ++it) {
-			if (!(it->FunctionFlags&availableFlag))
+			if (!(it->FunctionFlags&FUNC_BlueprintEvent) || it->GetFName() != fname)
 				continue;
-			if (luaSelfTable.getFromTable<LuaVar>(it->GetName(), true).isFunction()) {
-				hookBpScript(*it, (FNativeFuncPtr)&luaOverrideFunc);
-			}
+			found = true;
+			if (!lfunc.isFunction())
+				continue;
+			hookBpScript(*it, (FNativeFuncPtr)&luaOverrideFunc);
+			overrideFuncs.Add(*it, lfunc);
 		}
+		return found;
 	}
 
 	template<typename T>
@@ -242,7 +447,7 @@ namespace NS_SLUA {
 		UFunction* func = getSuperOrRpcFunction<LuaSuper>(L);
 		if (!func) return 1;
 
-		lua_pushlightuserdata(L, func);
+		LuaFunctionPlan::push(L, func);
 		lua_pushcclosure(L, __superCall, 1);
 		return 1;
 	}
@@ -252,7 +457,7 @@ namespace NS_SLUA {
 		UFunction* func = getSuperOrRpcFunction<LuaRpc>(L);
 		if (!func) return 1;
 
-		lua_pushlightuserdata(L, func);
+		LuaFunctionPlan::push(L, func);
 		lua_pushcclosure(L, __rpcCall, 1);
 		return 1;
 	}
@@ -268,16 +473,15 @@ namespace NS_SLUA {
 	int LuaBase::__superCall(lua_State* L)
 	{
 		CheckUD(LuaSuper, L, 1);
-		lua_pushvalue(L, lua_upvalueindex(1));
-		UFunction* func = (UFunction*) lua_touserdata(L, -1);
+		auto plan = LuaFunctionPlan::get(L, lua_upvalueindex(1));
+		UFunction* func = plan ? plan->func : nullptr;
 		if (!func || !func->IsValidLowLevel())
 			luaL_error(L, "Super function is isvalid");
-		lua_pop(L, 1);
 		auto lbase = UD->base;
 		ensure(lbase);
 		lbase->currentFunction = func;
 		lbase->indexFlag = IF_SUPER;
-		int ret = lbase->superOrRpcCall(L, func);
+		int ret = lbase->superOrRpcCall(L, plan);
 		lbase->indexFlag = IF_NONE;
 		lbase->currentFunction = nullptr;
 		return ret;
@@ -286,16 +490,15 @@ namespace NS_SLUA {
 	int LuaBase::__rpcCall(lua_State* L)
 	{
 		CheckUD(LuaRpc, L, 1);
-		lua_pushvalue(L, lua_upvalueindex(1));
-		UFunction* func = (UFunction*)lua_touserdata(L, -1);
+		auto plan = LuaFunctionPlan::get(L, lua_upvalueindex(1));
+		UFunction* func = plan ? plan->func : nullptr;
 		if (!func || !func->IsValidLowLevel())
 			luaL_error(L, "Super function is isvalid");
-		lua_pop(L, 1);
 		auto lbase = UD->base;
 		ensure(lbase);
 		lbase->currentFunction = func;
 		lbase->indexFlag = IF_RPC;
-		int ret = lbase->superOrRpcCall(L, func);
+		int ret = lbase->superOrRpcCall(L, plan);
 		lbase->indexFlag = IF_NONE;
 		lbase->currentFunction = nullptr;
 		return ret;
@@ -318,7 +521,7 @@ namespace NS_SLUA {
 
 	LuaVar LuaBase::callMember(FString func, const TArray<FLuaBPVar>& args)
 	{
-		NS_SLUA::LuaVar lfunc = luaSelfTable.getFromTable<NS_SLUA::LuaVar>((const char*)TCHAR_TO_UTF8(*func), true);
+		NS_SLUA::LuaVar lfunc = getSelfField(TCHAR_TO_UTF8(*func));
 		if (!lfunc.isFunction()) {
 			Log::Error("Can't find lua member function named %s to call", TCHAR_TO_UTF8(*func));
 			return false;
@@ -340,10 +543,10 @@ namespace NS_SLUA {
 			return false;
 
 		if (luaSelfTable.isTable()) {
-			tickFunction = luaSelfTable.getFromTable<NS_SLUA::LuaVar>("Tick", true);
+			tickFunction = getSelfField("Tick");
 		}
 
-		return luaSelfTable.getFromTable<bool>(tickFlag, rawget);
+		return getSelfField(tickFlag, rawget).castTo<bool>();
 	}
 }
 
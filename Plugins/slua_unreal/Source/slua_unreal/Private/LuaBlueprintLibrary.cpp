@@ -55,7 +55,7 @@ FLuaBPVar ULuaBlueprintLibrary::CallToLuaWithArgs(UObject* WorldContextObject, F
     auto ls = LuaState::get(actor->GetGameInstance());
     if(StateName.Len()!=0) ls = LuaState::get(StateName);
     if(!ls) return FLuaBPVar();
-    LuaVar f = ls->get(TCHAR_TO_UTF8(*funcname));
+    LuaVar f = ls->getPathHandle(funcname)->get();
     if(!f.isFunction()) {
 		Log::Error("Can't find lua member function named %s to call", TCHAR_TO_UTF8(*funcname));
         return LuaVar();
@@ -75,7 +75,7 @@ FLuaBPVar ULuaBlueprintLibrary::CallToLua(UObject* WorldContextObject, FString f
 	auto ls = LuaState::get(actor->GetGameInstance());
     if(StateName.Len()!=0) ls = LuaState::get(StateName);
     if(!ls) return FLuaBPVar();
-    LuaVar f = ls->get(TCHAR_TO_UTF8(*funcname));
+    LuaVar f = ls->getPathHandle(funcname)->get();
 	if (!f.isFunction()) {
 		Log::Error("Can't find lua member function named %s to call", TCHAR_TO_UTF8(*funcname));
         return LuaVar();
@@ -83,6 +83,29 @@ FLuaBPVar ULuaBlueprintLibrary::CallToLua(UObject* WorldContextObject, FString f
     return f.callWithNArg(0);
 }
 
+FLuaBPPathHandle ULuaBlueprintLibrary::MakeLuaPathHandle(UObject* WorldContextObject, FString funcname, FString StateName) {
+    using namespace NS_SLUA;
+	auto actor = Cast<AActor>(WorldContextObject);
+	ensure(actor);
+	auto ls = LuaState::get(actor->GetGameInstance());
+    if(StateName.Len()!=0) ls = LuaState::get(StateName);
+    if(!ls) return FLuaBPPathHandle();
+    return FLuaBPPathHandle(LuaPathHandle(ls->getLuaState(), TCHAR_TO_UTF8(*funcname)));
+}
+
+FLuaBPVar ULuaBlueprintLibrary::CallLuaPathHandle(const FLuaBPPathHandle& handle, const TArray<FLuaBPVar>& args) {
+    using namespace NS_SLUA;
+    LuaVar f = handle.handle.get();
+    if(!f.isFunction()) {
+		Log::Error("Can't find lua member function named %s to call", TCHAR_TO_UTF8(*handle.handle.getPath()));
+        return LuaVar();
+    }
+
+    for(auto& arg:args) {
+        arg.value.push(f.getState());
+    }
+    return f.callWithNArg(args.Num());
+}
 
 FLuaBPVar ULuaBlueprintLibrary::CreateVarFromInt(int i) {
     FLuaBPVar v;
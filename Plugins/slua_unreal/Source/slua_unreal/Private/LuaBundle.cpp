@@ -0,0 +1,163 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaBundle.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/FileHelper.h"
+#include "Hash/CityHash.h"
+#include "Log.h"
+
+namespace NS_SLUA {
+
+	namespace {
+		const uint32 BundleMagic = 0x44424c53; // "SLBD"
+		const uint32 BundleVersion = 1;
+	}
+
+	LuaBundle::LuaBundle()
+		: handle(nullptr)
+		, region(nullptr)
+		, base(nullptr)
+		, size(0)
+		, entries(nullptr)
+		, count(0)
+	{
+	}
+
+	LuaBundle::~LuaBundle()
+	{
+		close();
+	}
+
+	uint64 LuaBundle::hashOf(const char* fn)
+	{
+		return CityHash64(fn, strlen(fn));
+	}
+
+	bool LuaBundle::open(const FString& path)
+	{
+		close();
+
+		handle = FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*path);
+		if (handle) {
+			region = handle->MapRegion(0, handle->GetFileSize());
+			if (region) {
+				base = region->GetMappedPtr();
+				size = region->GetMappedSize();
+			}
+		}
+		// fallback to read whole file
+		if (!base) {
+			if (!FFileHelper::LoadFileToArray(data, *path)) {
+				Log::Error("Can't open lua bundle %s", TCHAR_TO_UTF8(*path));
+				close();
+				return false;
+			}
+			base = data.GetData();
+			size = data.Num();
+		}
+
+		const Header* header = (const Header*)base;
+		if (size < (int64)sizeof(Header) || header->magic != BundleMagic || header->version != BundleVersion
+			|| size < (int64)(sizeof(Header) + sizeof(Entry) * (uint64)header->count)) {
+			Log::Error("Invalid lua bundle %s", TCHAR_TO_UTF8(*path));
+			close();
+			return false;
+		}
+		count = header->count;
+		entries = (const Entry*)(base + sizeof(Header));
+		return true;
+	}
+
+	void LuaBundle::close()
+	{
+		// region must be freed before handle
+		delete region;
+		region = nullptr;
+		delete handle;
+		handle = nullptr;
+		data.Empty();
+		base = nullptr;
+		size = 0;
+		entries = nullptr;
+		count = 0;
+	}
+
+	const uint8* LuaBundle::find(const char* fn, uint32& len) const
+	{
+		if (!base) return nullptr;
+
+		uint64 hash = hashOf(fn);
+		// binary search entries sorted by hash
+		uint32 lo = 0, hi = count;
+		while (lo < hi) {
+			uint32 mid = lo + (hi - lo) / 2;
+			if (entries[mid].hash < hash)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == count || entries[lo].hash != hash)
+			return nullptr;
+
+		const Entry& e = entries[lo];
+		if ((int64)e.offset + e.len > size)
+			return nullptr;
+		len = e.len;
+		return base + e.offset;
+	}
+
+	bool LuaBundle::write(const FString& path, const TMap<FString, TArray<uint8>>& files)
+	{
+		TArray<Entry> index;
+		TArray<const TArray<uint8>*> contents;
+		for (auto& pair : files) {
+			Entry e = { hashOf(TCHAR_TO_UTF8(*pair.Key)), 0, (uint32)pair.Value.Num() };
+			index.Add(e);
+			contents.Add(&pair.Value);
+		}
+
+		// sort index and contents together by hash
+		TArray<int32> order;
+		for (int32 n = 0; n < index.Num(); n++)
+			order.Add(n);
+		order.Sort([&](int32 a, int32 b) { return index[a].hash < index[b].hash; });
+
+		Header header = { BundleMagic, BundleVersion, (uint32)index.Num(), 0 };
+		uint64 offset = sizeof(Header) + sizeof(Entry) * (uint64)index.Num();
+		TArray<Entry> sorted;
+		for (int32 n = 0; n < order.Num(); n++) {
+			Entry e = index[order[n]];
+			if (n > 0 && sorted.Last().hash == e.hash) {
+				Log::Error("Hash conflict in lua bundle %s", TCHAR_TO_UTF8(*path));
+				return false;
+			}
+			e.offset = (uint32)offset;
+			offset += e.len;
+			sorted.Add(e);
+		}
+		if (offset > MAX_uint32) {
+			Log::Error("Lua bundle %s is too large", TCHAR_TO_UTF8(*path));
+			return false;
+		}
+
+		TArray<uint8> out;
+		out.Reserve(offset);
+		out.Append((const uint8*)&header, sizeof(header));
+		out.Append((const uint8*)sorted.GetData(), sizeof(Entry) * sorted.Num());
+		for (int32 n : order)
+			out.Append(*contents[n]);
+		return FFileHelper::SaveArrayToFile(out, *path);
+	}
+}
@@ -0,0 +1,159 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaChunkCache.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+
+namespace NS_SLUA {
+
+	namespace {
+		// header of bytecode file
+		struct ChunkHeader {
+			uint32 magic;
+			uint32 version;
+			uint32 hash;
+			uint32 len;
+		};
+
+		const uint32 ChunkMagic = 0x43424c53; // "SLBC"
+		// bytecode depend on lua version and pointer size
+		const uint32 ChunkVersion = LUA_VERSION_NUM * 100 + sizeof(void*);
+
+		int writer(lua_State* L, const void* p, size_t sz, void* ud) {
+			((TArray<uint8>*)ud)->Append((const uint8*)p, sz);
+			return 0;
+		}
+	}
+
+	LuaChunkCache::LuaChunkCache()
+		: strip(false)
+	{
+	}
+
+	void LuaChunkCache::setCacheDir(const FString& dir, bool s)
+	{
+		cacheDir = dir;
+		strip = s;
+		if (!cacheDir.IsEmpty())
+			IFileManager::Get().MakeDirectory(*cacheDir, true);
+	}
+
+	bool LuaChunkCache::load(lua_State* L, const uint8* buf, uint32 len, const FString& filepath, const char* chunk)
+	{
+		uint32 hash = hashOf(buf, len);
+		auto cached = chunks.Find(filepath);
+		if (cached && cached->hash == hash && cached->len == len) {
+			if (luaL_loadbufferx(L, (const char*)cached->code.GetData(), cached->code.Num(), chunk, "b") == LUA_OK)
+				return true;
+			// bad bytecode, compile from source again
+			lua_pop(L, 1);
+		}
+
+		TArray<uint8> code;
+		if (!loadFromDisk(L, filepath, hash, len, chunk, code)) {
+			if (luaL_loadbuffer(L, (const char*)buf, len, chunk) != LUA_OK)
+				return false;
+			code.Reset();
+			if (!dump(L, code, strip))
+				return true;
+			saveToDisk(filepath, hash, len, code);
+		}
+
+		addChunk(filepath, hash, len, MoveTemp(code));
+		return true;
+	}
+
+	bool LuaChunkCache::loadBytecode(lua_State* L, const TArray<uint8>& code, const FString& filepath, uint32 hash, uint32 len, const char* chunk)
+	{
+		if (luaL_loadbufferx(L, (const char*)code.GetData(), code.Num(), chunk, "b") != LUA_OK)
+			return false;
+		addChunk(filepath, hash, len, TArray<uint8>(code));
+		return true;
+	}
+
+	bool LuaChunkCache::dump(lua_State* L, TArray<uint8>& code, bool strip)
+	{
+		return lua_dump(L, writer, &code, strip ? 1 : 0) == 0;
+	}
+
+	void LuaChunkCache::addChunk(const FString& filepath, uint32 hash, uint32 len, TArray<uint8>&& code)
+	{
+		// replace old chunk of same file
+		Chunk& c = chunks.FindOrAdd(filepath);
+		c.hash = hash;
+		c.len = len;
+		c.code = MoveTemp(code);
+	}
+
+	void LuaChunkCache::clear()
+	{
+		chunks.Empty();
+	}
+
+	FString LuaChunkCache::getCachePath(const FString& filepath) const
+	{
+		return FPaths::Combine(cacheDir, FMD5::HashAnsiString(*filepath) + TEXT(".luac"));
+	}
+
+	bool LuaChunkCache::loadFromDisk(lua_State* L, const FString& filepath, uint32 hash, uint32 len, const char* chunk, TArray<uint8>& code)
+	{
+		if (cacheDir.IsEmpty())
+			return false;
+
+		FString path = getCachePath(filepath);
+		IFileManager& fm = IFileManager::Get();
+		FDateTime cacheTime = fm.GetTimeStamp(*path);
+		if (cacheTime == FDateTime::MinValue())
+			return false;
+		// source changed after bytecode saved
+		FDateTime sourceTime = fm.GetTimeStamp(*filepath);
+		if (sourceTime != FDateTime::MinValue() && sourceTime > cacheTime)
+			return false;
+
+		TArray<uint8> data;
+		if (!FFileHelper::LoadFileToArray(data, *path) || data.Num() <= sizeof(ChunkHeader))
+			return false;
+
+		const ChunkHeader* header = (const ChunkHeader*)data.GetData();
+		if (header->magic != ChunkMagic || header->version != ChunkVersion
+			|| header->hash != hash || header->len != len)
+			return false;
+
+		const char* bytes = (const char*)data.GetData() + sizeof(ChunkHeader);
+		size_t size = data.Num() - sizeof(ChunkHeader);
+		if (luaL_loadbufferx(L, bytes, size, chunk, "b") != LUA_OK) {
+			// bad bytecode, compile from source again
+			lua_pop(L, 1);
+			return false;
+		}
+		code.Reset();
+		code.Append((const uint8*)bytes, size);
+		return true;
+	}
+
+	void LuaChunkCache::saveToDisk(const FString& filepath, uint32 hash, uint32 len, const TArray<uint8>& code)
+	{
+		if (cacheDir.IsEmpty())
+			return;
+
+		ChunkHeader header = { ChunkMagic, ChunkVersion, hash, len };
+		TArray<uint8> data;
+		data.Reserve(sizeof(header) + code.Num());
+		data.Append((const uint8*)&header, sizeof(header));
+		data.Append(code);
+		FFileHelper::SaveArrayToFile(data, *getCachePath(filepath));
+	}
+}
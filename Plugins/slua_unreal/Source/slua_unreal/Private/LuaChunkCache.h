@@ -0,0 +1,60 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "Misc/Crc.h"
+#include "lua/lua.hpp"
+
+namespace NS_SLUA {
+
+	// cache compiled lua chunk by file path and content hash,
+	// bytecode is kept in memory and can be saved to cache dir,
+	// every load creates a new function from bytecode, so loads don't share upvalues
+	class LuaChunkCache {
+	public:
+		LuaChunkCache();
+
+		// set dir to save bytecode, empty dir disable disk cache
+		// strip debug info of bytecode if strip is true, error traceback lose line info
+		void setCacheDir(const FString& dir, bool strip);
+		// push compiled function of buf to L and return true,
+		// otherwise push error message and return false
+		bool load(lua_State* L, const uint8* buf, uint32 len, const FString& filepath, const char* chunk);
+		// load bytecode compiled from source with hash and len, e.g. compiled by preloader
+		bool loadBytecode(lua_State* L, const TArray<uint8>& code, const FString& filepath, uint32 hash, uint32 len, const char* chunk);
+		// hash of source content used to validate cached chunk
+		static uint32 hashOf(const uint8* buf, uint32 len) { return FCrc::MemCrc32(buf, len); }
+		// dump function on top of L
+		static bool dump(lua_State* L, TArray<uint8>& code, bool strip);
+		// release all cached bytecode
+		void clear();
+
+	private:
+		struct Chunk {
+			uint32 hash;
+			uint32 len;
+			TArray<uint8> code;
+		};
+
+		void addChunk(const FString& filepath, uint32 hash, uint32 len, TArray<uint8>&& code);
+		// push function loaded from bytecode file, code is filled with bytecode
+		bool loadFromDisk(lua_State* L, const FString& filepath, uint32 hash, uint32 len, const char* chunk, TArray<uint8>& code);
+		void saveToDisk(const FString& filepath, uint32 hash, uint32 len, const TArray<uint8>& code);
+		FString getCachePath(const FString& filepath) const;
+
+		TMap<FString, Chunk> chunks;
+		FString cacheDir;
+		bool strip;
+	};
+}
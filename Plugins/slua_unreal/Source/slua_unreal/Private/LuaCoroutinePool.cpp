@@ -0,0 +1,155 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaCoroutinePool.h"
+#include "LuaState.h"
+#include "lua/lstate.h"
+#include "lua/ldo.h"
+
+namespace NS_SLUA {
+	namespace LuaCoroutinePool {
+
+		// max count of idle coroutines kept by pool
+		const int MaxPoolSize = 256;
+
+		// same as auxresume of lcorolib
+		int auxresume(lua_State *L, lua_State *co, int narg) {
+			if (!lua_checkstack(co, narg)) {
+				lua_pushliteral(L, "too many arguments to resume");
+				return -1;
+			}
+			if (lua_status(co) == LUA_OK && lua_gettop(co) == 0) {
+				lua_pushliteral(L, "cannot resume dead coroutine");
+				return -1;
+			}
+			lua_xmove(L, co, narg);
+			int status = lua_resume(co, L, narg);
+			if (status == LUA_OK || status == LUA_YIELD) {
+				int nres = lua_gettop(co);
+				if (!lua_checkstack(L, nres + 1)) {
+					lua_pop(co, nres);
+					lua_pushliteral(L, "too many results to resume");
+					return -1;
+				}
+				lua_xmove(co, L, nres);
+				return nres;
+			}
+			lua_xmove(co, L, 1);
+			return -1;
+		}
+
+		// put finished coroutine back to pool at upvalue 2,
+		// unless script got it by coroutine.running(upvalue 3)
+		void recycle(lua_State *L, lua_State *co) {
+			// free latent slot hold by coroutine
+			LuaState::get(L)->releaseThread(co);
+
+			lua_settop(co, 0);
+			// shrink stack grown by last function
+			luaD_shrinkstack(co);
+			// drop hook set by debug.sethook inside coroutine,
+			// but keep the one of main thread like a new thread, e.g. debugger
+			lua_State *mainL = G(L)->mainthread;
+			lua_sethook(co, lua_gethook(mainL), lua_gethookmask(mainL), lua_gethookcount(mainL));
+
+			lua_pushvalue(L, lua_upvalueindex(1));
+			bool exposed = lua_rawget(L, lua_upvalueindex(3)) != LUA_TNIL;
+			lua_pop(L, 1);
+
+			int n = (int)lua_rawlen(L, lua_upvalueindex(2));
+			if (!exposed && n < MaxPoolSize) {
+				lua_pushvalue(L, lua_upvalueindex(1));
+				lua_rawseti(L, lua_upvalueindex(2), n + 1);
+			}
+			// wrap function can't resume it any more
+			lua_pushboolean(L, 0);
+			lua_replace(L, lua_upvalueindex(1));
+		}
+
+		int auxwrap(lua_State *L) {
+			lua_State *co = lua_tothread(L, lua_upvalueindex(1));
+			if (!co)
+				return luaL_error(L, "cannot resume dead coroutine");
+
+			int r = auxresume(L, co, lua_gettop(L));
+			if (r < 0) {
+				// propagate error with position like lcorolib
+				if (lua_type(L, -1) == LUA_TSTRING) {
+					luaL_where(L, 1);
+					lua_insert(L, -2);
+					lua_concat(L, 2);
+				}
+				return lua_error(L);
+			}
+			if (lua_status(co) == LUA_OK)
+				recycle(L, co);
+			return r;
+		}
+
+		int wrap(lua_State *L) {
+			luaL_checktype(L, 1, LUA_TFUNCTION);
+			// pop idle coroutine from pool at upvalue 1
+			int n = (int)lua_rawlen(L, lua_upvalueindex(1));
+			if (n > 0) {
+				lua_rawgeti(L, lua_upvalueindex(1), n);
+				lua_pushnil(L);
+				lua_rawseti(L, lua_upvalueindex(1), n);
+			}
+			else
+				lua_newthread(L);
+
+			lua_State *co = lua_tothread(L, -1);
+			lua_pushvalue(L, 1);
+			lua_xmove(L, co, 1);
+			lua_pushvalue(L, lua_upvalueindex(1));
+			lua_pushvalue(L, lua_upvalueindex(2));
+			lua_pushcclosure(L, auxwrap, 3);
+			return 1;
+		}
+
+		// mark thread returned by coroutine.running in table at upvalue 2,
+		// it may be held by script, so never reuse it
+		int running(lua_State *L) {
+			lua_pushvalue(L, lua_upvalueindex(1));
+			lua_call(L, 0, 2);
+			if (lua_type(L, -2) == LUA_TTHREAD) {
+				lua_pushvalue(L, -2);
+				lua_pushboolean(L, 1);
+				lua_rawset(L, lua_upvalueindex(2));
+			}
+			return 2;
+		}
+
+		void init(lua_State *L) {
+			lua_getglobal(L, "coroutine");
+			// weak keyed table of exposed threads
+			lua_newtable(L);
+			lua_newtable(L);
+			lua_pushliteral(L, "k");
+			lua_setfield(L, -2, "__mode");
+			lua_setmetatable(L, -2);
+			int exposed = lua_gettop(L);
+
+			lua_getfield(L, -2, "running");
+			lua_pushvalue(L, exposed);
+			lua_pushcclosure(L, running, 2);
+			lua_setfield(L, -3, "running");
+
+			lua_newtable(L);
+			lua_pushvalue(L, exposed);
+			lua_pushcclosure(L, wrap, 2);
+			lua_setfield(L, -3, "wrap");
+			lua_pop(L, 2);
+		}
+	}
+}
@@ -0,0 +1,26 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+
+#include "lua/lua.hpp"
+
+namespace NS_SLUA {
+	// replace coroutine.wrap, finished coroutine is recycled for next wrap,
+	// unless it's exposed to script by coroutine.running;
+	// coroutine.create isn't pooled, script holds the thread it returns,
+	// reusing it would bring a dead coroutine back to life
+	namespace LuaCoroutinePool {
+		void init(lua_State *L);
+	}
+}
@@ -13,6 +13,7 @@
 
 #include "LuaObject.h"
 #include "LuaVar.h"
+#include "LuaState.h"
 #include "LuaDelegate.h"
 
 ULuaDelegate::ULuaDelegate(const FObjectInitializer& ObjectInitializer)
@@ -33,6 +34,7 @@ void ULuaDelegate::EventTrigger()
 
 void ULuaDelegate::ProcessEvent( UFunction* f, void* Parms ) {
     ensure(luafunction!=nullptr && ufunction!=nullptr);
+    NS_SLUA::LuaScriptEntryScope entry(luafunction->getState(), NS_SLUA::SE_DELEGATE);
     luafunction->callByUFunction(ufunction,reinterpret_cast<uint8*>(Parms));
 }
 
@@ -0,0 +1,226 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaFunctionPlan.h"
+#include "LatentDelegate.h"
+#include "UObject/Stack.h"
+#include "Engine/LatentActionManager.h"
+
+namespace NS_SLUA {
+
+	static const FName NAME_LatentInfo = TEXT("LatentInfo");
+
+	LuaFunctionPlan::LuaFunctionPlan(UFunction* f)
+		: func(f)
+		, refCount(1)
+		, latentIndex(INDEX_NONE)
+		, structSize(f->GetStructureSize())
+		, isPOD(true)
+		, isNet(!!(f->FunctionFlags&FUNC_Net))
+	{
+		bool isNative = !!(f->FunctionFlags&FUNC_Native);
+		for (TFieldIterator<UProperty> it(f); it; ++it) {
+			UProperty* prop = *it;
+			uint64 propflag = prop->GetPropertyFlags();
+			// locals of blueprint function also in params memory
+			if (!(propflag&CPF_ZeroConstructor) || !(propflag&(CPF_IsPlainOldData | CPF_NoDestructor)))
+				isPOD = false;
+
+			rpcParms.Add(prop);
+			if (!(propflag&CPF_Parm))
+				continue;
+
+			Param param = { prop, prop->GetOffset_ForInternal(), propflag,
+				LuaObject::getChecker(prop), LuaObject::getPusher(prop) };
+
+			// reverse direction, ufunction call lua function
+			if (propflag&CPF_ReturnParm)
+				results.Insert(param, 0);
+			else if (IsRealOutParam(propflag))
+				results.Add(param);
+			if (!(propflag&CPF_ReturnParm) && !IsRealOutParam(propflag))
+				args.Add(param);
+
+			bool isLatent = prop->GetFName() == NAME_LatentInfo;
+			if (isLatent)
+				latentIndex = inputs.Num();
+
+			// native function accept out params as input, except return value
+			bool isInput = isNative ? !(propflag&CPF_ReturnParm) : !IsRealOutParam(propflag);
+			if (isInput || isLatent)
+				inputs.Add(param);
+
+			// return value at head of outputs
+			if (propflag&CPF_ReturnParm)
+				outputs.Insert(param, 0);
+			else if (!isLatent && IsRealOutParam(propflag))
+				outputs.Add(param);
+		}
+	}
+
+	void LuaFunctionPlan::fillParam(lua_State* L, int i, uint8* params) const {
+		for (int32 n = 0; n < inputs.Num(); n++) {
+			const Param& param = inputs[n];
+			if (n == latentIndex) {
+				// bind a callback to the latent function
+				lua_State *mainThread = G(L)->mainthread;
+
+				ULatentDelegate *obj = LuaObject::getLatentDelegate(mainThread);
+				int threadRef = obj->getThreadRef(L);
+				FLatentActionInfo LatentActionInfo(threadRef, obj->newLatentUUID(), *ULatentDelegate::NAME_LatentCallback, obj);
+
+				param.prop->CopySingleValue(params + param.offset, &LatentActionInfo);
+				continue;
+			}
+
+			// if is out param, can accept nil
+			if (!(param.flags&CPF_OutParm) || !lua_isnil(L, i)) {
+				if (!param.checker) {
+					FString tn = param.prop->GetClass()->GetName();
+					luaL_error(L, "unsupport param type %s at %d", TCHAR_TO_UTF8(*tn), i);
+				}
+				param.checker(L, param.prop, params + param.offset, i);
+			}
+			i++;
+		}
+	}
+
+	int LuaFunctionPlan::returnValue(lua_State* L, uint8* params) const {
+		int ret = 0;
+		for (auto& param : outputs) {
+			if (param.pusher)
+				ret += param.pusher(L, param.prop, params + param.offset, false);
+			else
+				ret += LuaObject::push(L, param.prop, params + param.offset);
+		}
+
+		if (latentIndex != INDEX_NONE)
+			return lua_yield(L, ret);
+		return ret;
+	}
+
+	void LuaFunctionPlan::call(lua_State* L, UObject* obj, uint8* params) const {
+		// it's an RPC function
+		if (isNet)
+			callRpc(obj, params);
+		else
+		// it's a local function
+			obj->ProcessEvent(func, params);
+	}
+
+	void LuaFunctionPlan::callRpc(UObject* obj, uint8* params) const {
+		// call rpc without outparams
+		const bool bHasReturnParam = func->ReturnValueOffset != MAX_uint16;
+		uint8* ReturnValueAddress = bHasReturnParam ? ((uint8*)params + func->ReturnValueOffset) : nullptr;
+
+		#if ENGINE_MINOR_VERSION >= 23 && (PLATFORM_MAC || PLATFORM_IOS)
+			FNewFrame NewStack(obj, func, params, NULL, func->Children);
+		#else
+			FFrame NewStack(obj, func, params, NULL, func->Children);
+		#endif
+
+		#if ENGINE_MINOR_VERSION < 25
+			if (bHasReturnParam) {
+				UProperty* ReturnProperty = func->GetReturnProperty();
+				if (ensure(ReturnProperty)) {
+					FOutParmRec* RetVal = (FOutParmRec*)FMemory_Alloca(sizeof(FOutParmRec));
+
+					/* Our context should be that we're in a variable assignment to the return value, so ensure that we have a valid property to return to */
+					RetVal->PropAddr = (uint8*)FMemory_Alloca(ReturnProperty->GetSize());
+					RetVal->Property = ReturnProperty;
+					NewStack.OutParms = RetVal;
+				}
+			}
+
+			NewStack.Locals = params;
+			FOutParmRec** LastOut = &NewStack.OutParms;
+
+			// properties in params memory had been collected by plan
+			for (UProperty* Property : rpcParms) {
+				if (Property->PropertyFlags & CPF_OutParm) {
+					CA_SUPPRESS(6263)
+					FOutParmRec* Out = (FOutParmRec*)FMemory_Alloca(sizeof(FOutParmRec));
+					Out->PropAddr = Property->ContainerPtrToValuePtr<uint8>(NewStack.Locals);
+					Out->Property = Property;
+
+					// add the new out param info to the stack frame's linked list
+					if (*LastOut) {
+						(*LastOut)->NextOutParm = Out;
+						LastOut = &(*LastOut)->NextOutParm;
+					} else {
+						*LastOut = Out;
+					}
+				} else {
+					// copy the result of the expression for this parameter into the appropriate part of the local variable space
+					Property->InitializeValue_InContainer(NewStack.Locals);
+				}
+			}
+		#else
+			NewStack.OutParms = nullptr;
+		#endif
+
+		#if ENGINE_MINOR_VERSION >= 23 && (PLATFORM_MAC || PLATFORM_IOS)
+			FFrame *frame = (FFrame *)&NewStack;
+			func->Invoke(obj, *frame, ReturnValueAddress);
+		#else
+			func->Invoke(obj, NewStack, ReturnValueAddress);
+		#endif
+	}
+
+	int LuaFunctionPlan::invoke(lua_State* L, UObject* obj, int offset) const {
+		LuaFunctionParamsOnStack(this, params);
+		fillParam(L, offset, params.get());
+		call(L, obj, params.get());
+		// return value to push lua stack
+		return returnValue(L, params.get());
+	}
+
+	static void finalizePlan(lua_State* L, GenericUserData* ud) {
+		ud->flag |= UD_HADFREE;
+		LuaFunctionPlan::release(reinterpret_cast<LuaFunctionPlan*>(ud->ud));
+	}
+
+	int LuaFunctionPlan::push(lua_State* L, UFunction* func) {
+		// plan may be dropped by class cache while closure hold it
+		auto plan = const_cast<LuaFunctionPlan*>(LuaObject::findCachePlan(L, func));
+		plan->refCount++;
+		return LuaObject::pushType(L, plan, "LuaFunctionPlan", nullptr, finalizePlan);
+	}
+
+	void LuaFunctionPlan::release(LuaFunctionPlan* plan) {
+		if (--plan->refCount == 0)
+			delete plan;
+	}
+
+	const LuaFunctionPlan* LuaFunctionPlan::get(lua_State* L, int p) {
+		return LuaObject::checkUD<LuaFunctionPlan>(L, p);
+	}
+
+	LuaFunctionParams::LuaFunctionParams(const LuaFunctionPlan* p, void* mem)
+		: plan(p)
+		, buf((uint8*)mem)
+	{
+		if (!buf) return;
+		if (plan->isPOD)
+			FMemory::Memzero(buf, plan->structSize);
+		else
+			plan->func->InitializeStruct(buf);
+	}
+
+	LuaFunctionParams::~LuaFunctionParams()
+	{
+		// destroy params even if lua error raised
+		if (buf && !plan->isPOD)
+			plan->func->DestroyStruct(buf);
+	}
+}
@@ -0,0 +1,91 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "LuaObject.h"
+#include "UObject/Class.h"
+#include "UObject/UnrealType.h"
+
+namespace NS_SLUA {
+
+	// cached reflection info of an UFunction,
+	// built once and reused by every call from lua
+	struct LuaFunctionPlan {
+		struct Param {
+			UProperty* prop;
+			int32 offset;
+			uint64 flags;
+			LuaObject::CheckPropertyFunction checker;
+			LuaObject::PushPropertyFunction pusher;
+		};
+
+		LuaFunctionPlan(UFunction* func);
+
+		// nullptr if func had been freed by engine gc
+		UFunction* func;
+		// owned by class cache and each userdata pushed, deleted by last release
+		int32 refCount;
+		// params filled from lua stack, include latent info
+		TArray<Param> inputs;
+		// return value(if has) and out params pushed back to lua
+		TArray<Param> outputs;
+		// all properties in params memory(include locals), used by rpc call
+		TArray<UProperty*> rpcParms;
+		// params pushed to lua if lua function called by ufunction
+		TArray<Param> args;
+		// return value(if has) and real out params, filled by lua return values
+		TArray<Param> results;
+		// index of latent info in inputs, INDEX_NONE if not latent function
+		int32 latentIndex;
+		// size of params memory
+		int32 structSize;
+		// params don't need construct or destruct
+		bool isPOD;
+		bool isNet;
+
+		// fill params from lua stack start at i
+		void fillParam(lua_State* L, int i, uint8* params) const;
+		// push return value and out params, yield if it's latent function
+		int returnValue(lua_State* L, uint8* params) const;
+		// call ufunction on obj, params had been filled
+		void call(lua_State* L, UObject* obj, uint8* params) const;
+		void callRpc(UObject* obj, uint8* params) const;
+		// fill params, call ufunction and push results
+		int invoke(lua_State* L, UObject* obj, int offset) const;
+
+		// push cached plan of func as userdata, userdata holds a ref of plan
+		static int push(lua_State* L, UFunction* func);
+		// get plan from userdata at p, raise error if isn't a plan
+		static const LuaFunctionPlan* get(lua_State* L, int p);
+		// drop a ref, delete plan if it's the last
+		static void release(LuaFunctionPlan* plan);
+	};
+
+	// params memory of a call, on stack or heap
+	struct LuaFunctionParams {
+		LuaFunctionParams(const LuaFunctionPlan* plan, void* mem);
+		~LuaFunctionParams();
+
+		uint8* get() const { return buf; }
+	private:
+		const LuaFunctionPlan* plan;
+		uint8* buf;
+	};
+
+	DefTypeName(LuaFunctionPlan);
+}
+
+// alloca params memory for plan, it's freed on scope exit
+#define LuaFunctionParamsOnStack(plan,name) \
+	NS_SLUA::LuaFunctionParams name(plan, (plan)->structSize>0 ? FMemory_Alloca((plan)->structSize) : nullptr)
@@ -0,0 +1,99 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaGCScheduler.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+
+namespace NS_SLUA {
+
+	static TAutoConsoleVariable<int32> CVarGCBudgetUs(
+		TEXT("slua.GCBudgetUs"),
+		1000,
+		TEXT("Time budget of lua gc per frame in microseconds"),
+		ECVF_Default);
+
+	static TAutoConsoleVariable<int32> CVarGCIdleBudgetUs(
+		TEXT("slua.GCIdleBudgetUs"),
+		8000,
+		TEXT("Time budget of lua gc on idle frame in microseconds"),
+		ECVF_Default);
+
+	static TAutoConsoleVariable<int32> CVarGCPacing(
+		TEXT("slua.GCPacing"),
+		200,
+		TEXT("Percent of memory allocated since last frame collected by lua gc per frame"),
+		ECVF_Default);
+
+	static TAutoConsoleVariable<int32> CVarGCMinStepKB(
+		TEXT("slua.GCMinStepKB"),
+		16,
+		TEXT("Min step size of lua gc in kb"),
+		ECVF_Default);
+
+	LuaGCScheduler::LuaGCScheduler()
+		: budgetUs(-1)
+		, pacing(-1)
+		, idle(false)
+		, lastKB(0)
+		, usPerKB(0)
+	{
+	}
+
+	bool LuaGCScheduler::tick(lua_State* L)
+	{
+		int32 kb = lua_gc(L, LUA_GCCOUNT, 0);
+		int32 allocated = FMath::Max(kb - lastKB, 0);
+
+		int32 budget = idle ? CVarGCIdleBudgetUs.GetValueOnAnyThread()
+			: (budgetUs >= 0 ? budgetUs : CVarGCBudgetUs.GetValueOnAnyThread());
+		int32 percent = pacing >= 0 ? pacing : CVarGCPacing.GetValueOnAnyThread();
+		int32 minStep = FMath::Max(CVarGCMinStepKB.GetValueOnAnyThread(), 1);
+		// allocation debt to pay this frame
+		int32 debt = FMath::Max((int32)((int64)allocated * percent / 100), minStep);
+
+		double elapsed = 0;
+		bool cycleFinished = false;
+		while (budget > 0) {
+			int32 step = debt;
+			// limit step by remaining budget
+			if (usPerKB > 0)
+				step = FMath::Clamp((int32)((budget - elapsed) / usPerKB), minStep, FMath::Max(debt, minStep));
+
+			double start = FPlatformTime::Seconds();
+			bool finished = lua_gc(L, LUA_GCSTEP, step) != 0;
+			double cost = (FPlatformTime::Seconds() - start) * 1000000.0;
+
+			double sample = cost / step;
+			usPerKB = usPerKB > 0 ? usPerKB * 0.8 + sample * 0.2 : sample;
+			elapsed += cost;
+			debt -= step;
+			cycleFinished = cycleFinished || finished;
+
+			if (elapsed >= budget || finished)
+				break;
+			// idle frame collect until cycle finished or out of budget
+			if (debt <= 0 && !idle)
+				break;
+		}
+
+		lastKB = lua_gc(L, LUA_GCCOUNT, 0);
+		return cycleFinished;
+	}
+
+	void LuaGCScheduler::fullGC(lua_State* L)
+	{
+		lua_gc(L, LUA_GCCOLLECT, 0);
+		lastKB = lua_gc(L, LUA_GCCOUNT, 0);
+	}
+}
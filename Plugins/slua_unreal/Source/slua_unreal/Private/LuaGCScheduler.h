@@ -0,0 +1,47 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "lua/lua.hpp"
+
+namespace NS_SLUA {
+
+	// step lua gc in per frame time budget,
+	// step size adapt to memory allocated since last frame and measured step cost
+	class LuaGCScheduler {
+	public:
+		LuaGCScheduler();
+
+		// time budget per frame in microseconds, negative to use cvar slua.GCBudgetUs
+		void setBudget(int32 us) { budgetUs = us; }
+		// percent of allocated memory to collect per frame, negative to use cvar slua.GCPacing
+		void setPacing(int32 percent) { pacing = percent; }
+		// idle frame use slua.GCIdleBudgetUs and step until gc cycle finished
+		void setIdle(bool b) { idle = b; }
+
+		// called every frame, return true if a gc cycle finished
+		bool tick(lua_State* L);
+		// full collect, e.g. on loading screen
+		void fullGC(lua_State* L);
+
+	private:
+		int32 budgetUs;
+		int32 pacing;
+		bool idle;
+		// memory in kb after last tick
+		int32 lastKB;
+		// average cost of collecting 1kb
+		double usPerKB;
+	};
+}
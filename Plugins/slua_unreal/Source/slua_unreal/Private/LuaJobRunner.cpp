@@ -0,0 +1,177 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaJobRunner.h"
+#include "LuaState.h"
+#include "LuaProfiler.h"
+#include "Log.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Stats/Stats.h"
+
+namespace NS_SLUA {
+
+	static TAutoConsoleVariable<int32> CVarJobBudgetUs(
+		TEXT("slua.JobBudgetUs"),
+		2000,
+		TEXT("Time budget of lua jobs per frame in microseconds"),
+		ECVF_Default);
+
+	LuaJobRunner::LuaJobRunner()
+		: budgetUs(-1)
+		, jobId(0)
+		, frame(0)
+		, running(0)
+		, runningThread(nullptr)
+		, frameEnd(0)
+	{
+	}
+
+	int32 LuaJobRunner::start(lua_State* L, int fn, int32 priority, const char* name)
+	{
+		luaL_checktype(L, fn, LUA_TFUNCTION);
+		lua_State* thread = lua_newthread(L);
+		lua_pushvalue(L, fn);
+		lua_xmove(L, thread, 1);
+		// ref pop thread from stack
+		int threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
+
+		if (++jobId <= 0) jobId = 1;
+		Job job = { jobId, priority, thread, threadRef, name ? name : "LuaJob", 0, 0, 0, 0, false };
+
+		// insert after jobs with higher or same priority
+		int32 index = 0;
+		while (index < jobs.Num() && jobs[index].priority >= priority)
+			index++;
+		jobs.Insert(MoveTemp(job), index);
+		return jobId;
+	}
+
+	bool LuaJobRunner::cancel(lua_State* L, int32 id)
+	{
+		int32 index = indexOf(id);
+		if (index == INDEX_NONE || jobs[index].cancelled)
+			return false;
+		// running job is removed after it yield
+		if (id == running)
+			jobs[index].cancelled = true;
+		else
+			remove(L, index);
+		return true;
+	}
+
+	bool LuaJobRunner::shouldYield(lua_State* L) const
+	{
+		return runningThread == L && FPlatformTime::Cycles64() >= frameEnd;
+	}
+
+	const LuaJobRunner::Job* LuaJobRunner::find(int32 id) const
+	{
+		int32 index = indexOf(id);
+		return index != INDEX_NONE ? &jobs[index] : nullptr;
+	}
+
+	int32 LuaJobRunner::indexOf(int32 id) const
+	{
+		for (int32 i = 0; i < jobs.Num(); i++)
+			if (jobs[i].id == id)
+				return i;
+		return INDEX_NONE;
+	}
+
+	void LuaJobRunner::remove(lua_State* L, int32 index)
+	{
+		luaL_unref(L, LUA_REGISTRYINDEX, jobs[index].threadRef);
+		jobs.RemoveAt(index);
+	}
+
+	void LuaJobRunner::rotate(int32 index)
+	{
+		int32 last = index;
+		while (last + 1 < jobs.Num() && jobs[last + 1].priority == jobs[index].priority)
+			last++;
+		if (last == index) return;
+		Job job = MoveTemp(jobs[index]);
+		jobs.RemoveAt(index, 1, false);
+		jobs.Insert(MoveTemp(job), last);
+	}
+
+	void LuaJobRunner::tick(lua_State* L)
+	{
+		if (jobs.Num() == 0) return;
+
+		QUICK_SCOPE_CYCLE_COUNTER(Lua_Jobs);
+		int32 us = budgetUs >= 0 ? budgetUs : CVarJobBudgetUs.GetValueOnAnyThread();
+		uint64 now = FPlatformTime::Cycles64();
+		frameEnd = now + (uint64)(FMath::Max(us, 0) / (FPlatformTime::GetSecondsPerCycle64() * 1000000.0));
+		frame++;
+
+		// run one slice at least, so jobs always make progress
+		do {
+			Job& job = jobs[0];
+			int32 id = job.id;
+			lua_State* thread = job.thread;
+			running = id;
+			runningThread = thread;
+
+			uint64 start = FPlatformTime::Cycles64();
+			int status;
+			{
+				PROFILER_WATCHER_X(w1, job.name.c_str());
+				LuaScriptCallGuard g(L);
+				status = lua_resume(thread, L, 0);
+			}
+			now = FPlatformTime::Cycles64();
+			running = 0;
+			runningThread = nullptr;
+
+			// jobs may be changed by job started or cancelled in slice
+			int32 index = indexOf(id);
+			if (index == INDEX_NONE) continue;
+			Job& ran = jobs[index];
+			ran.cycles += now - start;
+			ran.slices++;
+			if (ran.lastFrame != frame) {
+				ran.lastFrame = frame;
+				ran.frames++;
+			}
+
+			if (status == LUA_YIELD && !ran.cancelled) {
+				// drop yielded values
+				lua_settop(thread, 0);
+				rotate(index);
+				continue;
+			}
+
+			if (status != LUA_OK && status != LUA_YIELD) {
+				const char* err = lua_tostring(thread, -1);
+				luaL_traceback(L, thread, err, 0);
+				LuaState::get(L)->onError(lua_tostring(L, -1));
+				lua_pop(L, 1);
+			}
+			remove(L, index);
+		} while (jobs.Num() > 0 && now < frameEnd);
+	}
+
+	void LuaJobRunner::clear(lua_State* L)
+	{
+		// threads are freed with registry by lua_close
+		if (L) {
+			for (auto& job : jobs)
+				luaL_unref(L, LUA_REGISTRYINDEX, job.threadRef);
+		}
+		jobs.Empty();
+		running = 0;
+		runningThread = nullptr;
+	}
+}
@@ -0,0 +1,79 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "lua/lua.hpp"
+#include <string>
+
+namespace NS_SLUA {
+
+	// run coroutine jobs in per frame time budget,
+	// higher priority jobs run first, jobs with same priority run round-robin.
+	// job give back cpu by coroutine.yield or slua.jobYield,
+	// don't wait latent action or slua.wait in job, it's resumed by runner only
+	class LuaJobRunner {
+	public:
+		struct Job {
+			int32 id;
+			int32 priority;
+			lua_State* thread;
+			int threadRef;
+			// used by profiler
+			std::string name;
+			// cpu cycles used by all slices
+			uint64 cycles;
+			int32 slices;
+			// count of frames job had run
+			int32 frames;
+			uint32 lastFrame;
+			bool cancelled;
+		};
+
+		LuaJobRunner();
+
+		// time budget per frame in microseconds, negative to use cvar slua.JobBudgetUs
+		void setBudget(int32 us) { budgetUs = us; }
+
+		// start job with function at fn, return job id
+		int32 start(lua_State* L, int fn, int32 priority, const char* name);
+		// return false if job not found
+		bool cancel(lua_State* L, int32 id);
+		// running job exceed frame budget, it should yield
+		bool shouldYield(lua_State* L) const;
+		// thread is a job being resumed by runner
+		bool isRunning(lua_State* thread) const { return runningThread == thread; }
+		// return nullptr if job finished or not found
+		const Job* find(int32 id) const;
+		const TArray<Job>& getJobs() const { return jobs; }
+
+		// called every frame from LuaState::Tick
+		void tick(lua_State* L);
+		void clear(lua_State* L);
+
+	private:
+		int32 budgetUs;
+		int32 jobId;
+		uint32 frame;
+		// sorted by priority, first job run first
+		TArray<Job> jobs;
+		int32 running;
+		lua_State* runningThread;
+		uint64 frameEnd;
+
+		int32 indexOf(int32 id) const;
+		void remove(lua_State* L, int32 index);
+		// move job to tail of jobs with same priority
+		void rotate(int32 index);
+	};
+}
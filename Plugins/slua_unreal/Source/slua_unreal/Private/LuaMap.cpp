@@ -38,15 +38,15 @@ namespace NS_SLUA {
 
 	int LuaMap::push(lua_State* L, UProperty* keyProp, UProperty* valueProp, const FScriptMap* buf, bool frombp) {
 		auto luaMap = new LuaMap(keyProp, valueProp, buf, frombp);
-		return LuaObject::pushType(L, luaMap, "LuaMap", setupMT, gc);
+		return LuaObject::pushType(L, luaMap, "LuaMap", setupMT, finalize);
 	}
 
 	int LuaMap::push(lua_State* L, UMapProperty* prop, UObject* obj) {
 		auto scriptMap = prop->ContainerPtrToValuePtr<FScriptMap>(obj);
 		if(LuaObject::getFromCache(L,scriptMap,"LuaMap")) return 1;
 		auto luaMap = new LuaMap(prop,obj);
-		int r = LuaObject::pushType(L, luaMap, "LuaMap", setupMT, gc);
-		if(r) LuaObject::cacheObj(L,luaMap->map);
+		int r = LuaObject::pushType(L, luaMap, "LuaMap", setupMT, finalize);
+		if(r) LuaObject::cacheObj(L,luaMap->map,"LuaMap");
 		return 1;
 	}
 
@@ -269,7 +269,11 @@ namespace NS_SLUA {
 
 		auto valuePtr = UD->helper.FindValueFromHash(keyPtr);
 		if (valuePtr) {
-			LuaObject::push(L, UD->valueProp, valuePtr);
+			// pair with object key may be removed by engine gc, see AddReferencedObjects
+			if (UD->valueProp->GetClass() == UStructProperty::StaticClass() && !Cast<UObjectProperty>(UD->keyProp))
+				LuaObject::pushStructView(L, (UStructProperty*)UD->valueProp, valuePtr, 1);
+			else
+				LuaObject::push(L, UD->valueProp, valuePtr);
 			LuaObject::push(L, true);
 		} else {
 			LuaObject::pushNil(L);
@@ -288,6 +292,8 @@ namespace NS_SLUA {
 		auto valuePtr = tempValue.GetObjAddress();
 		keyChecker(L, UD->keyProp, (uint8*)keyPtr, 2);
 		valueChecker(L, UD->valueProp, (uint8*)valuePtr, 3);
+		// pairs may be moved
+		LuaObject::unlinkProps(L, lua_touserdata(L, 1));
 		UD->helper.AddPair(keyPtr, valuePtr);
 		return 0;
 	}
@@ -298,11 +304,13 @@ namespace NS_SLUA {
 		FDefaultConstructedPropertyElement tempKey(UD->keyProp);
 		auto keyPtr = tempKey.GetObjAddress();
 		keyChecker(L, UD->keyProp, (uint8*)keyPtr, 2);
+		LuaObject::unlinkProps(L, lua_touserdata(L, 1));
 		return LuaObject::push(L, UD->removePair(keyPtr));
 	}
 
 	int LuaMap::Clear(lua_State* L) {
 		CheckUD(LuaMap, L, 1);
+		LuaObject::unlinkProps(L, lua_touserdata(L, 1));
 		UD->clear();
 		return 0;
 	}
@@ -354,10 +362,10 @@ namespace NS_SLUA {
 		SafeDelete(holder);
 	}
 
-	int LuaMap::gc(lua_State* L) {
-		CheckUD(LuaMap, L, 1);
-		LuaObject::deleteFGCObject(L,UD);
-		return 0;
+	void LuaMap::finalize(lua_State* L, GenericUserData* ud) {
+		if (ud->flag & UD_HADFREE) return;
+		LuaObject::unlinkProps(L, ud);
+		LuaObject::deleteFGCObject(L, reinterpret_cast<LuaMap*>(ud->ud));
 	}
 
 	int LuaMap::setupMT(lua_State* L) {
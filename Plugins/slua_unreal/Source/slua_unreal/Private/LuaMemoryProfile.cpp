@@ -16,6 +16,7 @@
 #include "LuaState.h"
 #include "Log.h"
 #include "lua/lstate.h"
+#include "LuaPoolAlloc.h"
 namespace NS_SLUA {
 
 	// only calc memory alloc from lua script
@@ -64,16 +65,30 @@ namespace NS_SLUA {
 
     void* LuaMemoryProfile::alloc (void *ud, void *ptr, size_t osize, size_t nsize) {
         LuaState* ls = (LuaState*)ud;
+        LuaPoolAlloc* pool = ls->poolAlloc;
+		// osize is type of object if ptr is null
+		size_t oldSize = ptr ? osize : 0;
         if (nsize == 0) {
             removeRecord(ls, ptr, osize);
-            FMemory::Free(ptr);
+            if (pool) pool->realloc(ptr, osize, 0);
+            else FMemory::Free(ptr);
+			ls->memUsed.fetch_sub(oldSize, std::memory_order_relaxed);
             return NULL;
         }
         else {
+			size_t used = ls->memUsed.load(std::memory_order_relaxed) - oldSize + nsize;
+			// lua run emergency gc and retry, then raise memory error,
+			// never fail shrinking block, lua assume it always succeed
+			if (nsize > oldSize && ls->memHardLimit && used > ls->memHardLimit)
+				return NULL;
 			if(ptr) removeRecord(ls, ptr, osize);
-            ptr = FMemory::Realloc(ptr,nsize);
-            addRecord(ls,ptr,nsize);
-            return ptr;
+            void* nptr = pool ? pool->realloc(ptr, osize, nsize) : FMemory::Realloc(ptr,nsize);
+			if (!nptr) return NULL;
+            addRecord(ls,nptr,nsize);
+			ls->memUsed.store(used, std::memory_order_relaxed);
+			if (ls->memSoftTrigger && used > ls->memSoftTrigger)
+				ls->memSoftHit = true;
+            return nptr;
         }
     }
 
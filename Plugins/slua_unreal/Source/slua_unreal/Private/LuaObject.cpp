@@ -31,13 +31,15 @@
 #include "Log.h"
 #include "LuaState.h"
 #include "LuaWrapper.h"
+#include "LuaObjectCache.h"
+#include "LuaObjectRefs.h"
 #include "SluaUtil.h"
 #include "LuaReference.h"
 #include "LuaBase.h"
+#include "LuaFunctionPlan.h"
 #include "Engine/UserDefinedEnum.h"
 
 namespace NS_SLUA { 
-	static const FName NAME_LatentInfo = TEXT("LatentInfo");
 
 	TMap<UClass*,LuaObject::PushPropertyFunction> pusherMap;
 	TMap<UClass*,LuaObject::CheckPropertyFunction> checkerMap;
@@ -136,12 +138,12 @@ namespace NS_SLUA {
     DefTypeName(LuaStruct)
 
     // construct lua struct
-    LuaStruct::LuaStruct(uint8* b,uint32 s,UScriptStruct* u)
-        :buf(b),size(s),uss(u) {
+    LuaStruct::LuaStruct(uint8* b,uint32 s,UScriptStruct* u,bool view)
+        :buf(b),size(s),uss(u),isView(view) {
     }
 
     LuaStruct::~LuaStruct() {
-		if (buf) {
+		if (buf && !isView) {
 			uss->DestroyStruct(buf);
 			FMemory::Free(buf);
 			buf = nullptr;
@@ -150,6 +152,8 @@ namespace NS_SLUA {
 
 	void LuaStruct::AddReferencedObjects(FReferenceCollector& Collector) {
 		Collector.AddReferencedObject(uss);
+		// referenced by parent, and buf may have been freed with parent
+		if (isView) return;
 		LuaReference::addRefByStruct(Collector, uss, buf);
 	}
 
@@ -289,6 +293,9 @@ namespace NS_SLUA {
 
 		luaL_newmetatable(L, tn);
 		setMetaMethods(L);
+		// assign type id and cache metatable at registration
+		pushMetatable(L, typeIdOf(tn));
+		lua_pop(L, 1);
 	}
 
     void LuaObject::newTypeWithBase(lua_State* L, const char* tn, std::initializer_list<const char*> bases) {
@@ -308,6 +315,7 @@ namespace NS_SLUA {
         }
         // pop __base table
         lua_pop(L,1);
+		setTypeBases(typeIdOf(tn), bases);
 	}
 
 	int LuaObject::push(lua_State * L, const LuaLString& lstr)
@@ -317,24 +325,8 @@ namespace NS_SLUA {
 	}
 
 	bool LuaObject::isBaseTypeOf(lua_State* L,const char* tn,const char* base) {
-        AutoStack as(L);
-        int t = luaL_getmetatable(L,tn);
-        if(t!=LUA_TTABLE)
-            return false;
-
-        if(lua_getfield(L,-1,"__base")==LUA_TTABLE) {
-            size_t len = lua_rawlen(L,-1);
-            for(int n=0;n<len;n++) {
-                if(lua_geti(L,-1,n+1)==LUA_TSTRING) {
-                    const char* maybeBase = lua_tostring(L,-1);
-                    if(strcmp(maybeBase,base)==0) return true;
-                    else return isBaseTypeOf(L,maybeBase,base);
-                }
-            }
-            return false;
-        }
-        return false;
-    }
+		return isBaseTypeOf(typeIdOf(tn), typeIdOf(base));
+	}
 
 	void LuaObject::addMethod(lua_State* L, const char* name, lua_CFunction func, bool isInstance) {
 		lua_pushcfunction(L, func);
@@ -362,7 +354,137 @@ namespace NS_SLUA {
 		lua_setfield(L, -2, name);
 	}
 
+	// id - 1 -> ids of direct bases in declared order, recorded by newTypeWithBase
+	static TArray<TArray<uint32>> typeBases;
+	// id - 1 -> bit n is set if type n is an ancestor, complete once the type is flattened
+	static TArray<TBitArray<>> typeAncestors;
+
+	void LuaObject::setTypeBases(uint32 id, std::initializer_list<const char*> bases) {
+		if (id > (uint32)typeBases.Num())
+			typeBases.SetNum(id);
+		TArray<uint32>& ids = typeBases[id - 1];
+		ids.Reset();
+		for (auto base : bases) {
+			if (strlen(base) > 0)
+				ids.Add(typeIdOf(base));
+		}
+	}
+
+	bool LuaObject::isBaseTypeOf(uint32 id, uint32 base) {
+		if (id == 0 || id > (uint32)typeAncestors.Num())
+			return false;
+		const TBitArray<>& ancestors = typeAncestors[id - 1];
+		return base < (uint32)ancestors.Num() && ancestors[base];
+	}
+
+	static bool hasField(lua_State* L, int t, const char* k) {
+		bool has = lua_getfield(L, t, k) != LUA_TNIL;
+		lua_pop(L, 1);
+		return has;
+	}
+
+	// copy string keyed members of table at top into dst, if key is absent in dst and skip
+	static void mergeAbsent(lua_State* L, int dst, int skip) {
+		lua_pushnil(L);
+		while (lua_next(L, -2)) {
+			if (lua_type(L, -2) == LUA_TSTRING) {
+				const char* k = lua_tostring(L, -2);
+				// metamethods, __base and member tables aren't inherited
+				bool own = k[0] == '.' || (k[0] == '_' && k[1] == '_');
+				if (!own && !hasField(L, dst, k) && !(skip && hasField(L, skip, k))) {
+					lua_pushvalue(L, -2);
+					lua_pushvalue(L, -2);
+					lua_rawset(L, dst);
+				}
+			}
+			lua_pop(L, 1);
+		}
+	}
+
+	// merge members of base metatable at top into derived metatable at mt,
+	// members of derived or earlier base win, same order as the __base walk of findMember
+	static void mergeMembers(lua_State* L, int mt) {
+		int base = lua_gettop(L);
+		lua_getfield(L, mt, ".get");
+		int get = lua_gettop(L);
+		lua_getfield(L, mt, ".set");
+		int set = lua_gettop(L);
+		// methods, hidden by getter of derived
+		lua_pushvalue(L, base);
+		mergeAbsent(L, mt, get);
+		lua_pop(L, 1);
+		// getters, hidden by method of derived
+		lua_getfield(L, base, ".get");
+		mergeAbsent(L, get, mt);
+		lua_pop(L, 1);
+		lua_getfield(L, base, ".set");
+		mergeAbsent(L, set, 0);
+		lua_settop(L, base);
+	}
+
+	bool LuaObject::flattenType(lua_State* L, uint32 id) {
+		auto& pending = LuaState::get(L)->pendingFlatTypes;
+		const TArray<uint32>& bases = typeBases[id - 1];
+		// bases should be finished and flattened first
+		for (uint32 base : bases) {
+			if (pending.Contains(base))
+				return false;
+			pushMetatable(L, base);
+			bool exported = lua_istable(L, -1);
+			lua_pop(L, 1);
+			if (!exported)
+				return false;
+		}
+
+		int32 numBits = 0;
+		for (uint32 base : bases) {
+			numBits = FMath::Max<int32>(numBits, base + 1);
+			if (base <= (uint32)typeAncestors.Num())
+				numBits = FMath::Max(numBits, typeAncestors[base - 1].Num());
+		}
+		TBitArray<> ancestors(false, numBits);
+		for (uint32 base : bases) {
+			ancestors[base] = true;
+			if (base <= (uint32)typeAncestors.Num()) {
+				const TBitArray<>& inherited = typeAncestors[base - 1];
+				for (TConstSetBitIterator<> it(inherited); it; ++it)
+					ancestors[it.GetIndex()] = true;
+			}
+		}
+		if (id > (uint32)typeAncestors.Num())
+			typeAncestors.SetNum(id);
+		typeAncestors[id - 1] = MoveTemp(ancestors);
+
+		pushMetatable(L, id);
+		int mt = lua_gettop(L);
+		for (uint32 base : bases) {
+			pushMetatable(L, base);
+			mergeMembers(L, mt);
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+		return true;
+	}
+
 	void LuaObject::finishType(lua_State* L, const char* tn, lua_CFunction ctor, lua_CFunction gc, lua_CFunction strHint) {
+		uint32 id = typeIdOf(tn);
+		auto& pending = LuaState::get(L)->pendingFlatTypes;
+		// classes are registered in any order, wait for bases if not ready
+		if (id <= (uint32)typeBases.Num() && typeBases[id - 1].Num() > 0 && !flattenType(L, id))
+			pending.Add(id);
+		// this type may be the last base that pending types are waiting for
+		for (bool progress = true; progress && pending.Num() > 0;) {
+			progress = false;
+			for (int32 i = pending.Num() - 1; i >= 0; i--) {
+				uint32 pid = pending[i];
+				pending.RemoveAt(i);
+				if (flattenType(L, pid))
+					progress = true;
+				else
+					pending.Insert(pid, i);
+			}
+		}
+
         if(ctor) {
 		    lua_pushcclosure(L, ctor, 0);
 		    lua_setfield(L, -3, "__call");
@@ -378,7 +500,116 @@ namespace NS_SLUA {
         lua_pop(L,3);
 	}
 
+	void LuaObject::finishType(lua_State* L, const char* tn, lua_CFunction ctor, UDFinalizer gc, lua_CFunction strHint) {
+		if (gc) setFinalizer(L, gc);
+		finishType(L, tn, ctor, (lua_CFunction)nullptr, strHint);
+	}
+
+	// tag of finalizer is index + 1, shared by all states
+	static TArray<LuaObject::UDFinalizer> finalizers;
+
+	static int finalizerTag(LuaObject::UDFinalizer gc) {
+		int32 index = finalizers.Find(gc);
+		if (index == INDEX_NONE) {
+			// tag is saved as unsigned short in userdata
+			ensure(finalizers.Num() < 0xffff);
+			index = finalizers.Add(gc);
+		}
+		return index + 1;
+	}
+
+	void LuaObject::setFinalizer(lua_State* L, UDFinalizer gc) {
+		lua_pushlightuserdata(L, (void*)(size_t)finalizerTag(gc));
+		lua_setfield(L, -2, "__gc");
+	}
+
+	void LuaObject::finalizeUD(lua_State* L, int tag, void* ud) {
+		// drop cache entry before its memory freed, key is saved as user value by cacheObj
+		if (void* key = lua_touduservalue(ud))
+			LuaState::get(L)->objCache->remove(key, ud);
+		if (tag > 0 && tag <= finalizers.Num())
+			finalizers[tag - 1](L, reinterpret_cast<GenericUserData*>(ud));
+	}
+
+	// id - 1 -> type name, shared by all states like finalizers
+	static TArray<SimpleString> typeNames;
+	// crc of type name -> first id, ids with same crc are linked by typeIdNext
+	static TMap<uint32, uint32> typeIdByCrc;
+	static TArray<uint32> typeIdNext;
+
+	uint32 LuaObject::typeIdOf(const char* tn) {
+		if (!tn) return 0;
+		uint32 crc = FCrc::StrCrc32(tn);
+		uint32* first = typeIdByCrc.Find(crc);
+		for (uint32 id = first ? *first : 0; id; id = typeIdNext[id - 1]) {
+			if (strcmp(typeNames[id - 1].c_str(), tn) == 0)
+				return id;
+		}
+		typeNames.Add(SimpleString(tn));
+		typeIdNext.Add(first ? *first : 0);
+		uint32 id = typeNames.Num();
+		typeIdByCrc.Add(crc, id);
+		return id;
+	}
+
+	const char* LuaObject::typeNameOf(uint32 id) {
+		if (id == 0 || id > (uint32)typeNames.Num()) return nullptr;
+		return typeNames[id - 1].c_str();
+	}
+
+	void LuaObject::pushMetatable(lua_State* L, uint32 id) {
+		const char* tn = typeNameOf(id);
+		if (!tn) {
+			lua_pushnil(L);
+			return;
+		}
+		auto& refs = LuaState::get(L)->typeMetatableRefs;
+		if (id < (uint32)refs.Num() && refs[id] != LUA_NOREF) {
+			lua_rawgeti(L, LUA_REGISTRYINDEX, refs[id]);
+			return;
+		}
+		// not exported yet, don't cache nil
+		if (luaL_getmetatable(L, tn) != LUA_TTABLE)
+			return;
+		if (id >= (uint32)refs.Num()) {
+			int32 from = refs.Num();
+			refs.SetNumUninitialized(id + 1);
+			for (int32 i = from; i < refs.Num(); i++) refs[i] = LUA_NOREF;
+		}
+		lua_pushvalue(L, -1);
+		refs[id] = luaL_ref(L, LUA_REGISTRYINDEX);
+	}
+
+	void* LuaObject::testudataById(lua_State* L, int p, uint32 id) {
+		// light userdata or foreign userdata may be smaller than header
+		if (lua_type(L, p) != LUA_TUSERDATA || lua_rawlen(L, p) < sizeof(GenericUserData))
+			return nullptr;
+		UDBase* ud = reinterpret_cast<UDBase*>(lua_touserdata(L, p));
+		// userdata with native finalizer tag is always binding userdata, trust its header
+		int tag = lua_getudtag(L, p);
+		if (tag > 0 && tag <= finalizers.Num())
+			return ud->typeId == id ? ud : nullptr;
+		if (ud->typeId != id)
+			return nullptr;
+		// foreign userdata or one with lua __gc, confirm header by metatable
+		if (!lua_getmetatable(L, p))
+			return nullptr;
+		pushMetatable(L, id);
+		bool same = lua_rawequal(L, -1, -2) != 0;
+		lua_pop(L, 2);
+		return same ? ud : nullptr;
+	}
+
+	uint32 LuaObject::typeIdAt(lua_State* L, int p) {
+		if (lua_type(L, p) != LUA_TUSERDATA || lua_rawlen(L, p) < sizeof(GenericUserData))
+			return 0;
+		uint32 id = reinterpret_cast<UDBase*>(lua_touserdata(L, p))->typeId;
+		return testudataById(L, p, id) ? id : 0;
+	}
+
 	bool LuaObject::matchType(lua_State* L, int p, const char* tn, bool noprefix) {
+		if (!noprefix)
+			return testudataById(L, p, typeIdOf(tn)) != nullptr;
 		AutoStack autoStack(L);
 		if (!lua_isuserdata(L, p)) {
 			return false;
@@ -446,7 +677,7 @@ namespace NS_SLUA {
         return 0;
     }
 
-    int searchExtensionMethod(lua_State* L,UClass* cls,const char* name,bool isStatic=false) {
+    int searchExtensionMethod(lua_State* L,UClass* cls,const char* name,bool isStatic=false,bool* isFunction=nullptr) {
 
         // search class and its super
         TMap<FString,ExtensionField>* mapptr=nullptr;
@@ -459,6 +690,7 @@ namespace NS_SLUA {
 					// is function
 					if (fieldptr->isFunction) {
 						lua_pushcfunction(L, fieldptr->func);
+						if (isFunction) *isFunction = true;
 						return 1;
 					} 
 					// is property
@@ -484,13 +716,35 @@ namespace NS_SLUA {
         return searchExtensionMethod(L,cls,name,isStatic);
     }
 
+    // save value on top to members table at index t by key at index 2
+    static void cacheMember(lua_State* L, int t) {
+        lua_pushvalue(L, 2);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, t);
+    }
+
     int classIndex(lua_State* L) {
         UClass* cls = LuaObject::checkValue<UClass*>(L, 1);
         const char* name = LuaObject::checkValue<const char*>(L, 2);
+        // search static members cache by interned name
+        LuaObject::pushCacheMembers(L, cls, true);
+        int members = lua_gettop(L);
+        lua_pushvalue(L, 2);
+        if (lua_rawget(L, members) == LUA_TFUNCTION)
+            return 1;
+        lua_pop(L, 1);
+
         // get blueprint member
         UFunction* func = cls->FindFunctionByName(UTF8_TO_TCHAR(name));
-        if(func) return LuaObject::push(L,func,cls);
-        return searchExtensionMethod(L,cls,name,true);
+        if(func) {
+            LuaObject::push(L,func,cls);
+            cacheMember(L, members);
+            return 1;
+        }
+        bool isFunction = false;
+        int ret = searchExtensionMethod(L,cls,name,true,&isFunction);
+        if (isFunction) cacheMember(L, members);
+        return ret;
     }
 
     int structConstruct(lua_State* L) {
@@ -507,117 +761,12 @@ namespace NS_SLUA {
         return 0;
     }
 
-    int fillParamFromState(lua_State* L,UProperty* prop,uint8* params,int i) {
-
-        // if is out param, can accept nil
-        uint64 propflag = prop->GetPropertyFlags();
-        if(propflag&CPF_OutParm && lua_isnil(L,i))
-            return prop->GetSize();
-
-        auto checker = LuaObject::getChecker(prop);
-        if(checker) {
-            checker(L,prop,params,i);
-            return prop->GetSize();
-        }
-        else {
-            FString tn = prop->GetClass()->GetName();
-            luaL_error(L,"unsupport param type %s at %d",TCHAR_TO_UTF8(*tn),i);
-            return 0;
-        }
-        
-    }
-
     void LuaObject::fillParam(lua_State* L,int i,UFunction* func,uint8* params) {
-		auto funcFlag = func->FunctionFlags;
-        for(TFieldIterator<UProperty> it(func);it && (it->PropertyFlags&CPF_Parm);++it) {
-            UProperty* prop = *it;
-            uint64 propflag = prop->GetPropertyFlags();
-			if (funcFlag & EFunctionFlags::FUNC_Native) {
-				if ((propflag&CPF_ReturnParm))
-					continue;
-			}
-			else if (IsRealOutParam(propflag))
-				continue;
-
-			if (prop->GetFName() == NAME_LatentInfo) {
-				// bind a callback to the latent function
-				lua_State *mainThread = G(L)->mainthread;
-
-				ULatentDelegate *obj = LuaObject::getLatentDelegate(mainThread);
-				int threadRef = obj->getThreadRef(L);
-				FLatentActionInfo LatentActionInfo(threadRef, GetTypeHash(FGuid::NewGuid()), *ULatentDelegate::NAME_LatentCallback, obj);
-
-				prop->CopySingleValue(prop->ContainerPtrToValuePtr<void>(params), &LatentActionInfo);
-			}
-			else {
-				fillParamFromState(L, prop, params + prop->GetOffset_ForInternal(), i);
-				i++;
-			}
-        }
+		findCachePlan(L, func)->fillParam(L, i, params);
     }
 
 	void LuaObject::callRpc(lua_State* L, UObject* obj, UFunction* func, uint8* params) {
-		// call rpc without outparams
-		const bool bHasReturnParam = func->ReturnValueOffset != MAX_uint16;
-		uint8* ReturnValueAddress = bHasReturnParam ? ((uint8*)params + func->ReturnValueOffset) : nullptr;
-        
-        #if ENGINE_MINOR_VERSION >= 23 && (PLATFORM_MAC || PLATFORM_IOS)
-            FNewFrame NewStack(obj, func, params, NULL, func->Children);
-        #else
-            FFrame NewStack(obj, func, params, NULL, func->Children);
-        #endif
-        
-        #if ENGINE_MINOR_VERSION < 25
-            if (func->ReturnValueOffset != MAX_uint16) {
-                UProperty* ReturnProperty = func->GetReturnProperty();
-                if (ensure(ReturnProperty)) {
-                    FOutParmRec* RetVal = (FOutParmRec*)FMemory_Alloca(sizeof(FOutParmRec));
-
-                    /* Our context should be that we're in a variable assignment to the return value, so ensure that we have a valid property to return to */
-                    RetVal->PropAddr = (uint8*)FMemory_Alloca(ReturnProperty->GetSize());
-                    RetVal->Property = ReturnProperty;
-                    NewStack.OutParms = RetVal;
-                }
-            }
-
-            NewStack.Locals = params;
-            FOutParmRec** LastOut = &NewStack.OutParms;
-
-            for (UProperty* Property = (UProperty*)func->Children; Property!=nullptr; Property = (UProperty*)Property->Next){
-                if (Property->PropertyFlags & CPF_OutParm){
-
-                    CA_SUPPRESS(6263)
-                        FOutParmRec* Out = (FOutParmRec*)FMemory_Alloca(sizeof(FOutParmRec));
-                    // set the address and property in the out param info
-                    // warning: Stack.MostRecentPropertyAddress could be NULL for optional out parameters
-                    // if that's the case, we use the extra memory allocated for the out param in the function's locals
-                    // so there's always a valid address
-                    Out->PropAddr = Property->ContainerPtrToValuePtr<uint8>(NewStack.Locals);
-                    Out->Property = Property;
-
-                    // add the new out param info to the stack frame's linked list
-                    if (*LastOut) {
-                        (*LastOut)->NextOutParm = Out;
-                        LastOut = &(*LastOut)->NextOutParm;
-                    } else {
-                        *LastOut = Out;
-                    }
-                } else {
-                    // copy the result of the expression for this parameter into the appropriate part of the local variable space
-                    uint8* Param = Property->ContainerPtrToValuePtr<uint8>(NewStack.Locals);
-                    Property->InitializeValue_InContainer(NewStack.Locals);
-                }
-            }
-        #else
-            NewStack.OutParms = nullptr;
-        #endif
-    
-        #if ENGINE_MINOR_VERSION >= 23 && (PLATFORM_MAC || PLATFORM_IOS)
-            FFrame *frame = (FFrame *)&NewStack;
-            func->Invoke(obj, *frame, ReturnValueAddress);
-        #else
-            func->Invoke(obj, NewStack, ReturnValueAddress);
-        #endif
+		findCachePlan(L, func)->callRpc(obj, params);
 	}
 
 	void LuaObject::callUFunction(lua_State* L, UObject* obj, UFunction* func, uint8* params) {
@@ -632,47 +781,13 @@ namespace NS_SLUA {
 
     // handle return value and out params
     int LuaObject::returnValue(lua_State* L,UFunction* func,uint8* params) {
-
-        // check is function has return value
-		const bool bHasReturnParam = func->ReturnValueOffset != MAX_uint16;
-
-		// put return value as head
-        int ret = 0;
-        if(bHasReturnParam) {
-            UProperty* p = func->GetReturnProperty();
-            ret += LuaObject::push(L,p,params+p->GetOffset_ForInternal());
-        }
-
-		bool isLatentFunction = false;
-        // push out parms
-        for(TFieldIterator<UProperty> it(func);it;++it) {
-            UProperty* p = *it;
-            uint64 propflag = p->GetPropertyFlags();
-            // skip return param
-            if(propflag&CPF_ReturnParm)
-                continue;
-
-			if (p->GetFName() == NAME_LatentInfo) {
-				isLatentFunction = true;
-			}
-            else if(IsRealOutParam(propflag)) // out params should be not const and not readonly
-                ret += LuaObject::push(L,p,params+p->GetOffset_ForInternal());
-        }
-        
-		if (isLatentFunction) {
-			return lua_yield(L, ret);
-		}
-		else {
-			return ret;
-		}
+		return findCachePlan(L, func)->returnValue(L, params);
     }
    
     int ufuncClosure(lua_State* L) {
-        lua_pushvalue(L,lua_upvalueindex(1));
-        void* ud = lua_touserdata(L, -1);
-        lua_pop(L, 1); // pop ud of func
-        
-        if(!ud) luaL_error(L, "Call ufunction error");
+        // call plan of ufunction at upvalue 1
+        const LuaFunctionPlan* plan = LuaFunctionPlan::get(L, lua_upvalueindex(1));
+        if(!plan || !plan->func) luaL_error(L, "Call ufunction error");
 
         lua_pushvalue(L,lua_upvalueindex(2));
         UClass* cls = reinterpret_cast<UClass*>(lua_touserdata(L, -1));
@@ -689,27 +804,7 @@ namespace NS_SLUA {
             offset++;
         }
         
-        UFunction* func = reinterpret_cast<UFunction*>(ud);
-        
-		FStructOnScope params(func);
-		LuaObject::fillParam(L, offset, func, params.GetStructMemory());
-		{
-			LuaObject::callUFunction(L, obj, func, params.GetStructMemory());
-		}
-		// return value to push lua stack
-		return LuaObject::returnValue(L, func, params.GetStructMemory());
-    }
-
-    // find ufunction from cache
-    UFunction* LuaObject::findCacheFunction(lua_State* L, UClass* cls,const char* fname) {
-        auto state = LuaState::get(L);
-		return state->classMap.findFunc(cls, fname);
-    }
-
-    // cache ufunction for reuse
-    void LuaObject::cacheFunction(lua_State* L,UClass* cls,const char* fname,UFunction* func) {
-        auto state = LuaState::get(L);
-        state->classMap.cacheFunc(cls,fname,func);
+		return plan->invoke(L, obj, offset);
     }
 
     UProperty* LuaObject::findCacheProperty(lua_State* L, UClass* cls, const char* pname)
@@ -724,47 +819,54 @@ namespace NS_SLUA {
 		state->classMap.cacheProp(cls, pname, property);
     }
 
-	// cache class property's
-	void cachePropertys(lua_State* L, UClass* cls) {
-		auto PropertyLink = cls->PropertyLink;
-		for (UProperty* Property = PropertyLink; Property != NULL; Property = Property->PropertyLinkNext) {
-			LuaObject::cacheProperty(L, cls, TCHAR_TO_UTF8(*(Property->GetName())), Property);
-		}
-	}
+    void LuaObject::pushCacheMembers(lua_State* L, UClass* cls, bool isStatic)
+    {
+		auto state = LuaState::get(L);
+		state->classMap.pushMembers(L, cls, isStatic);
+    }
+
+    const LuaFunctionPlan* LuaObject::findCachePlan(lua_State* L, UFunction* func)
+    {
+		auto state = LuaState::get(L);
+		return state->classMap.findPlan(func);
+    }
+
     int instanceIndex(lua_State* L) {
         UObject* obj = LuaObject::checkValue<UObject*>(L, 1);
         const char* name = LuaObject::checkValue<const char*>(L, 2);
 
 		UClass* cls = obj->GetClass();
-        UProperty* up = LuaObject::findCacheProperty(L, cls, name);
-        if (up)
-        {
-            return LuaObject::push(L, up, obj, false);
-        }
-
-        UFunction* func = LuaObject::findCacheFunction(L, cls, name);
-        if (func)
-        {
-            return LuaObject::push(L, func);
-        }
+		// search members cache by interned name,
+		// property is lightuserdata, function is cached closure
+		LuaObject::pushCacheMembers(L, cls, false);
+		int members = lua_gettop(L);
+		lua_pushvalue(L, 2);
+		switch (lua_rawget(L, members)) {
+		case LUA_TLIGHTUSERDATA: {
+			UProperty* up = (UProperty*)lua_touserdata(L, -1);
+			if (up->GetClass() == UStructProperty::StaticClass())
+				return LuaObject::pushStructView(L, (UStructProperty*)up, up->ContainerPtrToValuePtr<uint8>(obj), 1);
+			return LuaObject::push(L, up, obj, false);
+		}
+		case LUA_TFUNCTION:
+			return 1;
+		}
+		lua_pop(L, 1);
 
         // get blueprint member
 		FName wname(UTF8_TO_TCHAR(name));
-        func = cls->FindFunctionByName(wname);
+        UFunction* func = cls->FindFunctionByName(wname);
         if(!func) {
-			cachePropertys(L, cls);
-
-			up = LuaObject::findCacheProperty(L, cls, name);
-            if (up) {
-                return LuaObject::push(L, up, obj, false);
-            }
-            
             // search extension method
-            return searchExtensionMethod(L, obj, name);
+			bool isFunction = false;
+			int ret = searchExtensionMethod(L, cls, name, false, &isFunction);
+			if (isFunction) cacheMember(L, members);
+			return ret;
         }
         else {   
-			LuaObject::cacheFunction(L, cls, name, func);
-            return LuaObject::push(L,func);
+            LuaObject::push(L,func);
+			cacheMember(L, members);
+			return 1;
         }
     }
 
@@ -772,12 +874,12 @@ namespace NS_SLUA {
         UObject* obj = LuaObject::checkValue<UObject*>(L, 1);
         const char* name = LuaObject::checkValue<const char*>(L, 2);
         UClass* cls = obj->GetClass();
-		UProperty* up = LuaObject::findCacheProperty(L, cls, name);
-		if (!up)
-		{
-			cachePropertys(L, cls);
-			up = LuaObject::findCacheProperty(L, cls, name);
-		}
+		LuaObject::pushCacheMembers(L, cls, false);
+		lua_pushvalue(L, 2);
+		UProperty* up = nullptr;
+		if (lua_rawget(L, -2) == LUA_TLIGHTUSERDATA)
+			up = (UProperty*)lua_touserdata(L, -1);
+		lua_pop(L, 2);
 		if (!up) luaL_error(L, "Property %s not found", name);
         if(up->GetPropertyFlags() & CPF_BlueprintReadOnly)
             luaL_error(L,"Property %s is readonly",name);
@@ -828,6 +930,8 @@ namespace NS_SLUA {
         auto* cls = ls->uss;
         UProperty* up = FindStructPropertyByName(cls, name);
         if(!up) return 0;
+        if (up->GetClass() == UStructProperty::StaticClass())
+            return LuaObject::pushStructView(L, (UStructProperty*)up, ls->buf + up->GetOffset_ForInternal(), 1);
         return LuaObject::push(L,up,ls->buf+up->GetOffset_ForInternal(),false);
     }
 
@@ -896,27 +1000,24 @@ namespace NS_SLUA {
 		lua_setmetatable(L, -2);
 	}
 
-	void LuaObject::setupMetaTable(lua_State* L, const char* tn, lua_CFunction setupmt, int gc)
+	void LuaObject::setupMetaTable(lua_State* L, const char* tn, lua_CFunction setupmt, UDFinalizer gc)
 	{
 		if (luaL_newmetatable(L, tn)) {
 			if (setupmt)
 				setupmt(L);
-			if (gc) {
-				lua_pushvalue(L, gc);
-				lua_setfield(L, -2, "__gc");
-			}
+			if (gc)
+				setFinalizer(L, gc);
 		}
 		lua_setmetatable(L, -2);
 	}
 
-	void LuaObject::setupMetaTable(lua_State* L, const char* tn, lua_CFunction gc)
+	void LuaObject::setupMetaTable(lua_State* L, const char* tn, UDFinalizer gc)
 	{
 		luaL_getmetatable(L, tn);
 		if (lua_isnil(L, -1))
 			luaL_error(L, "Can't find type %s exported", tn);
 
-		lua_pushcfunction(L, gc);
-		lua_setfield(L, -2, "__gc");
+		setFinalizer(L, gc);
 		lua_setmetatable(L, -2);
 	}
 
@@ -1137,9 +1238,14 @@ namespace NS_SLUA {
 		return false;
 	}
 
-    // search obj from registry, push cached obj and return true if find it
+    // search obj from cache, push cached obj and return true if find it
     bool LuaObject::getFromCache(lua_State* L,void* obj,const char* tn,bool check) {
         LuaState* ls = LuaState::get(L);
+        // userdata may be collected but not finalized yet, lua_pushudata return 0 for it
+        void* ud = ls->objCache->find(obj,typeIdOf(tn));
+        if(ud && lua_pushudata(L,ud)) return true;
+        if(!ls->weakCacheUsed) return false;
+
         ensure(ls->cacheObjRef!=LUA_NOREF);
         lua_geti(L,LUA_REGISTRYINDEX,ls->cacheObjRef);
         // should be a table
@@ -1157,7 +1263,10 @@ namespace NS_SLUA {
 		if (!check)
 			return true;
 		// check type of ud matched
-		return checkType(L, -1, tn);
+		if (checkType(L, -1, tn))
+			return true;
+		lua_pop(L, 1);
+		return false;
     }
 
     void LuaObject::addRef(lua_State* L,UObject* obj,void* ud,bool ref) {
@@ -1176,13 +1285,69 @@ namespace NS_SLUA {
 		ls->releaseLink(prop);
 	}
 
+	void LuaObject::unlinkProps(lua_State* L, void* parent) {
+		auto ls = LuaState::get(L);
+		ls->unlinkProps(parent);
+	}
+
+	// userdata that views can be linked to, smart pointers and weak objects may free memory without notify
+	static bool canOwnView(lua_State* L, int p) {
+		if (lua_type(L, p) != LUA_TUSERDATA || lua_rawlen(L, p) < sizeof(GenericUserData))
+			return false;
+		auto ud = reinterpret_cast<GenericUserData*>(lua_touserdata(L, p));
+		return !(ud->flag & (UD_HADFREE | UD_WEAKUPTR | UD_SHAREDPTR | UD_SHAREDREF | UD_THREADSAFEPTR));
+	}
+
+	int LuaObject::pushStructView(lua_State* L, UStructProperty* prop, uint8* parms, int parent) {
+		UScriptStruct* uss = prop->Struct;
+		if (!LuaState::get(L)->structView || !canOwnView(L, parent) || uss->GetName() == "LuaBPVar")
+			return push(L, prop, parms, false);
+		// struct exported by lua-wrapper is always copied
+		if (LuaWrapper::pushValue(L, prop, uss, parms))
+			return 1;
+
+		parent = lua_absindex(L, parent);
+		uint32 size = uss->GetStructureSize() ? uss->GetStructureSize() : 1;
+		push(L, new LuaStruct(parms, size, uss, true));
+		auto ud = reinterpret_cast<GenericUserData*>(lua_touserdata(L, -1));
+		// LuaStruct of view is deleted by finalizeStruct, not memory it views
+		ud->flag = UD_USTRUCT | UD_VIEW;
+		// parent can't be collected before view
+		lua_pushvalue(L, parent);
+		lua_setuservalue(L, -2);
+		linkProp(L, lua_touserdata(L, parent), ud);
+		return 1;
+	}
+
 	void LuaObject::linkProp(lua_State* L, void* parent, void* prop) {
 		LuaState* ls = LuaState::get(L);
 		ls->linkProp(parent,prop);
 	}
 
+	// tag of userdata without finalizer, just let objCache know it's freed
+	static void finalizeNothing(lua_State* L, GenericUserData* ud) {
+	}
+
+	void LuaObject::cacheObj(lua_State* L, void* obj, const char* tn) {
+		if (lua_type(L, -1) != LUA_TUSERDATA)
+			return;
+		// -1 means userdata has lua __gc, it may be resurrected,
+		// so cache it in weak table
+		int tag = lua_getudtag(L, -1);
+		if (tag < 0) {
+			cacheObj(L, obj);
+			return;
+		}
+		if (tag == 0)
+			lua_setudtag(L, -1, finalizerTag(finalizeNothing));
+		lua_pushlightuserdata(L, obj);
+		lua_setuservalue(L, -2);
+		LuaState::get(L)->objCache->add(obj, typeIdOf(tn), lua_touserdata(L, -1));
+	}
+
     void LuaObject::cacheObj(lua_State* L,void* obj) {
         LuaState* ls = LuaState::get(L);
+        ls->weakCacheUsed = true;
         lua_geti(L,LUA_REGISTRYINDEX,ls->cacheObjRef);
         lua_pushlightuserdata(L,obj);
         lua_pushvalue(L,-3); // obj userdata
@@ -1231,7 +1396,7 @@ namespace NS_SLUA {
             lua_pushnil(L);
             return 1;
         }
-		return pushGCObject<UClass*>(L, cls, "UClass", setupClassMT, gcClass, true);
+		return pushGCObject<UClass*>(L, cls, "UClass", setupClassMT, finalizeObject, true);
     }
 
     int LuaObject::pushStruct(lua_State* L,UScriptStruct* cls) {
@@ -1239,7 +1404,7 @@ namespace NS_SLUA {
             lua_pushnil(L);
             return 1;
         }    
-        return pushGCObject<UScriptStruct*>(L,cls,"UScriptStruct",setupStructMT,gcStructClass,true);
+        return pushGCObject<UScriptStruct*>(L,cls,"UScriptStruct",setupStructMT,finalizeObject,true);
     }
 
 	int LuaObject::pushEnum(lua_State * L, UEnum * e)
@@ -1262,28 +1427,34 @@ namespace NS_SLUA {
 		return 1;
 	}
 
-    int LuaObject::gcObject(lua_State* L) {
-		CheckUDGC(UObject,L,1);
-        removeRef(L,UD);
-        return 0;
-    }
-
-    int LuaObject::gcClass(lua_State* L) {
-		CheckUDGC(UClass,L,1);
-        removeRef(L,UD);
-        return 0;
-    }
-
-    int LuaObject::gcStructClass(lua_State* L) {
-		CheckUDGC(UScriptStruct,L,1);
-        removeRef(L,UD);
-        return 0;
+    void LuaObject::finalizeObject(lua_State* L, GenericUserData* ud) {
+		if (ud->flag & UD_WEAKUPTR) {
+			ud->flag |= UD_HADFREE;
+			delete reinterpret_cast<WeakUObjectUD*>(ud->ud);
+			return;
+		}
+		// ud had been replaced or unlinked
+		if (ud->flag & UD_HADFREE)
+			return;
+		// cache entry of ud had been cleared by lua gc, only release ref
+		auto ls = LuaState::get(L);
+		ls->unlinkProps(ud);
+		ls->objRefs->remove(LuaObjectRefs::indexOf(reinterpret_cast<UObject*>(ud->ud)));
     }
 
-	int LuaObject::gcStruct(lua_State* L) {
-		CheckUDGC(LuaStruct, L, 1);
-		deleteFGCObject(L,UD);
-		return 0;
+	void LuaObject::finalizeStruct(lua_State* L, GenericUserData* ud) {
+		if (ud->flag & UD_VIEW) {
+			// LuaStruct is owned by view even if parent had been freed
+			if (!(ud->flag & UD_HADFREE))
+				releaseLink(L, ud);
+			deleteFGCObject(L, reinterpret_cast<LuaStruct*>(ud->ud));
+			return;
+		}
+		if (ud->flag & UD_HADFREE)
+			return;
+		// flag views of buf freed
+		releaseLink(L, ud);
+		deleteFGCObject(L, reinterpret_cast<LuaStruct*>(ud->ud));
 	}
 
     int LuaObject::push(lua_State* L, UObject* obj, bool rawpush, bool ref) {
@@ -1300,7 +1471,7 @@ namespace NS_SLUA {
 		else if (auto s = Cast<UScriptStruct>(obj))
 			return pushStruct(L, s);
 		else
-			return pushGCObject<UObject*>(L,obj,"UObject",setupInstanceMT,gcObject,ref);
+			return pushGCObject<UObject*>(L,obj,"UObject",setupInstanceMT,finalizeObject,ref);
     }
 
 	int LuaObject::push(lua_State* L, FWeakObjectPtr ptr) {
@@ -1311,7 +1482,7 @@ namespace NS_SLUA {
 		UObject* obj = ptr.Get();
 		if (getFromCache(L, obj, "UObject")) return 1;
 		int r = pushWeakType(L, new WeakUObjectUD(ptr));
-		if (r) cacheObj(L, obj);
+		if (r) cacheObj(L, obj, "UObject");
 		return r;
 	}
     
@@ -1385,7 +1556,7 @@ namespace NS_SLUA {
     }
 
     int LuaObject::push(lua_State* L,UFunction* func,UClass* cls)  {
-        lua_pushlightuserdata(L, func);
+        LuaFunctionPlan::push(L, func);
         if(cls) {
             lua_pushlightuserdata(L, cls);
             lua_pushcclosure(L, ufuncClosure, 2);
@@ -1419,7 +1590,7 @@ namespace NS_SLUA {
 	}
 
 	int LuaObject::push(lua_State* L, LuaStruct* ls) {
-		return pushType<LuaStruct*>(L, ls, "LuaStruct", setupInstanceStructMT, gcStruct);
+		return pushType<LuaStruct*>(L, ls, "LuaStruct", setupInstanceStructMT, finalizeStruct);
 	}
 
 	int LuaObject::push(lua_State* L, double v) {
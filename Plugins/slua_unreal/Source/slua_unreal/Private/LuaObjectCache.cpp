@@ -0,0 +1,124 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaObjectCache.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace NS_SLUA {
+
+	namespace {
+		const size_t MinSize = 64;
+	}
+
+	LuaObjectCache::LuaObjectCache()
+		: slots(nullptr)
+		, mask(0)
+		, count(0)
+	{
+	}
+
+	LuaObjectCache::~LuaObjectCache()
+	{
+		free(slots);
+	}
+
+	size_t LuaObjectCache::home(const void* ptr) const
+	{
+		uint64_t h = (uint64_t)(uintptr_t)ptr;
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		return (size_t)h & mask;
+	}
+
+	void* LuaObjectCache::find(const void* ptr, uint32_t type) const
+	{
+		if (!count) return nullptr;
+		for (size_t i = home(ptr);; i = (i + 1) & mask) {
+			const Slot& s = slots[i];
+			if (!s.ptr) return nullptr;
+			if (s.ptr == ptr && s.type == type) return s.ud;
+		}
+	}
+
+	void LuaObjectCache::add(const void* ptr, uint32_t type, void* ud)
+	{
+		// keep load factor under 3/4
+		if (!slots || (count + 1) * 4 > (mask + 1) * 3)
+			grow();
+		size_t i = home(ptr);
+		for (; slots[i].ptr; i = (i + 1) & mask) {
+			if (slots[i].ptr == ptr && slots[i].type == type) {
+				slots[i].ud = ud;
+				return;
+			}
+		}
+		slots[i].ptr = ptr;
+		slots[i].ud = ud;
+		slots[i].type = type;
+		count++;
+	}
+
+	bool LuaObjectCache::remove(const void* ptr, void* ud)
+	{
+		if (!count) return false;
+		for (size_t i = home(ptr);; i = (i + 1) & mask) {
+			const Slot& s = slots[i];
+			if (!s.ptr) return false;
+			if (s.ptr == ptr && s.ud == ud) {
+				erase(i);
+				return true;
+			}
+		}
+	}
+
+	void LuaObjectCache::erase(size_t i)
+	{
+		// shift following entries back, no tombstone
+		size_t j = i;
+		for (;;) {
+			j = (j + 1) & mask;
+			if (!slots[j].ptr) break;
+			size_t k = home(slots[j].ptr);
+			// entry at j can move to i if its home isn't in (i, j]
+			bool inRange = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+			if (!inRange) {
+				slots[i] = slots[j];
+				i = j;
+			}
+		}
+		slots[i].ptr = nullptr;
+		count--;
+	}
+
+	void LuaObjectCache::grow()
+	{
+		Slot* old = slots;
+		size_t oldSize = slots ? mask + 1 : 0;
+		size_t size = oldSize ? oldSize * 2 : MinSize;
+		slots = (Slot*)calloc(size, sizeof(Slot));
+		mask = size - 1;
+		count = 0;
+		for (size_t i = 0; i < oldSize; i++) {
+			if (old[i].ptr) add(old[i].ptr, old[i].type, old[i].ud);
+		}
+		free(old);
+	}
+
+	void LuaObjectCache::clear()
+	{
+		if (slots) memset(slots, 0, (mask + 1) * sizeof(Slot));
+		count = 0;
+	}
+}
@@ -0,0 +1,58 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "lua.hpp"
+
+// no engine dependency, also built by benchmark in CMakeLists.txt
+namespace NS_SLUA {
+
+	// (pointer, type id) -> memory of userdata pushed to lua, keep identity of pushed objects.
+	// open addressing with linear probing, entry is removed when userdata finalized,
+	// so lua gc needn't clear a weak table every cycle
+	class LuaObjectCache {
+	public:
+		LuaObjectCache();
+		~LuaObjectCache();
+		LuaObjectCache(const LuaObjectCache&) = delete;
+		LuaObjectCache& operator=(const LuaObjectCache&) = delete;
+
+		// userdata of ptr pushed as type, nullptr if not cached
+		void* find(const void* ptr, uint32_t type) const;
+		// cache ud for ptr and type, replace old userdata of them
+		void add(const void* ptr, uint32_t type, void* ud);
+		// remove entry of ptr if it's still ud, return false if not found
+		bool remove(const void* ptr, void* ud);
+		void clear();
+		size_t size() const { return count; }
+
+	private:
+		struct Slot {
+			const void* ptr;
+			void* ud;
+			uint32_t type;
+		};
+
+		// entries of same ptr are in one probe sequence,
+		// so remove needn't know the type
+		size_t home(const void* ptr) const;
+		void erase(size_t i);
+		void grow();
+
+		Slot* slots;
+		size_t mask;
+		size_t count;
+	};
+}
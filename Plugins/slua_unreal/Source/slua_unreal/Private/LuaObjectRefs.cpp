@@ -0,0 +1,74 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+
+#include "LuaObjectRefs.h"
+
+namespace NS_SLUA {
+
+	GenericUserData** LuaObjectRefs::find(int32 index) {
+		if (!mayContain(index))
+			return nullptr;
+		int32* slot = slots.Find(index);
+		return slot ? &entries[*slot].ud : nullptr;
+	}
+
+	void LuaObjectRefs::add(UObject* obj, int32 index, GenericUserData* ud, bool ref) {
+		check(index >= 0);
+		int32* found = mayContain(index) ? slots.Find(index) : nullptr;
+		int32 slot;
+		if (found) {
+			slot = *found;
+		}
+		else {
+			if (freeSlots.Num() > 0) {
+				slot = freeSlots.Pop(false);
+			}
+			else {
+				slot = entries.AddUninitialized();
+				referenced.AddUninitialized();
+			}
+			slots.Add(index, slot);
+			int32 word = index >> 5;
+			if (word >= filter.Num())
+				filter.AddZeroed(word + 1 - filter.Num());
+			filter[word] |= 1u << (index & 31);
+		}
+		entries[slot] = { obj, ud, index };
+		referenced[slot] = ref ? obj : nullptr;
+	}
+
+	void LuaObjectRefs::remove(int32 index) {
+		int32 slot;
+		if (!mayContain(index) || !slots.RemoveAndCopyValue(index, slot))
+			return;
+		filter[index >> 5] &= ~(1u << (index & 31));
+		entries[slot] = { nullptr, nullptr, INDEX_NONE };
+		referenced[slot] = nullptr;
+		freeSlots.Add(slot);
+	}
+
+	void LuaObjectRefs::empty() {
+		entries.Empty();
+		referenced.Empty();
+		freeSlots.Empty();
+		slots.Empty();
+		filter.Empty();
+	}
+
+	void LuaObjectRefs::addReferencedObjects(FReferenceCollector& collector) {
+		// free slots are nullptr and skipped by collector,
+		// collector may clear slot of pending kill object, entry is still removed by delete notify
+		collector.AddReferencedObjects(referenced);
+	}
+}
@@ -0,0 +1,151 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaPathHandle.h"
+#include "LuaState.h"
+
+namespace NS_SLUA {
+
+	LuaPathHandle::LuaPathHandle()
+		: depth(0)
+		, uncached(false)
+	{
+	}
+
+	LuaPathHandle::LuaPathHandle(lua_State* L, const char* p)
+		: path(UTF8_TO_TCHAR(p))
+		, depth(0)
+		, uncached(false)
+	{
+		TArray<FString> keys;
+		path.ParseIntoArray(keys, TEXT("."), true);
+		depth = keys.Num();
+
+		AutoStack as(L);
+		lua_createtable(L, depth * 2, 0);
+		for (int32 i = 0; i < depth; i++) {
+			lua_pushstring(L, TCHAR_TO_UTF8(*keys[i]));
+			lua_rawseti(L, -2, i + 1);
+		}
+		cache.set(L, -1);
+		resolve(L);
+	}
+
+	bool LuaPathHandle::checkCache(lua_State* L) const
+	{
+		if (depth == 0 || uncached || target.isNil()) return false;
+
+		AutoStack as(L);
+		cache.push(L);
+		int c = lua_gettop(L);
+		lua_pushglobaltable(L);
+		for (int32 i = 1; i <= depth; i++) {
+			if (!lua_istable(L, -1)) return false;
+			lua_rawgeti(L, c, i);
+			lua_rawget(L, -2);
+			lua_rawgeti(L, c, depth + i);
+			if (!lua_rawequal(L, -1, -2)) return false;
+			// keep value of this level as parent of next level
+			lua_pop(L, 1);
+			lua_remove(L, -2);
+		}
+		return true;
+	}
+
+	void LuaPathHandle::resolve(lua_State* L) const
+	{
+		AutoStack as(L);
+		cache.push(L);
+		int c = lua_gettop(L);
+		lua_pushglobaltable(L);
+		uncached = false;
+		int32 i = 1;
+		for (; i <= depth; i++) {
+			if (!lua_istable(L, -1)) break;
+			lua_rawgeti(L, c, i);
+			lua_pushvalue(L, -1);
+			lua_rawget(L, -3);
+			if (lua_isnil(L, -1) && lua_getmetatable(L, -3)) {
+				// same as LuaState::get, try __index
+				lua_pop(L, 2);
+				lua_gettable(L, -2);
+				uncached = true;
+			}
+			else
+				lua_remove(L, -2);
+			lua_pushvalue(L, -1);
+			lua_rawseti(L, c, depth + i);
+			lua_remove(L, -2);
+			if (lua_isnil(L, -1)) break;
+		}
+		// clear cached levels not reached
+		for (int32 j = i + 1; j <= depth; j++) {
+			lua_pushnil(L);
+			lua_rawseti(L, c, depth + j);
+		}
+		if (i > depth) target.set(L, -1);
+		else target.free();
+	}
+
+	bool LuaPathHandle::isValid() const
+	{
+		if (!cache.isValid()) return false;
+		lua_State* L = cache.getState();
+		if (uncached) {
+			resolve(L);
+			return !target.isNil();
+		}
+		return checkCache(L);
+	}
+
+	LuaVar LuaPathHandle::get() const
+	{
+		if (!cache.isValid()) return LuaVar();
+		lua_State* L = cache.getState();
+		if (!checkCache(L))
+			resolve(L);
+		return target;
+	}
+
+	bool LuaPathHandle::set(const LuaVar& v)
+	{
+		if (!cache.isValid() || depth == 0) return false;
+		lua_State* L = cache.getState();
+
+		AutoStack as(L);
+		cache.push(L);
+		int c = lua_gettop(L);
+		lua_pushglobaltable(L);
+		for (int32 i = 1; i < depth; i++) {
+			lua_rawgeti(L, c, i);
+			lua_gettable(L, -2);
+			if (lua_isnil(L, -1)) {
+				// create sub table like LuaState::set
+				lua_pop(L, 1);
+				lua_newtable(L);
+				lua_rawgeti(L, c, i);
+				lua_pushvalue(L, -2);
+				lua_rawset(L, -4);
+			}
+			else if (!lua_istable(L, -1))
+				return false;
+			lua_remove(L, -2);
+		}
+		lua_rawgeti(L, c, depth);
+		v.push(L);
+		lua_rawset(L, -3);
+		// resolved on next get
+		target.free();
+		return true;
+	}
+}
@@ -0,0 +1,237 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaPoolAlloc.h"
+#include <cstring>
+
+namespace NS_SLUA {
+
+	struct LuaPoolAlloc::Slab {
+		Slab* prev;
+		Slab* next;
+		FreeBlock* freeList;
+		// never used space at end of slab
+		char* bump;
+		uint32_t used;
+		uint32_t capacity;
+		uint32_t sizeClass;
+	};
+
+	namespace {
+		// blocks after header are aligned by Granularity(8 bytes),
+		// enough for max alignment of lua(double or pointer)
+		const size_t HeaderSize = 64;
+	}
+
+	LuaPoolAlloc::LuaPoolAlloc(const Backend& b)
+		: backend(b)
+		, empty(nullptr)
+	{
+		static_assert(sizeof(Slab) <= HeaderSize, "slab header too large");
+		memset(partial, 0, sizeof(partial));
+		memset(&st, 0, sizeof(st));
+	}
+
+	LuaPoolAlloc::~LuaPoolAlloc()
+	{
+		// lua_close had freed all blocks, release slabs left
+		for (size_t n = 0; n < ClassCount; n++) {
+			while (Slab* slab = partial[n]) {
+				partial[n] = slab->next;
+				backend.freeSlab(slab);
+			}
+		}
+		trim();
+	}
+
+	void* LuaPoolAlloc::realloc(void* ptr, size_t osize, size_t nsize)
+	{
+		if (!ptr) osize = 0;
+
+		bool oldSmall = ptr && osize <= MaxSmallSize;
+		bool wasShrunk = oldSmall && !shrunk.empty() && takeShrunk(ptr);
+		if (wasShrunk) oldSmall = false;
+
+		if (nsize == 0) {
+			if (!ptr) return nullptr;
+			st.freeCount++;
+			if (oldSmall)
+				freeSmall(ptr);
+			else {
+				st.largeBytes -= osize;
+				backend.free(ptr);
+			}
+			return nullptr;
+		}
+
+		bool newSmall = nsize <= MaxSmallSize;
+
+		// large to large, let backend grow it in place
+		if (ptr && !oldSmall && !newSmall) {
+			void* p = backend.realloc(ptr, nsize);
+			if (p) st.largeBytes += nsize - osize;
+			else if (wasShrunk) shrunk.push_back(ptr);
+			return p;
+		}
+		// same size class, nothing to do
+		if (oldSmall && newSmall && classOf(osize) == classOf(nsize))
+			return ptr;
+
+		void* p;
+		if (newSmall)
+			p = allocSmall(nsize);
+		else {
+			p = backend.realloc(nullptr, nsize);
+			if (p) st.largeBytes += nsize;
+		}
+		if (!p) {
+			// lua assumes shrink never fails, keep the large block
+			if (ptr && !oldSmall && newSmall) {
+				shrunk.push_back(ptr);
+				st.largeBytes -= osize - nsize;
+				return ptr;
+			}
+			// lua keeps old block on failure
+			if (wasShrunk) shrunk.push_back(ptr);
+			return nullptr;
+		}
+		st.allocCount++;
+
+		if (ptr) {
+			memcpy(p, ptr, osize < nsize ? osize : nsize);
+			st.freeCount++;
+			if (oldSmall)
+				freeSmall(ptr);
+			else {
+				st.largeBytes -= osize;
+				backend.free(ptr);
+			}
+		}
+		return p;
+	}
+
+	void* LuaPoolAlloc::allocSmall(size_t size)
+	{
+		size_t sc = classOf(size);
+		Slab* slab = partial[sc];
+		if (!slab) {
+			slab = newSlab(sc);
+			if (!slab) return nullptr;
+		}
+
+		void* p;
+		if (slab->freeList) {
+			p = slab->freeList;
+			slab->freeList = slab->freeList->next;
+		}
+		else {
+			p = slab->bump;
+			slab->bump += (sc + 1) * Granularity;
+		}
+		slab->used++;
+		st.smallBytes += (sc + 1) * Granularity;
+		// full slab leave partial list
+		if (slab->used == slab->capacity)
+			unlink(slab);
+		return p;
+	}
+
+	void LuaPoolAlloc::freeSmall(void* ptr)
+	{
+		// slab is aligned by SlabSize
+		Slab* slab = (Slab*)((uintptr_t)ptr & ~(uintptr_t)(SlabSize - 1));
+		size_t sc = slab->sizeClass;
+		bool wasFull = slab->used == slab->capacity;
+
+		FreeBlock* block = (FreeBlock*)ptr;
+		block->next = slab->freeList;
+		slab->freeList = block;
+		slab->used--;
+		st.smallBytes -= (sc + 1) * Granularity;
+
+		if (slab->used == 0) {
+			// move empty slab to empty list, it's released by trim
+			if (!wasFull) unlink(slab);
+			slab->prev = nullptr;
+			slab->next = empty;
+			if (empty) empty->prev = slab;
+			empty = slab;
+		}
+		else if (wasFull) {
+			slab->prev = nullptr;
+			slab->next = partial[sc];
+			if (partial[sc]) partial[sc]->prev = slab;
+			partial[sc] = slab;
+		}
+	}
+
+	LuaPoolAlloc::Slab* LuaPoolAlloc::newSlab(size_t sc)
+	{
+		size_t blockSize = (sc + 1) * Granularity;
+		Slab* slab = nullptr;
+		// reuse empty slab
+		if (empty) {
+			slab = empty;
+			empty = slab->next;
+			if (empty) empty->prev = nullptr;
+		}
+		else {
+			slab = (Slab*)backend.allocSlab(SlabSize, SlabSize);
+			if (!slab) return nullptr;
+			st.slabCount++;
+		}
+
+		slab->freeList = nullptr;
+		slab->bump = (char*)slab + HeaderSize;
+		slab->used = 0;
+		slab->capacity = (uint32_t)((SlabSize - HeaderSize) / blockSize);
+		slab->sizeClass = (uint32_t)sc;
+		slab->prev = nullptr;
+		slab->next = partial[sc];
+		if (partial[sc]) partial[sc]->prev = slab;
+		partial[sc] = slab;
+		return slab;
+	}
+
+	bool LuaPoolAlloc::takeShrunk(void* ptr)
+	{
+		for (size_t n = 0; n < shrunk.size(); n++) {
+			if (shrunk[n] == ptr) {
+				shrunk[n] = shrunk.back();
+				shrunk.pop_back();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void LuaPoolAlloc::unlink(Slab* slab)
+	{
+		if (slab->prev) slab->prev->next = slab->next;
+		else partial[slab->sizeClass] = slab->next;
+		if (slab->next) slab->next->prev = slab->prev;
+		slab->prev = slab->next = nullptr;
+	}
+
+	size_t LuaPoolAlloc::trim()
+	{
+		size_t n = 0;
+		while (Slab* slab = empty) {
+			empty = slab->next;
+			backend.freeSlab(slab);
+			st.slabCount--;
+			n++;
+		}
+		return n;
+	}
+}
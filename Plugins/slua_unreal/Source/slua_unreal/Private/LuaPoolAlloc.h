@@ -0,0 +1,87 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "lua.hpp"
+
+// no engine dependency, also built by benchmark in CMakeLists.txt
+namespace NS_SLUA {
+
+	// small object allocator for lua vm,
+	// blocks up to MaxSmallSize are allocated from slabs of size classes,
+	// larger blocks are passed to backend
+	class LuaPoolAlloc {
+	public:
+		// backend allocator, slab is allocated with SlabSize alignment
+		// large block is allocated by realloc and freed by free
+		struct Backend {
+			void* (*allocSlab)(size_t size, size_t align);
+			void (*freeSlab)(void* ptr);
+			void* (*realloc)(void* ptr, size_t size);
+			void (*free)(void* ptr);
+		};
+
+		struct Stats {
+			// bytes used by lua in small blocks and large blocks
+			size_t smallBytes;
+			size_t largeBytes;
+			// slabs allocated from backend
+			size_t slabCount;
+			size_t allocCount;
+			size_t freeCount;
+		};
+
+		static const size_t MaxSmallSize = 256;
+		static const size_t SlabSize = 16 * 1024;
+
+		LuaPoolAlloc(const Backend& backend);
+		~LuaPoolAlloc();
+
+		// same as lua_Alloc, osize is ignored if ptr is null
+		void* realloc(void* ptr, size_t osize, size_t nsize);
+		// free slabs without used block, return count of slabs freed
+		size_t trim();
+		const Stats& stats() const { return st; }
+
+	private:
+		static const size_t Granularity = 8;
+		static const size_t ClassCount = MaxSmallSize / Granularity;
+
+		struct FreeBlock {
+			FreeBlock* next;
+		};
+		struct Slab;
+
+		void* allocSmall(size_t size);
+		void freeSmall(void* ptr);
+		Slab* newSlab(size_t sizeClass);
+		void unlink(Slab* slab);
+		// remove ptr from shrunk, return true if it's there
+		bool takeShrunk(void* ptr);
+
+		static size_t classOf(size_t size) { return (size - 1) / Granularity; }
+
+		Backend backend;
+		// slabs had free block for each size class
+		Slab* partial[ClassCount];
+		// empty slabs, freed by trim
+		Slab* empty;
+		// large blocks kept by shrink if small block can't be allocated,
+		// lua sees them as small, so they are freed by backend
+		std::vector<void*> shrunk;
+		Stats st;
+	};
+}
@@ -0,0 +1,110 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaPreloader.h"
+#include "LuaChunkCache.h"
+#include "Async/Async.h"
+#include "Misc/ScopeLock.h"
+#include "SluaUtil.h"
+#include "Log.h"
+
+namespace NS_SLUA {
+
+	LuaPreloader::LuaPreloader(LuaState::LoadFileDelegate d)
+		: loadFileDelegate(d)
+	{
+	}
+
+	int32 LuaPreloader::preload(const TArray<FString>& names)
+	{
+		// collect modules and dependencies not requested
+		TArray<FString> queue = names;
+		TArray<FString> toLoad;
+		{
+			FScopeLock guard(&lock);
+			while (queue.Num() > 0) {
+				FString name = queue.Pop(false);
+				if (requested.Contains(name))
+					continue;
+				requested.Add(name);
+				toLoad.Add(name);
+				if (auto deps = manifest.Find(name))
+					queue.Append(*deps);
+			}
+		}
+
+		for (auto& name : toLoad)
+			startLoad(name);
+		return toLoad.Num();
+	}
+
+	void LuaPreloader::startLoad(const FString& name)
+	{
+		pendingCount.Increment();
+		TSharedRef<LuaPreloader, ESPMode::ThreadSafe> self = AsShared();
+		Async<void>(EAsyncExecution::ThreadPool, [self, name]() {
+			if (!self->compile(name)) {
+				// failed module can be requested again
+				FScopeLock guard(&self->lock);
+				self->requested.Remove(name);
+			}
+			self->pendingCount.Decrement();
+		});
+	}
+
+	bool LuaPreloader::compile(const FString& name)
+	{
+		if (!loadFileDelegate)
+			return false;
+
+		Module module;
+		uint8* buf = loadFileDelegate(TCHAR_TO_UTF8(*name), module.len, module.filepath);
+		if (!buf) {
+			Log::Error("Can't preload file %s", TCHAR_TO_UTF8(*name));
+			return false;
+		}
+		AutoDeleteArray<uint8> defer(buf);
+		module.hash = LuaChunkCache::hashOf(buf, module.len);
+
+		// compile in throwaway state, only bytecode is kept
+		lua_State* L = luaL_newstate();
+		char chunk[256];
+		snprintf(chunk, 256, "@%s", TCHAR_TO_UTF8(*module.filepath));
+		bool ok = luaL_loadbuffer(L, (const char*)buf, module.len, chunk) == LUA_OK
+			&& LuaChunkCache::dump(L, module.bytecode, false);
+		// compile error will be reported by loader on require
+		lua_close(L);
+		if (!ok)
+			return false;
+
+		FScopeLock guard(&lock);
+		loaded.Add(name, MoveTemp(module));
+		return true;
+	}
+
+	bool LuaPreloader::take(const FString& name, Module& module)
+	{
+		FScopeLock guard(&lock);
+		if (!loaded.RemoveAndCopyValue(name, module))
+			return false;
+		// module can be preloaded again after it's taken
+		requested.Remove(name);
+		return true;
+	}
+
+	void LuaPreloader::setManifest(const TMap<FString, TArray<FString>>& deps)
+	{
+		FScopeLock guard(&lock);
+		manifest = deps;
+	}
+}
@@ -0,0 +1,58 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "LuaState.h"
+
+namespace NS_SLUA {
+
+	// read and compile lua modules on thread pool,
+	// compiled bytecode is taken by loader when module required
+	class LuaPreloader : public TSharedFromThis<LuaPreloader, ESPMode::ThreadSafe> {
+	public:
+		struct Module {
+			FString filepath;
+			uint32 hash;
+			uint32 len;
+			TArray<uint8> bytecode;
+		};
+
+		// load delegate must be thread safe, it's called on worker thread
+		LuaPreloader(LuaState::LoadFileDelegate loadFileDelegate);
+
+		// preload module and its dependencies in manifest
+		// return count of modules start loading
+		int32 preload(const TArray<FString>& names);
+		// take compiled module, return false if module not preloaded or still loading
+		bool take(const FString& name, Module& module);
+		// count of modules still loading
+		int32 pending() const { return pendingCount.GetValue(); }
+
+		// set dependencies of modules, module name -> modules required by it
+		void setManifest(const TMap<FString, TArray<FString>>& deps);
+
+	private:
+		void startLoad(const FString& name);
+		bool compile(const FString& name);
+
+		LuaState::LoadFileDelegate loadFileDelegate;
+		TMap<FString, TArray<FString>> manifest;
+		// modules requested, including loading and loaded
+		TSet<FString> requested;
+		TMap<FString, Module> loaded;
+		FCriticalSection lock;
+		FThreadSafeCounter pendingCount;
+	};
+}
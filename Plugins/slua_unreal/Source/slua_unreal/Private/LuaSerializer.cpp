@@ -0,0 +1,392 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaSerializer.h"
+#include <cstdlib>
+#include <cstring>
+
+namespace NS_SLUA {
+
+	namespace {
+		const uint8_t FlagHasRef = 1;
+		const size_t HeaderSize = 3;
+
+		struct Reader {
+			lua_State* L;
+			const uint8_t* p;
+			const uint8_t* end;
+			// index of table id -> table, 0 if stream has no reference
+			int refs;
+			lua_Integer tableCount;
+			LuaSerializer::UnpackUserdata unpackUserdata;
+			const char* err;
+
+			bool fail(const char* e) {
+				if (!err) err = e;
+				return false;
+			}
+
+			bool readVarint(uint64_t& v) {
+				v = 0;
+				for (int shift = 0; shift < 64; shift += 7) {
+					if (p >= end) return fail("unexpected end of data");
+					uint8_t b = *p++;
+					v |= uint64_t(b & 0x7f) << shift;
+					if (!(b & 0x80)) return true;
+				}
+				return fail("bad varint");
+			}
+
+			bool readValue(int depth);
+		};
+
+		bool Reader::readValue(int depth) {
+			if (p >= end) return fail("unexpected end of data");
+			if (depth > LuaSerializer::MaxDepth) return fail("table nested too deep");
+			luaL_checkstack(L, 3, "unpack");
+
+			uint8_t tag = *p++;
+			uint64_t v;
+			switch (tag) {
+			case LuaSerializer::TAG_NIL:
+				lua_pushnil(L);
+				return true;
+			case LuaSerializer::TAG_FALSE:
+				lua_pushboolean(L, 0);
+				return true;
+			case LuaSerializer::TAG_TRUE:
+				lua_pushboolean(L, 1);
+				return true;
+			case LuaSerializer::TAG_INT:
+				if (!readVarint(v)) return false;
+				lua_pushinteger(L, (lua_Integer)((v >> 1) ^ (~(v & 1) + 1)));
+				return true;
+			case LuaSerializer::TAG_FLOAT: {
+				double d;
+				if (end - p < (ptrdiff_t)sizeof(d)) return fail("unexpected end of data");
+				memcpy(&d, p, sizeof(d));
+				p += sizeof(d);
+				lua_pushnumber(L, (lua_Number)d);
+				return true;
+			}
+			case LuaSerializer::TAG_STRING:
+				if (!readVarint(v)) return false;
+				if ((uint64_t)(end - p) < v) return fail("unexpected end of data");
+				lua_pushlstring(L, (const char*)p, (size_t)v);
+				p += v;
+				return true;
+			case LuaSerializer::TAG_TABLE: {
+				if (!readVarint(v)) return false;
+				if ((uint64_t)(end - p) < v) return fail("unexpected end of data");
+				lua_createtable(L, (int)v, 0);
+				int t = lua_gettop(L);
+				// table id is order of tables, same as packer
+				++tableCount;
+				if (refs) {
+					lua_pushvalue(L, t);
+					lua_rawseti(L, refs, tableCount);
+				}
+				for (uint64_t i = 1; i <= v; i++) {
+					if (!readValue(depth + 1)) return false;
+					lua_rawseti(L, t, (lua_Integer)i);
+				}
+				while (true) {
+					if (p >= end) return fail("unexpected end of data");
+					if (*p == LuaSerializer::TAG_NIL) {
+						p++;
+						return true;
+					}
+					if (!readValue(depth + 1) || !readValue(depth + 1)) return false;
+					if (lua_isnil(L, -1)) {
+						lua_pop(L, 2);
+						continue;
+					}
+					if (lua_type(L, -2) == LUA_TNUMBER && lua_tonumber(L, -2) != lua_tonumber(L, -2))
+						return fail("table key is nan");
+					lua_rawset(L, t);
+				}
+			}
+			case LuaSerializer::TAG_USERDATA: {
+				uint64_t nameLen, size;
+				if (!readVarint(nameLen)) return false;
+				if ((uint64_t)(end - p) < nameLen) return fail("unexpected end of data");
+				const char* name = (const char*)p;
+				p += nameLen;
+				if (!readVarint(size)) return false;
+				if ((uint64_t)(end - p) < size) return fail("unexpected end of data");
+				if (!unpackUserdata || !unpackUserdata(L, name, (size_t)nameLen, p, (size_t)size))
+					return fail("can't unpack userdata");
+				p += size;
+				return true;
+			}
+			case LuaSerializer::TAG_REF:
+				if (!readVarint(v)) return false;
+				if (!refs || v == 0 || v > (uint64_t)tableCount) return fail("bad table reference");
+				lua_rawgeti(L, refs, (lua_Integer)v);
+				return true;
+			default:
+				return fail("unknown tag");
+			}
+		}
+	}
+
+	LuaSerializer::LuaSerializer()
+		: buf(nullptr)
+		, len(0)
+		, cap(0)
+		, err(nullptr)
+		, tableKeys(nullptr)
+		, tableIds(nullptr)
+		, tableCap(0)
+		, tableCount(0)
+		, hasRef(false)
+		, userdataPacker(nullptr)
+	{
+	}
+
+	LuaSerializer::~LuaSerializer()
+	{
+		free(buf);
+		free(tableKeys);
+		free(tableIds);
+	}
+
+	void LuaSerializer::reset()
+	{
+		len = 0;
+		err = nullptr;
+		hasRef = false;
+		if (tableCount > 0) {
+			memset(tableKeys, 0, sizeof(const void*) * tableCap);
+			tableCount = 0;
+		}
+	}
+
+	void LuaSerializer::reserve(size_t n)
+	{
+		if (len + n <= cap) return;
+		size_t ncap = cap ? cap * 2 : 256;
+		while (ncap < len + n) ncap *= 2;
+		uint8_t* nbuf = (uint8_t*)realloc(buf, ncap);
+		if (!nbuf) abort();
+		buf = nbuf;
+		cap = ncap;
+	}
+
+	void LuaSerializer::writeVarint(uint64_t v)
+	{
+		reserve(10);
+		while (v >= 0x80) {
+			buf[len++] = uint8_t(v | 0x80);
+			v >>= 7;
+		}
+		buf[len++] = uint8_t(v);
+	}
+
+	void LuaSerializer::writeBytes(const void* p, size_t n)
+	{
+		reserve(n);
+		memcpy(buf + len, p, n);
+		len += n;
+	}
+
+	void LuaSerializer::writeUserdata(const char* name, const void* data, size_t size)
+	{
+		size_t nameLen = strlen(name);
+		writeByte(TAG_USERDATA);
+		writeVarint(nameLen);
+		writeBytes(name, nameLen);
+		writeVarint(size);
+		writeBytes(data, size);
+	}
+
+	bool LuaSerializer::pack(lua_State* L, int idx)
+	{
+		idx = lua_absindex(L, idx);
+		// header written by first value
+		if (len == 0) {
+			reserve(HeaderSize);
+			buf[len++] = Magic;
+			buf[len++] = Version;
+			buf[len++] = 0;
+		}
+		if (!packValue(L, idx, 0)) {
+			// table ids of partial value can't be rolled back, drop all
+			const char* e = err;
+			reset();
+			err = e;
+			return false;
+		}
+		if (hasRef) buf[2] |= FlagHasRef;
+		return true;
+	}
+
+	bool LuaSerializer::packValue(lua_State* L, int idx, int depth)
+	{
+		switch (lua_type(L, idx)) {
+		case LUA_TNIL:
+			writeByte(TAG_NIL);
+			return true;
+		case LUA_TBOOLEAN:
+			writeByte(lua_toboolean(L, idx) ? TAG_TRUE : TAG_FALSE);
+			return true;
+		case LUA_TNUMBER:
+			if (lua_isinteger(L, idx)) {
+				int64_t i = (int64_t)lua_tointeger(L, idx);
+				writeByte(TAG_INT);
+				writeVarint((uint64_t(i) << 1) ^ uint64_t(i >> 63));
+			}
+			else {
+				double d = (double)lua_tonumber(L, idx);
+				writeByte(TAG_FLOAT);
+				writeBytes(&d, sizeof(d));
+			}
+			return true;
+		case LUA_TSTRING: {
+			size_t n;
+			const char* s = lua_tolstring(L, idx, &n);
+			writeByte(TAG_STRING);
+			writeVarint(n);
+			writeBytes(s, n);
+			return true;
+		}
+		case LUA_TTABLE:
+			return packTable(L, idx, depth);
+		case LUA_TUSERDATA:
+			if (userdataPacker && userdataPacker(L, idx, *this))
+				return true;
+			err = "unsupported userdata";
+			return false;
+		default:
+			err = "unsupported value type";
+			return false;
+		}
+	}
+
+	bool LuaSerializer::packTable(lua_State* L, int idx, int depth)
+	{
+		int64_t id = findOrAddTable(lua_topointer(L, idx));
+		if (id >= 0) {
+			hasRef = true;
+			writeByte(TAG_REF);
+			writeVarint((uint64_t)id);
+			return true;
+		}
+		if (depth >= MaxDepth) {
+			err = "table nested too deep";
+			return false;
+		}
+		if (!lua_checkstack(L, 3)) {
+			err = "stack overflow";
+			return false;
+		}
+
+		lua_Integer n = (lua_Integer)lua_rawlen(L, idx);
+		writeByte(TAG_TABLE);
+		writeVarint((uint64_t)n);
+		for (lua_Integer i = 1; i <= n; i++) {
+			lua_rawgeti(L, idx, i);
+			bool ok = packValue(L, lua_gettop(L), depth + 1);
+			lua_pop(L, 1);
+			if (!ok) return false;
+		}
+
+		lua_pushnil(L);
+		while (lua_next(L, idx)) {
+			// array part had been packed
+			if (lua_isinteger(L, -2)) {
+				lua_Integer k = lua_tointeger(L, -2);
+				if (k >= 1 && k <= n) {
+					lua_pop(L, 1);
+					continue;
+				}
+			}
+			int top = lua_gettop(L);
+			if (!packValue(L, top - 1, depth + 1) || !packValue(L, top, depth + 1)) {
+				lua_pop(L, 2);
+				return false;
+			}
+			lua_pop(L, 1);
+		}
+		writeByte(TAG_NIL);
+		return true;
+	}
+
+	int64_t LuaSerializer::findOrAddTable(const void* p)
+	{
+		if ((tableCount + 1) * 2 > tableCap)
+			growTables();
+		uint32_t mask = tableCap - 1;
+		uint32_t h = uint32_t((uintptr_t(p) >> 4) * 2654435761u) & mask;
+		while (tableKeys[h]) {
+			if (tableKeys[h] == p)
+				return tableIds[h];
+			h = (h + 1) & mask;
+		}
+		tableKeys[h] = p;
+		// id start from 1, same order as unpacker
+		tableIds[h] = ++tableCount;
+		return -1;
+	}
+
+	void LuaSerializer::growTables()
+	{
+		uint32_t ncap = tableCap ? tableCap * 2 : 64;
+		const void** keys = (const void**)calloc(ncap, sizeof(const void*));
+		uint32_t* ids = (uint32_t*)malloc(ncap * sizeof(uint32_t));
+		if (!keys || !ids) abort();
+		uint32_t mask = ncap - 1;
+		for (uint32_t i = 0; i < tableCap; i++) {
+			const void* p = tableKeys[i];
+			if (!p) continue;
+			uint32_t h = uint32_t((uintptr_t(p) >> 4) * 2654435761u) & mask;
+			while (keys[h]) h = (h + 1) & mask;
+			keys[h] = p;
+			ids[h] = tableIds[i];
+		}
+		free(tableKeys);
+		free(tableIds);
+		tableKeys = keys;
+		tableIds = ids;
+		tableCap = ncap;
+	}
+
+	int LuaSerializer::unpack(lua_State* L, const uint8_t* buf, size_t len, UnpackUserdata unpackUserdata)
+	{
+		// nothing packed
+		if (len == 0) return 0;
+		if (len < HeaderSize || buf[0] != Magic || buf[1] != Version) {
+			lua_pushstring(L, "bad packed data");
+			return -1;
+		}
+
+		int base = lua_gettop(L);
+		Reader r = { L, buf + HeaderSize, buf + len, 0, 0, unpackUserdata, nullptr };
+		if (buf[2] & FlagHasRef) {
+			lua_newtable(L);
+			r.refs = lua_gettop(L);
+		}
+
+		int count = 0;
+		while (r.p < r.end) {
+			if (!r.readValue(0)) {
+				lua_settop(L, base);
+				lua_pushstring(L, r.err);
+				return -1;
+			}
+			count++;
+		}
+		if (r.refs) lua_remove(L, r.refs);
+		return count;
+	}
+}
@@ -0,0 +1,100 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include "lua.hpp"
+
+// no engine dependency, also built by benchmark in CMakeLists.txt
+namespace NS_SLUA {
+
+	// pack lua values into compact tagged binary,
+	// nil/bool/integer/number/string and table with shared or cyclic reference.
+	// buffer is reused between packs, packing don't allocate in lua
+	class LuaSerializer {
+	public:
+		enum Tag : uint8_t {
+			TAG_NIL,
+			TAG_FALSE,
+			TAG_TRUE,
+			// zigzag varint
+			TAG_INT,
+			// 8 bytes double
+			TAG_FLOAT,
+			// varint length and bytes
+			TAG_STRING,
+			// varint array size, array values, key value pairs end with nil
+			TAG_TABLE,
+			// varint id of table packed before
+			TAG_REF,
+			// type name and raw bytes of userdata, packed by PackUserdata hook
+			TAG_USERDATA,
+		};
+
+		// write userdata at idx by writeUserdata, return false if it can't be packed
+		typedef bool (*PackUserdata)(lua_State* L, int idx, LuaSerializer& s);
+		// push userdata of type name from bytes, return false if type unknown
+		typedef bool (*UnpackUserdata)(lua_State* L, const char* name, size_t nameLen, const uint8_t* data, size_t size);
+
+		static const uint8_t Magic = 'S';
+		static const uint8_t Version = 1;
+		static const int MaxDepth = 128;
+
+		LuaSerializer();
+		~LuaSerializer();
+		LuaSerializer(const LuaSerializer&) = delete;
+		LuaSerializer& operator=(const LuaSerializer&) = delete;
+
+		// clear buffer and table ids, keep memory
+		void reset();
+		// append value at idx, return false if value can't be packed, see error(),
+		// buffer is reset on failure
+		bool pack(lua_State* L, int idx);
+		const uint8_t* data() const { return buf; }
+		size_t size() const { return len; }
+		const char* error() const { return err; }
+
+		// userdata is unsupported if no packer
+		void setUserdataPacker(PackUserdata f) { userdataPacker = f; }
+		// called by PackUserdata hook
+		void writeUserdata(const char* name, const void* data, size_t size);
+
+		// push all values packed in buf, return count of values, or -1 with error message pushed
+		static int unpack(lua_State* L, const uint8_t* buf, size_t len, UnpackUserdata unpackUserdata = nullptr);
+
+	private:
+		uint8_t* buf;
+		size_t len;
+		size_t cap;
+		const char* err;
+		// table pointer -> id, open addressing
+		const void** tableKeys;
+		uint32_t* tableIds;
+		uint32_t tableCap;
+		uint32_t tableCount;
+		bool hasRef;
+		PackUserdata userdataPacker;
+
+		bool packValue(lua_State* L, int idx, int depth);
+		bool packTable(lua_State* L, int idx, int depth);
+		// return id of table, or add it and return -1 if first seen
+		int64_t findOrAddTable(const void* p);
+		void growTables();
+
+		void reserve(size_t n);
+		void writeByte(uint8_t b) { reserve(1); buf[len++] = b; }
+		void writeVarint(uint64_t v);
+		void writeBytes(const void* p, size_t n);
+	};
+}
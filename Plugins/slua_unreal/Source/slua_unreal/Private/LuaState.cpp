@@ -33,11 +33,47 @@
 #include "LatentDelegate.h"
 #include "LuaActor.h"
 #include "LuaProfiler.h"
+#include "LuaFunctionPlan.h"
+#include "LuaChunkCache.h"
+#include "LuaPreloader.h"
+#include "LuaGCScheduler.h"
+#include "LuaPoolAlloc.h"
+#include "LuaWatchdog.h"
+#include "LuaCoroutinePool.h"
+#include "LuaTimerWheel.h"
+#include "LuaJobRunner.h"
+#include "LuaWorkerPool.h"
+#include "LuaStructCodec.h"
+#include "LuaObjectCache.h"
+#include "LuaObjectRefs.h"
 #include "Stats.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CoreDelegates.h"
 
 namespace NS_SLUA {
 
-	const int MaxLuaExecTime = 5; // in second
+	// count of slow script events kept by state
+	const int MaxSlowScriptEvents = 64;
+
+	// count of path handles cached by getPathHandle, cache is emptied when exceeded
+	const int MaxPathHandles = 1024;
+
+	// latent thread id = generation << ThreadSlotBits | slot index
+	const int32 ThreadSlotBits = 20;
+	const int32 ThreadSlotMask = (1 << ThreadSlotBits) - 1;
+	const int32 ThreadGenerationMask = (1 << (31 - ThreadSlotBits)) - 1;
+
+	static TAutoConsoleVariable<int32> CVarMemorySoftLimitMB(
+		TEXT("slua.MemorySoftLimitMB"),
+		0,
+		TEXT("Lua heap of each state over this run full gc and memory warning, 0 to disable"),
+		ECVF_Default);
+
+	static TAutoConsoleVariable<int32> CVarMemoryHardLimitMB(
+		TEXT("slua.MemoryHardLimitMB"),
+		0,
+		TEXT("Lua heap of each state can't grow over this, allocation raise memory error, 0 to disable"),
+		ECVF_Default);
 
     int import(lua_State *L) {
         const char* name = LuaObject::checkValue<const char*>(L,1);
@@ -116,25 +152,29 @@ namespace NS_SLUA {
     int LuaState::loader(lua_State* L) {
         LuaState* state = LuaState::get(L);
         const char* fn = lua_tostring(L,1);
-        uint32 len;
-        FString filepath;
-        if(uint8* buf = state->loadFile(fn,len,filepath)) {
-            AutoDeleteArray<uint8> defer(buf);
-
-            char chunk[256];
-            snprintf(chunk,256,"@%s",TCHAR_TO_UTF8(*filepath));
-            if(luaL_loadbuffer(L,(const char*)buf,len,chunk)==0) {
-                return 1;
-            }
-            else {
-                const char* err = lua_tostring(L,-1);
-                Log::Error("%s",err);
-                lua_pop(L,1);
-            }
+        state->freeScriptClass(fn);
+        bool found = false;
+        if(state->loadPreloaded(fn,found))
+            return 1;
+        else if(found) {
+            const char* err = lua_tostring(L,-1);
+            Log::Error("%s",err);
+            lua_pop(L,1);
+            return 0;
         }
-        else
-            Log::Error("Can't load file %s",fn);
-        return 0;
+
+        if(state->loadModule(fn,found)) {
+            return 1;
+        }
+        else if(found) {
+            const char* err = lua_tostring(L,-1);
+            Log::Error("%s",err);
+            lua_pop(L,1);
+            return 0;
+        }
+        // not found, let other searchers try it
+        lua_pushfstring(L,"\n\tno file '%s' by slua loader",fn);
+        return 1;
     }
     
     uint8* LuaState::loadFile(const char* fn,uint32& len,FString& filepath) {
@@ -142,26 +182,143 @@ namespace NS_SLUA {
         return nullptr;
     }
 
+	const uint8* LuaState::loadFileView(const char* fn, uint32& len, FString& filepath) {
+		if (loadFileViewDelegate) return loadFileViewDelegate(fn, len, filepath);
+		return nullptr;
+	}
+
+	bool LuaState::loadModule(const char* fn, bool& found) {
+		uint32 len;
+		FString filepath;
+		// load from memory owned by delegate, e.g. mapped bundle, without copy
+		if (const uint8* view = loadFileView(fn, len, filepath)) {
+			found = true;
+			return loadChunk(view, len, filepath);
+		}
+
+		if (uint8* buf = loadFile(fn, len, filepath)) {
+			AutoDeleteArray<uint8> defer(buf);
+			found = true;
+			return loadChunk(buf, len, filepath);
+		}
+		found = false;
+		return false;
+	}
+
+	bool LuaState::loadChunk(const uint8* buf, uint32 len, const FString& filepath) {
+		char chunk[256];
+		snprintf(chunk, 256, "@%s", TCHAR_TO_UTF8(*filepath));
+		return chunkCache->load(L, buf, len, filepath, chunk);
+	}
+
+	void LuaState::setChunkCacheDir(const FString& dir, bool strip) {
+		chunkCache->setCacheDir(dir, strip);
+	}
+
+	bool LuaState::loadPreloaded(const char* fn, bool& found) {
+		found = false;
+		LuaPreloader::Module module;
+		if (!preloader.IsValid() || !preloader->take(UTF8_TO_TCHAR(fn), module))
+			return false;
+
+		found = true;
+		char chunk[256];
+		snprintf(chunk, 256, "@%s", TCHAR_TO_UTF8(*module.filepath));
+		return chunkCache->loadBytecode(L, module.bytecode, module.filepath, module.hash, module.len, chunk);
+	}
+
+	LuaPreloader* LuaState::getPreloader() {
+		if (!preloader.IsValid())
+			preloader = MakeShareable(new LuaPreloader(loadFileDelegate));
+		return preloader.Get();
+	}
+
+	int32 LuaState::preloadModules(const TArray<FString>& modules) {
+		return getPreloader()->preload(modules);
+	}
+
+	int32 LuaState::pendingPreloads() const {
+		return preloader.IsValid() ? preloader->pending() : 0;
+	}
+
+	void LuaState::setModuleManifest(const TMap<FString, TArray<FString>>& deps) {
+		getPreloader()->setManifest(deps);
+	}
+
+	bool LuaState::loadModuleManifest(const char* fn) {
+		LuaVar t = doFile(fn);
+		if (!t.isTable()) {
+			Log::Error("Module manifest %s should return a table", fn);
+			return false;
+		}
+
+		TMap<FString, TArray<FString>> deps;
+		LuaVar key, value;
+		while (t.next(key, value)) {
+			if (!key.isString() || !value.isTable())
+				continue;
+			auto& list = deps.Add(UTF8_TO_TCHAR(key.asString()));
+			for (size_t n = 1; n <= value.count(); n++) {
+				LuaVar dep = value.getAt(n);
+				if (dep.isString())
+					list.Add(UTF8_TO_TCHAR(dep.asString()));
+			}
+		}
+		setModuleManifest(deps);
+		return true;
+	}
+
     LuaState* LuaState::mainState = nullptr;
     TMap<int,LuaState*> stateMapFromIndex;
     static int StateIndex = 0;
 
 	LuaState::LuaState(const char* name, UGameInstance* gameInstance)
 		: loadFileDelegate(nullptr)
+		, loadFileViewDelegate(nullptr)
 		, errorDelegate(nullptr)
 		, L(nullptr)
+		, objCache(new LuaObjectCache())
 		, cacheObjRef(LUA_NOREF)
+		, weakCacheUsed(false)
 		, stackCount(0)
 		, si(0)
-		, deadLoopCheck(nullptr)
+		, scriptWatch(nullptr)
+		, currentEntry(SE_CALL)
+		, objRefs(new LuaObjectRefs())
+		, chunkCache(new LuaChunkCache())
+		, gcScheduler(new LuaGCScheduler())
+		, jobRunner(new LuaJobRunner())
+		, serializer(new LuaSerializer())
+		, usePoolAlloc(false)
+		, poolAlloc(nullptr)
+		, memUsed(0)
+		, memSoftLimit(0)
+		, memHardLimit(0)
+		, memSoftTrigger(0)
+		, memSoftHit(false)
+		, memTrimPending(false)
+		, threadTableRef(LUA_NOREF)
+		, timeWheel(new LuaTimerWheel())
+		, frameWheel(new LuaTimerWheel())
+		, waitClock(0)
+		, structView(false)
     {
         if(name) stateName=UTF8_TO_TCHAR(name);
 		this->pGI = gameInstance;
+		serializer->setUserdataPacker(LuaStructCodec::pack);
     }
 
     LuaState::~LuaState()
     {
         close();
+		SafeDelete(chunkCache);
+		SafeDelete(gcScheduler);
+		SafeDelete(jobRunner);
+		SafeDelete(serializer);
+		SafeDelete(objCache);
+		SafeDelete(objRefs);
+		SafeDelete(timeWheel);
+		SafeDelete(frameWheel);
     }
 
     LuaState* LuaState::get(int index) {
@@ -193,6 +350,12 @@ namespace NS_SLUA {
 		ensure(IsInGameThread());
 		if (!L) return;
 
+		LuaStateLock lock(L);
+
+		// native finalizers touch engine objects, so userdata collected by
+		// background gc are finalized here on game thread
+		if (enableMultiThreadGC) finalizeUserdata();
+
 		int top = lua_gettop(L);
 		if (top != stackCount) {
 			stackCount = top;
@@ -204,45 +367,274 @@ namespace NS_SLUA {
 #endif
 
 		PROFILER_WATCHER(w1);
+		{
+			PROFILER_WATCHER_X(w4, "Wait");
+			tickWaits(dtime);
+		}
+
+		{
+			PROFILER_WATCHER_X(w6, "Workers");
+			tickWorkers();
+		}
+
 		if (stateTickFunc.isFunction())
 		{
 			PROFILER_WATCHER_X(w2,"TickFunc");
+			LuaScriptEntryScope entry(L, SE_TICK);
 			stateTickFunc.call(dtime);
 		}
 
-		// try lua gc
+		{
+			PROFILER_WATCHER_X(w5, "Jobs");
+			jobRunner->tick(L);
+		}
+
+		checkMemory();
+
+		// try lua gc, on game thread if background step of last frame was skipped
 		PROFILER_WATCHER_X(w3, "LuaGC");
-		if (!enableMultiThreadGC) lua_gc(L, LUA_GCSTEP, 128);
+		if (enableMultiThreadGC && !gcSkipped) startBackgroundGC();
+		else {
+			gcSkipped = false;
+			if (gcScheduler->tick(L)) onGCCycleFinished();
+			finalizeUserdata();
+		}
     }
 
+	void LuaState::startBackgroundGC() {
+		// last gc task not finished
+		if (gcTask.IsValid() && !gcTask->IsComplete())
+			return;
+
+		// Tick holds stateLock, so step starts after game thread left lua,
+		// and game thread waits for it in apiSync when calling lua api again
+		gcPending = true;
+		lua_setapisync(L, apiSync);
+		gcTask = FFunctionGraphTask::CreateAndDispatchWhenReady([this]() {
+			FScopeLock lock(&stateLock);
+			// game thread had called into lua before task started
+			if (!L || !enableMultiThreadGC || !gcPending) return;
+			// __gc may touch engine objects, leave them to finalizeUserdata on game thread
+			lua_deferfinalizers(L, 1);
+			if (gcScheduler->tick(L))
+				onGCCycleFinished();
+			lua_deferfinalizers(L, 0);
+			gcPending = false;
+		}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+	}
+
+	void LuaState::apiSync(lua_State* L) {
+		// gc task calls lua api too, only game thread waits for it
+		if (!IsInGameThread()) return;
+		auto ls = LuaState::get(L);
+		FScopeLock lock(&ls->stateLock);
+		// task didn't start, skip its step and gc at end of next Tick
+		if (ls->gcPending) {
+			ls->gcPending = false;
+			ls->gcSkipped = true;
+		}
+		lua_setapisync(L, nullptr);
+	}
+
+	static int callFinalizers(lua_State* L) {
+		lua_callfinalizers(L);
+		return 0;
+	}
+
+	void LuaState::finalizeUserdata() {
+		QUICK_SCOPE_CYCLE_COUNTER(Lua_FinalizeUserdata);
+		lua_finalizeud(L);
+		// __gc of objects collected by background gc, error of one doesn't stop others
+		lua_pushcfunction(L, callFinalizers);
+		while (lua_pcall(L, 0, 0, 0)) {
+			onError(lua_tostring(L, -1));
+			lua_pop(L, 1);
+			lua_pushcfunction(L, callFinalizers);
+		}
+	}
+
+	void LuaState::waitBackgroundGC() {
+		if (gcTask.IsValid()) {
+			FTaskGraphInterface::Get().WaitUntilTaskCompletes(gcTask);
+			gcTask = nullptr;
+		}
+	}
+
+	void LuaState::setGCBudget(int32 us) {
+		gcScheduler->setBudget(us);
+	}
+
+	void LuaState::setGCPacing(int32 percent) {
+		gcScheduler->setPacing(percent);
+	}
+
+	void LuaState::setGCIdle(bool idle) {
+		gcScheduler->setIdle(idle);
+	}
+
+	void LuaState::fullGC() {
+		if (!L) return;
+		gcScheduler->fullGC(L);
+		finalizeUserdata();
+		onGCCycleFinished();
+	}
+
+	void LuaState::setJobBudget(int32 us) {
+		jobRunner->setBudget(us);
+	}
+
+	void LuaState::dumpJobs() const {
+		auto& jobs = jobRunner->getJobs();
+		Log::Log("Lua jobs %d", jobs.Num());
+		for (auto& job : jobs) {
+			Log::Log("Job %d(%s) priority %d used %.2f ms in %d slices and %d frames", job.id, job.name.c_str(),
+				job.priority, FPlatformTime::ToMilliseconds64(job.cycles), job.slices, job.frames);
+		}
+	}
+
+	void LuaState::setMemoryLimit(int64 soft, int64 hard) {
+		if (soft < 0) soft = (int64)CVarMemorySoftLimitMB.GetValueOnAnyThread() * 1024 * 1024;
+		if (hard < 0) hard = (int64)CVarMemoryHardLimitMB.GetValueOnAnyThread() * 1024 * 1024;
+		memSoftLimit = (size_t)soft;
+		memHardLimit = (size_t)hard;
+		memSoftTrigger = memSoftLimit;
+		memSoftHit = memSoftLimit > 0 && memUsed > memSoftLimit;
+	}
+
+	void LuaState::trimMemory() {
+		if (!L) return;
+		chunkCache->clear();
+		pathHandles.Empty();
+		fullGC();
+	}
+
+	void LuaState::onMemoryTrim() {
+		// may be called out of game thread, trim on next tick
+		memTrimPending = true;
+	}
+
+	void LuaState::checkMemory() {
+		if (memTrimPending.exchange(false)) {
+			Log::Log("Engine memory trim, lua heap %d KB", (int)(memUsed / 1024));
+			trimMemory();
+		}
+
+		if (!memSoftHit) {
+			// heap back under soft limit, warn again next time it's exceeded
+			if (memSoftTrigger > memSoftLimit && memUsed < memSoftLimit)
+				memSoftTrigger = memSoftLimit;
+			return;
+		}
+		memSoftHit = false;
+
+		size_t before = memUsed;
+		fullGC();
+		Log::Log("Lua heap %d KB exceed soft limit %d KB, %d KB after full gc",
+			(int)(before / 1024), (int)(memSoftLimit / 1024), (int)(memUsed / 1024));
+		memSoftTrigger = memUsed > memSoftLimit ? memUsed + memSoftLimit / 8 : memSoftLimit;
+
+		onMemoryWarning.Broadcast(memUsed, memSoftLimit);
+		if (memoryWarningFunc.isFunction()) {
+			LuaScriptEntryScope entry(L, SE_EVENT);
+			memoryWarningFunc.call((int64)memUsed, (int64)memSoftLimit);
+		}
+	}
+
+	void LuaState::onGCCycleFinished() {
+		if (poolAlloc) poolAlloc->trim();
+	}
+
+	void LuaState::setScriptBudget(ScriptEntry entry, int32 ms) {
+		if (scriptWatch && entry >= 0 && entry < SE_NUM)
+			scriptWatch->budgetMs[entry].store(ms);
+	}
+
+	void LuaState::setScriptTimeout(int32 ms) {
+		if (scriptWatch) scriptWatch->abortMs.store(ms);
+	}
+
+	void LuaState::onScriptSlow(ScriptEntry entry, double ms, const FString& traceback) {
+		static const char* entryNames[] = { "call", "tick", "event", "delegate" };
+		Log::Log("Slow lua script from %s cost %.2f ms\n%s", entryNames[entry], ms, TCHAR_TO_UTF8(*traceback));
+
+		if (slowScripts.Num() >= MaxSlowScriptEvents)
+			slowScripts.RemoveAt(0, 1, false);
+		SlowScriptEvent e = { entry, ms, traceback };
+		slowScripts.Add(e);
+		onSlowScript.Broadcast(e);
+	}
+
+	void LuaState::dumpPoolAlloc() const {
+		if (!poolAlloc) {
+			Log::Log("Pool allocator isn't used");
+			return;
+		}
+		auto& st = poolAlloc->stats();
+		Log::Log("Pool allocator small %d KB, large %d KB, slabs %d(%d KB), alloc %llu, free %llu",
+			(int)(st.smallBytes / 1024), (int)(st.largeBytes / 1024),
+			(int)st.slabCount, (int)(st.slabCount * LuaPoolAlloc::SlabSize / 1024),
+			(unsigned long long)st.allocCount, (unsigned long long)st.freeCount);
+	}
+
     void LuaState::close() {
         if(mainState==this) mainState = nullptr;
 
 		latentDelegate = nullptr;
 
+		waitBackgroundGC();
+
 		freeDeferObject();
 
+		freeScriptClasses();
+		chunkCache->clear();
+		preloader.Reset();
+		if (workerPool.IsValid()) {
+			// workers are closed by running jobs if any
+			workerPool->stop();
+			workerPool.Reset();
+		}
+		workerWaits.Empty();
+		pathHandles.Empty();
+		memoryWarningFunc.free();
+
 		releaseAllLink();
 
 		cleanupThreads();
+		jobRunner->clear(L);
         
         if(L) {
             lua_close(L);
 			GUObjectArray.RemoveUObjectDeleteListener(this);
 			FCoreUObjectDelegates::GetPostGarbageCollect().Remove(pgcHandler);
 			FWorldDelegates::OnWorldCleanup.Remove(wcHandler);
+			FCoreDelegates::GetMemoryTrimDelegate().Remove(mtHandler);
             stateMapFromIndex.Remove(si);
             L=nullptr;
         }
+		// all blocks had been freed by lua_close
+		SafeDelete(poolAlloc);
+		memUsed = 0;
+		memSoftHit = false;
+		memTrimPending = false;
 		freeDeferObject();
-		objRefs.Empty();
-		SafeDelete(deadLoopCheck);
+		objRefs->empty();
+		// userdata had been finalized by lua_close
+		objCache->clear();
+		weakCacheUsed = false;
+		typeMetatableRefs.Empty();
+		pendingFlatTypes.Empty();
+		classMap.clear();
+		if (scriptWatch) {
+			LuaWatchdog::remove(scriptWatch);
+			SafeDelete(scriptWatch);
+		}
+		slowScripts.Empty();
     }
 
 
     bool LuaState::init(bool gcFlag) {
 
-        if(deadLoopCheck)
+        if(scriptWatch)
             return false;
 
         if(!mainState) 
@@ -251,6 +643,7 @@ namespace NS_SLUA {
 		enableMultiThreadGC = gcFlag;
 		pgcHandler = FCoreUObjectDelegates::GetPostGarbageCollect().AddRaw(this, &LuaState::onEngineGC);
 		wcHandler = FWorldDelegates::OnWorldCleanup.AddRaw(this, &LuaState::onWorldCleanup);
+		mtHandler = FCoreDelegates::GetMemoryTrimDelegate().AddRaw(this, &LuaState::onMemoryTrim);
 		GUObjectArray.AddUObjectDeleteListener(this);
 
 		latentDelegate = NewObject<ULatentDelegate>((UObject*)GetTransientPackage(), ULatentDelegate::StaticClass());
@@ -261,22 +654,37 @@ namespace NS_SLUA {
 
 		propLinks.Empty();
 		classMap.clear();
-		objRefs.Empty();
+		objRefs->empty();
 
 #if WITH_EDITOR
 		// used for debug
 		debugStringMap.Empty();
 #endif
 
-		deadLoopCheck = new FDeadLoopCheck();
+		scriptWatch = new ScriptWatch(nullptr);
 
+        if(usePoolAlloc) {
+            LuaPoolAlloc::Backend backend = {
+                [](size_t size, size_t align) { return FMemory::Malloc(size, align); },
+                [](void* ptr) { FMemory::Free(ptr); },
+                [](void* ptr, size_t size) { return FMemory::Realloc(ptr, size); },
+                [](void* ptr) { FMemory::Free(ptr); },
+            };
+            poolAlloc = new LuaPoolAlloc(backend);
+        }
         // use custom memory alloc func to profile memory footprint
         L = lua_newstate(LuaMemoryProfile::alloc,this);
         lua_atpanic(L,_atPanic);
+        // binding userdata collected by gc are finalized in batch by finalizeUserdata
+        lua_setudfinalizer(L,LuaObject::finalizeUD);
         // bind this to L
         *((void**)lua_getextraspace(L)) = this;
         stateMapFromIndex.Add(si,this);
 
+		// watch script calls of this state
+		scriptWatch->L = L;
+		LuaWatchdog::add(scriptWatch);
+
         // init obj cache table
         lua_newtable(L);
         lua_newtable(L);
@@ -286,6 +694,10 @@ namespace NS_SLUA {
         // register it
         cacheObjRef = luaL_ref(L,LUA_REGISTRYINDEX);
 
+        // coroutines waiting latent action
+        lua_newtable(L);
+        threadTableRef = luaL_ref(L,LUA_REGISTRYINDEX);
+
         ensure(lua_gettop(L)==0);
         
         luaL_openlibs(L);
@@ -322,6 +734,7 @@ namespace NS_SLUA {
 		lua_settop(L, 0);
         
 		LuaSocket::init(L);
+        LuaCoroutinePool::init(L);
         LuaObject::init(L);
         SluaUtil::openLib(L);
         LuaClass::reg(L);
@@ -336,6 +749,9 @@ namespace NS_SLUA {
 		// disable gc in main thread
 		if (enableMultiThreadGC) lua_gc(L, LUA_GCSTOP, 0);
 
+		// limits from cvar, libs opened above are counted
+		setMemoryLimit(-1, -1);
+
         lua_settop(L,0);
 
         return true;
@@ -353,6 +769,12 @@ namespace NS_SLUA {
 
 	void LuaState::setLoadFileDelegate(LoadFileDelegate func) {
 		loadFileDelegate = func;
+		// preloader hold old delegate
+		preloader.Reset();
+	}
+
+	void LuaState::setLoadFileViewDelegate(LoadFileViewDelegate func) {
+		loadFileViewDelegate = func;
 	}
 
 	void LuaState::setErrorDelegate(ErrorDelegate func) {
@@ -362,7 +784,8 @@ namespace NS_SLUA {
 	static void* findParent(GenericUserData* parent) {
 		auto pp = parent;
 		while(true) {
-			if (!pp->parent)
+			// view may be unlinked by container it views, stop at it
+			if (!pp->parent || (pp->flag & UD_VIEW))
 				break;
 			pp = reinterpret_cast<GenericUserData*>(pp->parent);
 		}
@@ -370,8 +793,9 @@ namespace NS_SLUA {
 	}
 
 	void LuaState::linkProp(void* parent, void* prop) {
-		auto parentud = findParent(reinterpret_cast<GenericUserData*>(parent));
 		auto propud = reinterpret_cast<GenericUserData*>(prop);
+		// view is unlinked with its direct parent, e.g. array element view by array changed
+		auto parentud = (propud->flag & UD_VIEW) ? parent : findParent(reinterpret_cast<GenericUserData*>(parent));
 		propud->parent = parentud;
 		auto& propList = propLinks.FindOrAdd(parentud);
 		propList.Add(propud);
@@ -380,15 +804,33 @@ namespace NS_SLUA {
 	void LuaState::releaseLink(void* prop) {
 		auto propud = reinterpret_cast<GenericUserData*>(prop);
 		if (propud->flag & UD_AUTOGC) {
-			auto propListPtr = propLinks.Find(propud);
-			if (propListPtr) 
-				for (auto& cprop : *propListPtr) 
-					reinterpret_cast<GenericUserData*>(cprop)->flag |= UD_HADFREE;
+			unlinkProps(propud);
 		} else {
 			propud->flag |= UD_HADFREE;
 			auto propListPtr = propLinks.Find(propud->parent);
 			if (propListPtr) 
 				propListPtr->Remove(propud);
+			// memory of props linked to prop is still owned by parent of prop
+			TArray<void*> propList;
+			if (propud->parent && propLinks.RemoveAndCopyValue(propud, propList)) {
+				for (auto& child : propList)
+					reinterpret_cast<GenericUserData*>(child)->parent = propud->parent;
+				propLinks.FindOrAdd(propud->parent).Append(propList);
+			}
+		}
+	}
+
+	void LuaState::unlinkProps(void* parent) {
+		TArray<void*> propList;
+		// address of parent may be reused, drop its list
+		if (propLinks.Num() == 0 || !propLinks.RemoveAndCopyValue(parent, propList))
+			return;
+		// props linked to prop are in same memory, unlink them too
+		for (int32 i = 0; i < propList.Num(); i++) {
+			reinterpret_cast<GenericUserData*>(propList[i])->flag |= UD_HADFREE;
+			TArray<void*> children;
+			if (propLinks.RemoveAndCopyValue(propList[i], children))
+				propList.Append(children);
 		}
 	}
 
@@ -404,14 +846,35 @@ namespace NS_SLUA {
 	{
 		PROFILER_WATCHER(w1);
 		// find freed uclass
-		for (ClassCache::CacheFuncMap::TIterator it(classMap.cacheFuncMap); it; ++it)
-			if (!it.Key().IsValid())
-				it.RemoveCurrent();
-		
 		for (ClassCache::CachePropMap::TIterator it(classMap.cachePropMap); it; ++it)
 			if (!it.Key().IsValid())
 				it.RemoveCurrent();		
+
+		for (ClassCache::CachePlanMap::TIterator it(classMap.cachePlanMap); it; ++it) {
+			if (!it.Key().IsValid()) {
+				// closures may still hold plan, they see func is freed
+				it.Value()->func = nullptr;
+				LuaFunctionPlan::release(it.Value());
+				it.RemoveCurrent();
+			}
+		}
+
+		for (ClassCache::CacheMemberMap* map : { &classMap.cacheMemberMap, &classMap.cacheStaticMemberMap }) {
+			for (ClassCache::CacheMemberMap::TIterator it(*map); it; ++it) {
+				if (!it.Key().IsValid()) {
+					luaL_unref(L, LUA_REGISTRYINDEX, it.Value());
+					it.RemoveCurrent();
+				}
+			}
+		}
 		
+		// remove overrides of freed blueprint class
+		for (auto& pair : scriptClasses) {
+			for (auto it = pair.Value->overrides.CreateIterator(); it; ++it)
+				if (!it.Key().IsValid())
+					it.RemoveCurrent();
+		}
+
 		freeDeferObject();
 
 		Log::Log("Unreal engine GC, lua used %d KB",lua_gc(L, LUA_GCCOUNT, 0));
@@ -423,6 +886,20 @@ namespace NS_SLUA {
 		unlinkUObject(World);
 	}
 
+	void LuaState::freeScriptClasses()
+	{
+		for (auto& pair : scriptClasses)
+			delete pair.Value;
+		scriptClasses.Empty();
+	}
+
+	void LuaState::freeScriptClass(const char* fn)
+	{
+		LuaScriptClass* scriptClass;
+		if (fn && scriptClasses.Num() > 0 && scriptClasses.RemoveAndCopyValue(UTF8_TO_TCHAR(fn), scriptClass))
+			delete scriptClass;
+	}
+
 	void LuaState::freeDeferObject()
 	{
 		// really delete FGCObject
@@ -462,15 +939,16 @@ namespace NS_SLUA {
     }
 
     LuaVar LuaState::doFile(const char* fn, LuaVar* pEnv) {
-        uint32 len;
-        FString filepath;
-        if(uint8* buf=loadFile(fn,len,filepath)) {
-            char chunk[256];
-            snprintf(chunk,256,"@%s",TCHAR_TO_UTF8(*filepath));
-
-            LuaVar r = doBuffer( buf,len,chunk,pEnv );
-            delete[] buf;
-            return r;
+        AutoStack g(L);
+        freeScriptClass(fn);
+        bool found = false;
+        if(loadModule(fn,found)) {
+            LuaVar f(L,-1);
+            return f.call();
+        }
+        else if(found) {
+            const char* err = lua_tostring(L,-1);
+            Log::Error("DoFile failed: %s",err);
         }
         return LuaVar();
     }
@@ -478,13 +956,18 @@ namespace NS_SLUA {
 	void LuaState::NotifyUObjectDeleted(const UObjectBase * Object, int32 Index)
 	{
 		PROFILER_WATCHER(w1);
-		unlinkUObject((const UObject*)Object);
+		if (!L) return;
+		LuaStateLock lock(L);
+		// most deleted objects were never pushed to lua, reject them by bit of index
+		if (!objRefs->mayContain(Index)) return;
+		unlinkUObject((const UObject*)Object, Index);
 	}
 
-	void LuaState::unlinkUObject(const UObject * Object)
+	void LuaState::unlinkUObject(const UObject * Object, int32 Index)
 	{
+		if (Index == INDEX_NONE) Index = LuaObjectRefs::indexOf(Object);
 		// find Object from objRefs, maybe nothing
-		auto udptr = objRefs.Find(Object);
+		auto udptr = objRefs->find(Index);
 		// maybe Object not push to lua
 		if (!udptr) {
 			return;
@@ -494,12 +977,10 @@ namespace NS_SLUA {
 
 		// remove should put here avoid ud is invalid
 		// remove ref, Object must be an UObject in slua
-		objRefs.Remove(const_cast<UObject*>(Object));
+		objRefs->remove(Index);
 
 		// maybe ud is nullptr or had been freed
 		if (!ud) {
-			// remove should put here avoid ud is invalid
-			objRefs.Remove(const_cast<UObject*>(Object));
 			return;
 		}
 		else if (ud->flag & UD_HADFREE)
@@ -507,28 +988,18 @@ namespace NS_SLUA {
 
 		// indicate ud had be free
 		ud->flag |= UD_HADFREE;
+		unlinkProps(ud);
 		// remove cache
 		ensure(ud->ud == Object);
-		LuaObject::removeFromCache(L, ud->ud);
+		objCache->remove(ud->ud, ud);
+		if (weakCacheUsed) LuaObject::removeFromCache(L, ud->ud);
 	}
 
 	void LuaState::AddReferencedObjects(FReferenceCollector & Collector)
 	{
-		for (UObjectRefMap::TIterator it(objRefs); it; ++it)
-		{
-			UObject* item = it.Key();
-			GenericUserData* userData = it.Value();
-			if (userData && !(userData->flag & UD_REFERENCE))
-			{
-				continue;
-			}
-			Collector.AddReferencedObject(item);
-		}
-		// do more gc step in collecting thread
-		// lua_gc can be call async in bg thread in some isolate position
-		// but this position equivalent to main thread
-		// we just try and find some proper async position
-		if (enableMultiThreadGC && L) lua_gc(L, LUA_GCSTEP, 128);
+		// objRefs may be changed by gc on background thread
+		FScopeLock lock(&stateLock);
+		objRefs->addReferencedObjects(Collector);
 	}
 #if (ENGINE_MINOR_VERSION>=23) && (ENGINE_MAJOR_VERSION>=4)
 	void LuaState::OnUObjectArrayShutdown() {
@@ -547,6 +1018,12 @@ namespace NS_SLUA {
 		RETURN_QUICK_DECLARE_CYCLE_STAT(LuaState, STATGROUP_Game);
 	}
 
+	int32 LuaState::makeThreadId(int32 index) const
+	{
+		// low bits is slot index, high bits is generation
+		return ((threadSlots[index].generation & ThreadGenerationMask) << ThreadSlotBits) | index;
+	}
+
 	int LuaState::addThread(lua_State *thread)
 	{
 		int isMainThread = lua_pushthread(thread);
@@ -558,36 +1035,51 @@ namespace NS_SLUA {
 			return LUA_REFNIL;
 		}
 
-		lua_xmove(thread, L, 1);
-		lua_pop(thread, 1);
+		int32 index;
+		if (freeThreadSlots.Num() > 0)
+			index = freeThreadSlots.Pop(false);
+		else {
+			if (threadSlots.Num() > ThreadSlotMask) {
+				lua_pop(thread, 1);
+				luaL_error(thread, "Too many coroutines waiting latent action!");
+				return LUA_REFNIL;
+			}
+			index = threadSlots.Add({ nullptr, 1, WK_NONE, INDEX_NONE });
+		}
+		threadSlots[index].thread = thread;
+		int32 threadId = makeThreadId(index);
 
+		lua_rawgeti(L, LUA_REGISTRYINDEX, threadTableRef);
+		lua_xmove(thread, L, 1);
 		ensure(lua_isthread(L, -1));
+		lua_pushinteger(L, threadId);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
 
-		int threadRef = luaL_ref(L, LUA_REGISTRYINDEX);
-		threadToRef.Add(thread, threadRef);
-		refToThread.Add(threadRef, thread);
-
-		return threadRef;
+		return threadId;
 	}
 
-	void LuaState::resumeThread(int threadRef)
+	void LuaState::resumeThread(int threadRef, int nargs)
 	{
 		QUICK_SCOPE_CYCLE_COUNTER(Lua_LatentCallback);
 
-		lua_State **threadPtr = refToThread.Find(threadRef);
-		if (threadPtr)
+		LuaStateLock lock(L);
+		int32 index = threadRef & ThreadSlotMask;
+		if (isThreadId(threadRef))
 		{
-			lua_State *thread = *threadPtr;
+			// resumed by latent action, stop waiting timer
+			cancelWait(threadSlots[index]);
+			lua_State *thread = threadSlots[index].thread;
 			bool threadIsDead = false;
 
-			if (lua_status(thread) == LUA_OK && lua_gettop(thread) == 0)
+			if (lua_status(thread) == LUA_OK && lua_gettop(thread) == nargs)
 			{
 				Log::Error("cannot resume dead coroutine");
 				threadIsDead = true;
 			}
 			else
 			{
-				int status = lua_resume(thread, L, 0);
+				int status = lua_resume(thread, L, nargs);
 				if (status == LUA_OK || status == LUA_YIELD)
 				{
 					int nres = lua_gettop(thread);
@@ -622,32 +1114,268 @@ namespace NS_SLUA {
 
 			if (threadIsDead)
 			{
-				threadToRef.Remove(thread);
-				refToThread.Remove(threadRef);
-				luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+				freeThreadSlot(index);
 			}
 		}
 	}
 
 	int LuaState::findThread(lua_State *thread)
 	{
-		int32 *threadRefPtr = threadToRef.Find(thread);
-		return threadRefPtr ? *threadRefPtr : LUA_REFNIL;
+		if (threadSlots.Num() == 0)
+			return LUA_REFNIL;
+
+		lua_rawgeti(L, LUA_REGISTRYINDEX, threadTableRef);
+		lua_pushthread(thread);
+		lua_xmove(thread, L, 1);
+		int threadId = lua_rawget(L, -2) == LUA_TNUMBER ? (int)lua_tointeger(L, -1) : LUA_REFNIL;
+		lua_pop(L, 2);
+		return threadId;
+	}
+
+	void LuaState::releaseThread(lua_State *thread)
+	{
+		int threadId = findThread(thread);
+		if (threadId != LUA_REFNIL)
+			freeThreadSlot(threadId & ThreadSlotMask);
+	}
+
+	void LuaState::freeThreadSlot(int32 index)
+	{
+		ThreadSlot& slot = threadSlots[index];
+		if (!slot.thread) return;
+		cancelWait(slot);
+
+		lua_rawgeti(L, LUA_REGISTRYINDEX, threadTableRef);
+		lua_pushthread(slot.thread);
+		lua_xmove(slot.thread, L, 1);
+		lua_pushnil(L);
+		lua_rawset(L, -3);
+		lua_pop(L, 1);
+
+		slot.thread = nullptr;
+		slot.generation++;
+		freeThreadSlots.Push(index);
 	}
 
 	void LuaState::cleanupThreads()
 	{
-		for (TMap<lua_State*, int32>::TIterator It(threadToRef); It; ++It)
-		{
-			lua_State *thread = It.Key();
-			int32 threadRef = It.Value();
-			if (threadRef != LUA_REFNIL)
-			{
-				luaL_unref(L, LUA_REGISTRYINDEX, threadRef);
+		// predicates of waitUntil are freed with registry by lua_close
+		TArray<LuaTimerWheel::Expired> timers;
+		timeWheel->clear(timers);
+		frameWheel->clear(timers);
+		waitClock = 0;
+
+		if (L && threadTableRef != LUA_NOREF)
+			luaL_unref(L, LUA_REGISTRYINDEX, threadTableRef);
+		threadTableRef = LUA_NOREF;
+		threadSlots.Empty();
+		freeThreadSlots.Empty();
+	}
+
+	bool LuaState::isThreadId(int32 threadId) const
+	{
+		int32 index = threadId & ThreadSlotMask;
+		return threadId > 0 && index < threadSlots.Num() && makeThreadId(index) == threadId;
+	}
+
+	void LuaState::checkWait(lua_State *thread)
+	{
+		if (!lua_isyieldable(thread))
+			luaL_error(thread, "Can't wait outside a coroutine or across a C call boundary!");
+		// job is resumed by runner only, waiting would resume it twice
+		if (jobRunner->isRunning(thread))
+			luaL_error(thread, "Can't wait in a job, use coroutine.yield or slua.jobYield!");
+	}
+
+	int LuaState::prepareWait(lua_State *thread)
+	{
+		checkWait(thread);
+
+		int threadId = findThread(thread);
+		if (threadId == LUA_REFNIL)
+			threadId = addThread(thread);
+		// waiting again after resumed by others, drop old timer
+		cancelWait(threadSlots[threadId & ThreadSlotMask]);
+		return threadId;
+	}
+
+	void LuaState::cancelWait(ThreadSlot& slot)
+	{
+		int32 data = LUA_NOREF;
+		if (slot.waitKind == WK_TIME)
+			data = timeWheel->cancel(slot.waitHandle);
+		else if (slot.waitKind == WK_FRAME)
+			data = frameWheel->cancel(slot.waitHandle);
+		if (data != LUA_NOREF && data != INDEX_NONE)
+			luaL_unref(L, LUA_REGISTRYINDEX, data);
+		slot.waitKind = WK_NONE;
+		slot.waitHandle = INDEX_NONE;
+	}
+
+	int LuaState::waitSeconds(lua_State *thread, double seconds)
+	{
+		int threadId = prepareWait(thread);
+		ThreadSlot& slot = threadSlots[threadId & ThreadSlotMask];
+		// in milliseconds, elapsed time of current tick is counted at next tick
+		uint64 delay = seconds > 0 ? (uint64)FMath::CeilToDouble(seconds * 1000.0) : 0;
+		slot.waitKind = WK_TIME;
+		slot.waitHandle = timeWheel->add(delay, threadId, LUA_NOREF);
+		return lua_yield(thread, 0);
+	}
+
+	int LuaState::waitFrames(lua_State *thread, int32 frames)
+	{
+		int threadId = prepareWait(thread);
+		ThreadSlot& slot = threadSlots[threadId & ThreadSlotMask];
+		// frame wheel advance 1 tick per frame, so n frames is n-1 ticks from next tick
+		slot.waitKind = WK_FRAME;
+		slot.waitHandle = frameWheel->add(frames > 1 ? frames - 1 : 0, threadId, LUA_NOREF);
+		return lua_yield(thread, 0);
+	}
+
+	int LuaState::waitUntil(lua_State *thread, int fn)
+	{
+		luaL_checktype(thread, fn, LUA_TFUNCTION);
+		int threadId = prepareWait(thread);
+		ThreadSlot& slot = threadSlots[threadId & ThreadSlotMask];
+		lua_pushvalue(thread, fn);
+		int fnRef = luaL_ref(thread, LUA_REGISTRYINDEX);
+		// poll predicate once per frame
+		slot.waitKind = WK_FRAME;
+		slot.waitHandle = frameWheel->add(0, threadId, fnRef);
+		return lua_yield(thread, 0);
+	}
+
+	bool LuaState::pollWaitUntil(int fnRef, bool& done)
+	{
+		AutoStack as(L);
+		int errfunc = pushErrorHandler(L);
+		lua_rawgeti(L, LUA_REGISTRYINDEX, fnRef);
+		LuaScriptEntryScope entry(L, SE_TICK);
+		if (lua_pcall(L, 0, 1, errfunc))
+			return false;
+		done = !!lua_toboolean(L, -1);
+		return true;
+	}
+
+	void LuaState::initWorkers(int32 num, const TArray<FString>& modules)
+	{
+		if (workerPool.IsValid())
+			workerPool->stop();
+		workerPool = MakeShareable(new LuaWorkerPool(loadFileDelegate, num, modules));
+	}
+
+	LuaWorkerPool* LuaState::getWorkerPool()
+	{
+		if (!workerPool.IsValid())
+			initWorkers(0, TArray<FString>());
+		return workerPool.Get();
+	}
+
+	static int unpackWorkerResult(lua_State* L)
+	{
+		auto result = (LuaWorkerPool::Result*)lua_touserdata(L, 1);
+		lua_settop(L, 0);
+		lua_pushboolean(L, result->ok);
+		if (!result->ok) {
+			lua_pushlstring(L, (const char*)result->data.GetData(), result->data.Num());
+			return 2;
+		}
+		if (result->data.Num() == 0)
+			return 1;
+		int n = LuaSerializer::unpack(L, result->data.GetData(), result->data.Num());
+		if (n < 0) return lua_error(L);
+		return n + 1;
+	}
+
+	void LuaState::tickWorkers()
+	{
+		if (!workerPool.IsValid()) return;
+		TArray<LuaWorkerPool::Result> results;
+		workerPool->takeResults(results);
+
+		for (auto& result : results) {
+			WorkerWait wait;
+			// nobody wait for result
+			if (!workerWaits.RemoveAndCopyValue(result.id, wait))
+				continue;
+
+			AutoStack as(L);
+			int errfunc = pushErrorHandler(L);
+			if (wait.callbackRef != LUA_NOREF) {
+				lua_rawgeti(L, LUA_REGISTRYINDEX, wait.callbackRef);
+				luaL_unref(L, LUA_REGISTRYINDEX, wait.callbackRef);
+			}
+			// pass ok and return values, or false and error message
+			int base = lua_gettop(L);
+			lua_pushcfunction(L, unpackWorkerResult);
+			lua_pushlightuserdata(L, &result);
+			if (lua_pcall(L, 1, LUA_MULTRET, errfunc))
+				continue;
+			int nargs = lua_gettop(L) - base;
+
+			if (wait.callbackRef != LUA_NOREF)
+				lua_pcall(L, nargs, 0, errfunc);
+			else if (isThreadId(wait.threadId)) {
+				lua_State* thread = threadSlots[wait.threadId & ThreadSlotMask].thread;
+				if (!lua_checkstack(thread, nargs)) {
+					Log::Error("too many results from worker");
+					continue;
+				}
+				lua_xmove(L, thread, nargs);
+				resumeThread(wait.threadId, nargs);
+			}
+		}
+	}
+
+	void LuaState::tickWaits(float dtime)
+	{
+		waitClock += dtime;
+		TArray<LuaTimerWheel::Expired> expired;
+		timeWheel->advance((uint64)(waitClock * 1000.0), expired);
+		frameWheel->advance(frameWheel->now() + 1, expired);
+		if (expired.Num() == 0) return;
+
+		// timers had been removed from wheels, so slots don't own them anymore
+		for (auto& e : expired) {
+			if (isThreadId(e.payload)) {
+				ThreadSlot& slot = threadSlots[e.payload & ThreadSlotMask];
+				slot.waitKind = WK_NONE;
+				slot.waitHandle = INDEX_NONE;
+			}
+		}
+
+		for (auto& e : expired) {
+			// coroutine released before timer expired
+			if (!isThreadId(e.payload)) {
+				if (e.data != LUA_NOREF) luaL_unref(L, LUA_REGISTRYINDEX, e.data);
+				continue;
 			}
+
+			if (e.data != LUA_NOREF) {
+				bool done = false;
+				bool ok = pollWaitUntil(e.data, done);
+				// predicate may release the coroutine or make it wait for other things
+				bool waiting = isThreadId(e.payload) && threadSlots[e.payload & ThreadSlotMask].waitKind == WK_NONE;
+				if (ok && !done && waiting) {
+					ThreadSlot& slot = threadSlots[e.payload & ThreadSlotMask];
+					slot.waitKind = WK_FRAME;
+					slot.waitHandle = frameWheel->add(0, e.payload, e.data);
+					continue;
+				}
+				luaL_unref(L, LUA_REGISTRYINDEX, e.data);
+				if (!waiting) continue;
+				// error had been reported by error handler, drop the coroutine
+				if (!ok) {
+					freeThreadSlot(e.payload & ThreadSlotMask);
+					continue;
+				}
+			}
+
+			// values yielded by coroutine are left on main stack
+			AutoStack as(L);
+			resumeThread(e.payload);
 		}
-		threadToRef.Empty();
-		refToThread.Empty();
 	}
 
 	ULatentDelegate* LuaState::getLatentDelegate() const
@@ -680,6 +1408,17 @@ namespace NS_SLUA {
         return rt;
     }
 
+	TSharedPtr<LuaPathHandle> LuaState::getPathHandle(const FString& path)
+	{
+		TSharedPtr<LuaPathHandle>* handle = pathHandles.Find(path);
+		if (handle)
+			return *handle;
+		// paths built at runtime can't grow cache without limit
+		if (pathHandles.Num() >= MaxPathHandles)
+			pathHandles.Empty();
+		return pathHandles.Add(path, MakeShared<LuaPathHandle>(L, TCHAR_TO_UTF8(*path)));
+	}
+
 	bool LuaState::set(const char * key, LuaVar v)
 	{
 		// push global table
@@ -753,116 +1492,66 @@ namespace NS_SLUA {
 
 	void LuaState::addRef(UObject* obj, void* ud, bool ref)
 	{
-		auto* udptr = objRefs.Find(obj);
-		// if any obj find in objRefs, it should be flag freed and removed
-		if (udptr) {
+		int32 index = LuaObjectRefs::indexOf(obj);
+		auto* udptr = objRefs->find(index);
+		// if any obj find in objRefs, it should be flag freed and replaced
+		if (udptr && *udptr) {
 			(*udptr)->flag |= UD_HADFREE;
-			objRefs.Remove(obj);
+			unlinkProps(*udptr);
 		}
 
 		GenericUserData* userData = (GenericUserData*)ud;
 		if (ref && userData) {
 			userData->flag |= UD_REFERENCE;
 		}
-		objRefs.Add(obj,userData);
-	}
-
-	FDeadLoopCheck::FDeadLoopCheck()
-		: timeoutEvent(nullptr)
-		, timeoutCounter(0)
-		, stopCounter(0)
-		, frameCounter(0)
-	{
-		thread = FRunnableThread::Create(this, TEXT("FLuaDeadLoopCheck"), 0, TPri_BelowNormal);
-	}
-
-	FDeadLoopCheck::~FDeadLoopCheck()
-	{
-		Stop();
-		thread->WaitForCompletion();
-		SafeDelete(thread);
-	}
-
-	uint32 FDeadLoopCheck::Run()
-	{
-		while (stopCounter.GetValue() == 0) {
-			FPlatformProcess::Sleep(1.0f);
-			if (frameCounter.GetValue() != 0) {
-				timeoutCounter.Increment();
-				if(timeoutCounter.GetValue() >= MaxLuaExecTime)
-					onScriptTimeout();
-			}
-		}
-		return 0;
-	}
-
-	void FDeadLoopCheck::Stop()
-	{
-		stopCounter.Increment();
+		// ref without userdata is held by delegate, always referenced
+		objRefs->add(obj, index, userData, !userData || (userData->flag & UD_REFERENCE));
 	}
 
-	int FDeadLoopCheck::scriptEnter(ScriptTimeoutEvent* pEvent)
+	LuaStateLock::LuaStateLock(lua_State* L)
+		: cs(nullptr)
 	{
-		int ret = frameCounter.Increment();
-		if ( ret == 1) {
-			timeoutCounter.Set(0);
-			timeoutEvent.store(pEvent);
+		auto ls = LuaState::get(L);
+		if (ls && ls->enableMultiThreadGC) {
+			cs = &ls->stateLock;
+			cs->Lock();
 		}
-		return ret;
-	}
-
-	int FDeadLoopCheck::scriptLeave()
-	{
-		return frameCounter.Decrement();
 	}
 
-	void FDeadLoopCheck::onScriptTimeout()
+	LuaStateLock::~LuaStateLock()
 	{
-		auto pEvent = timeoutEvent.load();
-		if (pEvent) {
-			timeoutEvent.store(nullptr);
-			pEvent->onTimeout();
-		}
+		if (cs) cs->Unlock();
 	}
 
 	LuaScriptCallGuard::LuaScriptCallGuard(lua_State * L_)
 		:L(L_)
 	{
 		auto ls = LuaState::get(L);
-		ls->deadLoopCheck->scriptEnter(this);
+		LuaWatchdog::scriptEnter(ls->scriptWatch, ls->currentEntry);
 	}
 
 	LuaScriptCallGuard::~LuaScriptCallGuard()
 	{
 		auto ls = LuaState::get(L);
-		ls->deadLoopCheck->scriptLeave();
+		ScriptWatch* watch = ls->scriptWatch;
+		double ms = LuaWatchdog::scriptLeave(watch);
+		// outermost call exceed budget
+		if (ms > 0 && (watch->flags.load()&ScriptWatch::WF_SLOW))
+			ls->onScriptSlow((ScriptEntry)watch->entry.load(), ms, watch->traceback);
 	}
 
-	void LuaScriptCallGuard::onTimeout()
+	LuaScriptEntryScope::LuaScriptEntryScope(lua_State* L, ScriptEntry entry)
+		: ls(L ? LuaState::get(L) : nullptr)
+		, old(SE_CALL)
 	{
-		auto hook = lua_gethook(L);
-		// if debugger isn't exists
-		if (hook == nullptr) {
-			// this function thread safe
-			lua_sethook(L, scriptTimeout, LUA_MASKLINE, 0);
-		}
+		if (!ls) return;
+		old = ls->currentEntry;
+		ls->currentEntry = entry;
 	}
 
-	void LuaScriptCallGuard::scriptTimeout(lua_State *L, lua_Debug *ar)
+	LuaScriptEntryScope::~LuaScriptEntryScope()
 	{
-		// only report once
-		lua_sethook(L, nullptr, 0, 0);
-		luaL_error(L, "script exec timeout");
-	}
-
-	UFunction* LuaState::ClassCache::findFunc(UClass* uclass, const char* fname)
-	{
-		auto item = cacheFuncMap.Find(uclass);
-		if (!item) return nullptr;
-		auto func = item->Find(UTF8_TO_TCHAR(fname));
-		if(func!=nullptr)
-			return func->IsValid() ? func->Get() : nullptr;
-		return nullptr;
+		if (ls) ls->currentEntry = old;
 	}
 
 	UProperty* LuaState::ClassCache::findProp(UClass* uclass, const char* pname)
@@ -875,15 +1564,51 @@ namespace NS_SLUA {
 		return nullptr;
 	}
 
-	void LuaState::ClassCache::cacheFunc(UClass* uclass, const char* fname, UFunction* func)
-	{
-		auto& item = cacheFuncMap.FindOrAdd(uclass);
-		item.Add(UTF8_TO_TCHAR(fname), func);
-	}
-
 	void LuaState::ClassCache::cacheProp(UClass* uclass, const char* pname, UProperty* prop)
 	{
 		auto& item = cachePropMap.FindOrAdd(uclass);
 		item.Add(UTF8_TO_TCHAR(pname), prop);
 	}
+
+	void LuaState::ClassCache::pushMembers(lua_State* L, UClass* uclass, bool isStatic)
+	{
+		auto& map = isStatic ? cacheStaticMemberMap : cacheMemberMap;
+		auto ref = map.Find(uclass);
+		if (ref) {
+			lua_rawgeti(L, LUA_REGISTRYINDEX, *ref);
+			return;
+		}
+
+		lua_newtable(L);
+		// instance members preload all properties of uclass,
+		// ufunction closures are filled lazily by index
+		if (!isStatic) {
+			for (UProperty* prop = uclass->PropertyLink; prop != nullptr; prop = prop->PropertyLinkNext) {
+				lua_pushlightuserdata(L, prop);
+				lua_setfield(L, -2, TCHAR_TO_UTF8(*prop->GetName()));
+			}
+		}
+		lua_pushvalue(L, -1);
+		map.Add(uclass, luaL_ref(L, LUA_REGISTRYINDEX));
+	}
+
+	const LuaFunctionPlan* LuaState::ClassCache::findPlan(UFunction* func)
+	{
+		auto plan = cachePlanMap.FindRef(func);
+		if (!plan) {
+			plan = new LuaFunctionPlan(func);
+			cachePlanMap.Add(func, plan);
+		}
+		return plan;
+	}
+
+	void LuaState::ClassCache::clear()
+	{
+		cachePropMap.Empty();
+		cacheMemberMap.Empty();
+		cacheStaticMemberMap.Empty();
+		for (auto& it : cachePlanMap)
+			LuaFunctionPlan::release(it.Value);
+		cachePlanMap.Empty();
+	}
 }
@@ -0,0 +1,96 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaStructCodec.h"
+#include "LuaObject.h"
+#include "Math/Box2D.h"
+#include "Math/Interval.h"
+#include "Misc/Guid.h"
+#include "Misc/DateTime.h"
+
+namespace NS_SLUA {
+
+	namespace {
+		struct Codec {
+			const char* name;
+			bool (*pack)(lua_State* L, int idx, LuaSerializer& s);
+			void (*push)(lua_State* L, const uint8_t* data);
+			size_t size;
+		};
+
+		template<typename T>
+		bool packT(lua_State* L, int idx, LuaSerializer& s) {
+			T* v = LuaObject::testudata<T>(L, idx);
+			if (!v) return false;
+			s.writeUserdata(LuaObject::typeNameOf<T>(), v, sizeof(T));
+			return true;
+		}
+
+		template<typename T>
+		void pushT(lua_State* L, const uint8_t* data) {
+			// same as LuaWrapper push struct
+			T* v = new T();
+			FMemory::Memcpy(v, data, sizeof(T));
+			LuaObject::push<T>(L, LuaObject::typeNameOf<T>(), v, UD_AUTOGC);
+		}
+
+		#define STRUCT_CODEC(T) { #T, packT<T>, pushT<T>, sizeof(T) }
+		static const Codec codecs[] = {
+			STRUCT_CODEC(FVector),
+			STRUCT_CODEC(FVector2D),
+			STRUCT_CODEC(FRotator),
+			STRUCT_CODEC(FTransform),
+			STRUCT_CODEC(FLinearColor),
+			STRUCT_CODEC(FColor),
+			STRUCT_CODEC(FBox2D),
+			STRUCT_CODEC(FGuid),
+			STRUCT_CODEC(FDateTime),
+			STRUCT_CODEC(FFloatInterval),
+			STRUCT_CODEC(FInt32Interval),
+		};
+		#undef STRUCT_CODEC
+	}
+
+	bool LuaStructCodec::pack(lua_State* L, int idx, LuaSerializer& s)
+	{
+		// type name of wrapped struct is __name of its metatable
+		int t = luaL_getmetafield(L, idx, "__name");
+		if (t != LUA_TSTRING) {
+			// nothing pushed if no such field
+			if (t != LUA_TNIL) lua_pop(L, 1);
+			return false;
+		}
+		const char* name = lua_tostring(L, -1);
+		const Codec* codec = nullptr;
+		for (auto& c : codecs) {
+			if (FCStringAnsi::Strcmp(c.name, name) == 0) {
+				codec = &c;
+				break;
+			}
+		}
+		lua_pop(L, 1);
+		return codec && codec->pack(L, idx, s);
+	}
+
+	bool LuaStructCodec::unpack(lua_State* L, const char* name, size_t nameLen, const uint8_t* data, size_t size)
+	{
+		for (auto& c : codecs) {
+			if (c.size == size && FCStringAnsi::Strlen(c.name) == nameLen
+				&& FCStringAnsi::Strncmp(c.name, name, nameLen) == 0) {
+				c.push(L, data);
+				return true;
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,26 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "LuaSerializer.h"
+
+namespace NS_SLUA {
+
+	// LuaSerializer hooks for plain old data structs wrapped by LuaWrapper,
+	// e.g. FVector, FRotator, FTransform, struct is packed as raw bytes in native layout
+	namespace LuaStructCodec {
+		bool pack(lua_State* L, int idx, LuaSerializer& s);
+		bool unpack(lua_State* L, const char* name, size_t nameLen, const uint8_t* data, size_t size);
+	}
+}
@@ -0,0 +1,149 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaTimerWheel.h"
+
+namespace NS_SLUA {
+
+	LuaTimerWheel::LuaTimerWheel()
+		: freeNode(INDEX_NONE)
+		, current(0)
+		, count(0)
+	{
+		for (int32 i = 0; i < LevelNum * LevelSize; i++)
+			heads[i] = INDEX_NONE;
+	}
+
+	int32 LuaTimerWheel::add(uint64 delay, int32 payload, int32 data) {
+		int32 index = freeNode;
+		if (index != INDEX_NONE)
+			freeNode = nodes[index].next;
+		else
+			index = nodes.AddUninitialized();
+
+		Node& node = nodes[index];
+		node.expire = current + delay;
+		node.payload = payload;
+		node.data = data;
+		link(index);
+		count++;
+		return index;
+	}
+
+	int32 LuaTimerWheel::cancel(int32 handle) {
+		if (!nodes.IsValidIndex(handle) || nodes[handle].list == INDEX_NONE)
+			return INDEX_NONE;
+		int32 data = nodes[handle].data;
+		unlink(handle);
+		release(handle);
+		return data;
+	}
+
+	void LuaTimerWheel::link(int32 index) {
+		Node& node = nodes[index];
+		uint64 delta = node.expire > current ? node.expire - current : 0;
+		// expired timer go to slot processed by next tick
+		uint64 expire = current + delta;
+
+		int32 level = 0;
+		while (level < LevelNum - 1 && delta >= (uint64(1) << (LevelBits * (level + 1))))
+			level++;
+		// too far away, put it at last slot and relink it when expired
+		if (level == LevelNum - 1 && delta >= (uint64(1) << (LevelBits * LevelNum)))
+			expire = current + (uint64(1) << (LevelBits * LevelNum)) - 1;
+
+		int32 list = level * LevelSize + int32((expire >> (LevelBits * level)) & LevelMask);
+		node.list = list;
+		node.prev = INDEX_NONE;
+		node.next = heads[list];
+		if (node.next != INDEX_NONE)
+			nodes[node.next].prev = index;
+		heads[list] = index;
+	}
+
+	void LuaTimerWheel::unlink(int32 index) {
+		Node& node = nodes[index];
+		if (node.prev != INDEX_NONE)
+			nodes[node.prev].next = node.next;
+		else
+			heads[node.list] = node.next;
+		if (node.next != INDEX_NONE)
+			nodes[node.next].prev = node.prev;
+		node.list = INDEX_NONE;
+	}
+
+	void LuaTimerWheel::release(int32 index) {
+		Node& node = nodes[index];
+		node.list = INDEX_NONE;
+		node.next = freeNode;
+		freeNode = index;
+		count--;
+	}
+
+	void LuaTimerWheel::cascade(int32 level) {
+		// move timers of this slot to lower level
+		int32 list = level * LevelSize + int32((current >> (LevelBits * level)) & LevelMask);
+		int32 index = heads[list];
+		heads[list] = INDEX_NONE;
+		while (index != INDEX_NONE) {
+			int32 next = nodes[index].next;
+			link(index);
+			index = next;
+		}
+	}
+
+	void LuaTimerWheel::advance(uint64 to, TArray<Expired>& out) {
+		while (current < to) {
+			// nothing to do, jump to target tick
+			if (count == 0) {
+				current = to;
+				break;
+			}
+
+			int32 slot = int32(current & LevelMask);
+			// lower level wrapped, pull timers down from higher level
+			for (int32 level = 1; level < LevelNum; level++) {
+				if ((current >> (LevelBits * (level - 1))) & LevelMask)
+					break;
+				cascade(level);
+			}
+
+			int32 index = heads[slot];
+			heads[slot] = INDEX_NONE;
+			while (index != INDEX_NONE) {
+				Node& node = nodes[index];
+				int32 next = node.next;
+				if (node.expire > current)
+					link(index);
+				else {
+					out.Add({ node.payload, node.data });
+					release(index);
+				}
+				index = next;
+			}
+			current++;
+		}
+	}
+
+	void LuaTimerWheel::clear(TArray<Expired>& out) {
+		for (auto& node : nodes) {
+			if (node.list != INDEX_NONE)
+				out.Add({ node.payload, node.data });
+		}
+		nodes.Empty();
+		freeNode = INDEX_NONE;
+		count = 0;
+		for (int32 i = 0; i < LevelNum * LevelSize; i++)
+			heads[i] = INDEX_NONE;
+	}
+}
@@ -0,0 +1,70 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+
+namespace NS_SLUA {
+
+	// hierarchical timer wheel, 4 levels of 64 slots,
+	// add/cancel is O(1) and each expired timer costs O(1) amortized
+	class LuaTimerWheel {
+	public:
+		static const int32 LevelBits = 6;
+		static const int32 LevelSize = 1 << LevelBits;
+		static const int32 LevelMask = LevelSize - 1;
+		static const int32 LevelNum = 4;
+
+		struct Expired {
+			int32 payload;
+			int32 data;
+		};
+
+		LuaTimerWheel();
+
+		// add timer expired after delay ticks, return handle for cancel
+		int32 add(uint64 delay, int32 payload, int32 data);
+		// remove timer, return data of it
+		int32 cancel(int32 handle);
+		// process ticks until now reach to, append expired timers to out
+		void advance(uint64 to, TArray<Expired>& out);
+		// remove all timers, append them to out
+		void clear(TArray<Expired>& out);
+
+		uint64 now() const { return current; }
+		int32 num() const { return count; }
+
+	private:
+		struct Node {
+			uint64 expire;
+			int32 payload;
+			int32 data;
+			int32 prev;
+			int32 next;
+			// index of list in heads, INDEX_NONE if node is free
+			int32 list;
+		};
+
+		TArray<Node> nodes;
+		int32 freeNode;
+		int32 heads[LevelNum * LevelSize];
+		// next tick to process
+		uint64 current;
+		int32 count;
+
+		void link(int32 index);
+		void unlink(int32 index);
+		void cascade(int32 level);
+		void release(int32 index);
+	};
+}
@@ -39,6 +39,9 @@ void ULuaUserWidget::NativeConstruct()
 void ULuaUserWidget::NativeDestruct() {
 	Super::NativeDestruct();
 	luaSelfTable.free();
+	classTable.free();
+	classOverrides.Reset();
+	overrideFuncs.Empty();
 }
 
 void ULuaUserWidget::NativeTick(const FGeometry & MyGeometry, float InDeltaTime)
@@ -65,6 +68,7 @@ void ULuaUserWidget::tick(float dt) {
 		superTick();
 		return;
 	}
+	NS_SLUA::LuaScriptEntryScope entry(tickFunction.getState(), NS_SLUA::SE_TICK);
 	tickFunction.call(luaSelfTable, &currentGeometry, dt);
 }
 
@@ -23,6 +23,9 @@
 #include "UObject/Stack.h"
 #include "Blueprint/WidgetTree.h"
 #include "LuaState.h"
+#include "LuaFunctionPlan.h"
+#include "LuaSerializer.h"
+#include "LuaStructCodec.h"
 
 namespace NS_SLUA {
 
@@ -533,7 +536,7 @@ namespace NS_SLUA {
         if(numOfVar==1 && vars[0].luatype==LV_USERDATA) {
             auto L = getState();
             push(L);
-            void* p = luaL_testudata(L, -1, t);
+            void* p = LuaObject::testudataById(L, -1, LuaObject::typeIdOf(t));
             lua_pop(L,1);
             return p!=nullptr;
         }
@@ -563,6 +566,7 @@ namespace NS_SLUA {
             return 0;
         }
         auto L = getState();
+        LuaStateLock lock(L);
         int top = lua_gettop(L);
         top=top-argn+1;
         LuaState::pushErrorHandler(L);
@@ -580,11 +584,39 @@ namespace NS_SLUA {
         return lua_gettop(L)-top+1;
     }
 
-    int LuaVar::pushArgByParms(UProperty* prop,uint8* parms) {
+    bool LuaVar::serialize(TArray<uint8>& out) const {
+        // simple value hasn't state, pack it by main state
         auto L = getState();
-        if (LuaObject::push(L,prop,parms,false))
-            return prop->ElementSize;
-        return 0;
+        LuaState* ls = L ? LuaState::get(L) : LuaState::get();
+        if(!ls || !ls->getLuaState()) {
+            Log::Error("No lua state to serialize LuaVar");
+            return false;
+        }
+        L = ls->getLuaState();
+        AutoStack as(L);
+        int n = push(L);
+        int top = lua_gettop(L);
+        LuaSerializer& s = *ls->serializer;
+        s.reset();
+        for(int i=top-n+1;i<=top;i++) {
+            if(!s.pack(L,i)) {
+                Log::Error("Serialize LuaVar failed: %s",s.error());
+                return false;
+            }
+        }
+        out.Reset();
+        out.Append(s.data(),(int32)s.size());
+        return true;
+    }
+
+    LuaVar LuaVar::deserialize(lua_State* L,const uint8* buf,uint32 len) {
+        AutoStack as(L);
+        int n = LuaSerializer::unpack(L,buf,len,LuaStructCodec::unpack);
+        if(n<0) {
+            Log::Error("Deserialize LuaVar failed: %s",lua_tostring(L,-1));
+            return LuaVar();
+        }
+        return wrapReturn(L,n);
     }
 
     bool LuaVar::callByUFunction(UFunction* func,uint8* parms, LuaVar* pSelf, FOutParmRec* OutParms) {
@@ -596,19 +628,11 @@ namespace NS_SLUA {
             return false;
         }
 
-        const bool bHasReturnParam = func->ReturnValueOffset != MAX_uint16;
-        if(func->ParmsSize==0 && !bHasReturnParam) {
-			int nArg = 0;
-			if (pSelf) {
-				pSelf->push();
-				nArg++;
-			}
+		auto L = getState();
+		LuaStateLock lock(L);
+		// reflection info of func cached by state
+		const LuaFunctionPlan* plan = LuaState::get(L)->classMap.findPlan(func);
 
-			auto L = getState();
-			int n = docall(nArg);
-			lua_pop(L, n);
-            return true;
-        }
         // push self if valid
         int n=0;
 		if (pSelf) {
@@ -616,44 +640,29 @@ namespace NS_SLUA {
 			n++;
 		}
         // push arguments to lua state
-        for(TFieldIterator<UProperty> it(func);it && (it->PropertyFlags&CPF_Parm);++it) {
-            UProperty* prop = *it;
-            uint64 propflag = prop->GetPropertyFlags();
-            if((propflag&CPF_ReturnParm) || IsRealOutParam(propflag))
-                continue;
-
-            pushArgByParms(prop,parms+prop->GetOffset_ForInternal());
-            n++;
-        }
+		for (auto& arg : plan->args) {
+			uint8* ptr = parms + arg.offset;
+			int r = arg.pusher ? arg.pusher(L, arg.prop, ptr, false) : LuaObject::push(L, arg.prop, ptr, false);
+			// keep arguments position if type unsupported
+			if (!r) lua_pushnil(L);
+			n++;
+		}
         
-		auto L = getState();
         int retCount = docall(n);
 		int remain = retCount;
         // if lua return value
-        // we only handle first lua return value
-        if(remain >0 && bHasReturnParam) {
-            auto prop = func->GetReturnProperty();
-            auto checkder = prop?LuaObject::getChecker(prop):nullptr;
-            if (checkder) {
-                (*checkder)(L, prop, parms+prop->GetOffset_ForInternal(), lua_absindex(L, -remain));
-            }
-			remain--;
-        }
-
-		// fill lua return value to blueprint stack if argument is out param
-		for (TFieldIterator<UProperty> it(func); remain >0 && it && (it->PropertyFlags&CPF_Parm); ++it) {
-			UProperty* prop = *it;
-			uint64 propflag = prop->GetPropertyFlags();
-			if (IsRealOutParam(propflag))
-			{
-				auto checkder = prop ? LuaObject::getChecker(prop) : nullptr;
-				uint8* outPamams = OutParms ? OutParms->PropAddr : parms + prop->GetOffset_ForInternal();
-				if (checkder) {
-					(*checkder)(L, prop, outPamams, lua_absindex(L, -remain));
-				}
-				if(OutParms) OutParms = OutParms->NextOutParm;
-				remain--;
+        // we only handle first lua return value as return param,
+        // fill others to blueprint stack if argument is out param
+		for (auto& result : plan->results) {
+			if (remain <= 0) break;
+			uint8* ptr = parms + result.offset;
+			if (!(result.flags&CPF_ReturnParm) && OutParms) {
+				ptr = OutParms->PropAddr;
+				OutParms = OutParms->NextOutParm;
 			}
+			if (result.checker)
+				(*result.checker)(L, result.prop, ptr, lua_absindex(L, -remain));
+			remain--;
 		}
         // pop returned value
         lua_pop(L, retCount);
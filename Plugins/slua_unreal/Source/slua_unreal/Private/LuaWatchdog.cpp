@@ -0,0 +1,223 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaWatchdog.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+
+namespace NS_SLUA {
+
+	static TAutoConsoleVariable<int32> CVarScriptBudgetMs(
+		TEXT("slua.ScriptBudgetMs"),
+		0,
+		TEXT("Report lua script call exceed this time in ms, 0 to disable"),
+		ECVF_Default);
+
+	LuaWatchdog* LuaWatchdog::instance = nullptr;
+	FCriticalSection LuaWatchdog::instanceLock;
+
+	ScriptWatch::ScriptWatch(lua_State* l)
+		: L(l)
+		, depth(0)
+		, serial(0)
+		, hookSerial(0)
+		, flags(0)
+		, enterCycles(0)
+		, entry(SE_CALL)
+		, abortMs(5000)
+	{
+		for (auto& b : budgetMs)
+			b.store(-1);
+	}
+
+	// longest sleep of watchdog, budget changed while sleeping is picked up after it
+	static const int32 MaxSleepMs = 100;
+
+	LuaWatchdog::LuaWatchdog()
+	{
+		wakeEvent = FPlatformProcess::GetSynchEventFromPool();
+		thread = FRunnableThread::Create(this, TEXT("FLuaWatchdog"), 0, TPri_AboveNormal);
+	}
+
+	LuaWatchdog::~LuaWatchdog()
+	{
+		Stop();
+		thread->WaitForCompletion();
+		SafeDelete(thread);
+		FPlatformProcess::ReturnSynchEventToPool(wakeEvent);
+	}
+
+	void LuaWatchdog::add(ScriptWatch* watch)
+	{
+		FScopeLock guard(&instanceLock);
+		// start thread with first state
+		if (!instance)
+			instance = new LuaWatchdog();
+		{
+			FScopeLock watchGuard(&instance->lock);
+			instance->watches.AddUnique(watch);
+		}
+		// recompute sleep time with budget of new state
+		instance->wakeEvent->Trigger();
+	}
+
+	void LuaWatchdog::remove(ScriptWatch* watch)
+	{
+		FScopeLock guard(&instanceLock);
+		if (!instance) return;
+		{
+			FScopeLock watchGuard(&instance->lock);
+			instance->watches.Remove(watch);
+			if (instance->watches.Num() > 0)
+				return;
+		}
+		// stop thread with last state
+		SafeDelete(instance);
+	}
+
+	void LuaWatchdog::scriptEnter(ScriptWatch* watch, ScriptEntry entry)
+	{
+		if (watch->depth.fetch_add(1) > 0)
+			return;
+		watch->entry.store(entry);
+		watch->flags.store(0);
+		watch->traceback.Reset();
+		watch->enterCycles.store(FPlatformTime::Cycles64());
+		// publish new call to watchdog at last
+		watch->serial.fetch_add(1);
+	}
+
+	double LuaWatchdog::scriptLeave(ScriptWatch* watch)
+	{
+		if (watch->depth.load() == 1) {
+			double ms = FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - watch->enterCycles.load());
+			// remove hook not triggered
+			auto hook = lua_gethook(watch->L);
+			if (hook == slowHook || hook == abortHook)
+				lua_sethook(watch->L, nullptr, 0, 0);
+			watch->depth.fetch_sub(1);
+			return ms;
+		}
+		watch->depth.fetch_sub(1);
+		return 0;
+	}
+
+	int32 LuaWatchdog::budgetOf(ScriptWatch* watch, int32 entry)
+	{
+		int32 ms = watch->budgetMs[entry].load();
+		return ms >= 0 ? ms : CVarScriptBudgetMs.GetValueOnAnyThread();
+	}
+
+	uint32 LuaWatchdog::Run()
+	{
+		while (stopCounter.GetValue() == 0) {
+			double sleepMs = MaxSleepMs;
+			{
+				uint64 now = FPlatformTime::Cycles64();
+				FScopeLock guard(&lock);
+				for (auto watch : watches)
+					sleepMs = FMath::Min(sleepMs, check(watch, now));
+			}
+			// sleep until the nearest budget or abort time, woken by add and Stop
+			wakeEvent->Wait(FMath::Max(1, FMath::CeilToInt(sleepMs)));
+		}
+		return 0;
+	}
+
+	void LuaWatchdog::Stop()
+	{
+		stopCounter.Increment();
+		wakeEvent->Trigger();
+	}
+
+	void LuaWatchdog::setHook(ScriptWatch* watch, lua_Hook hook, int mask)
+	{
+		// hook main thread and the coroutine running now, hook is per thread,
+		// the one left on a thread not running is removed by itself with serial check
+		lua_State* running = lua_getrunning(watch->L);
+		lua_State* threads[] = { watch->L, running };
+		for (int n = 0; n < (running == watch->L ? 1 : 2); n++) {
+			auto old = lua_gethook(threads[n]);
+			// don't replace debugger hook, abort hook replaces slow hook
+			if (old == nullptr || (hook == abortHook && old == slowHook))
+				lua_sethook(threads[n], hook, mask, 1);
+		}
+	}
+
+	double LuaWatchdog::check(ScriptWatch* watch, uint64 now)
+	{
+		int32 abortMs = watch->abortMs.load();
+		int32 budget = budgetOf(watch, watch->entry.load());
+		// idle state, next call can't exceed any limit sooner than that
+		if (watch->depth.load() == 0) {
+			double next = MaxSleepMs;
+			if (abortMs > 0) next = FMath::Min<double>(next, abortMs);
+			if (budget > 0) next = FMath::Min<double>(next, budget);
+			return next;
+		}
+
+		uint32 serial = watch->serial.load();
+		uint64 enter = watch->enterCycles.load();
+		if (now < enter) return 1;
+		double elapsed = FPlatformTime::ToMilliseconds64(now - enter);
+		uint32 flags = watch->flags.load();
+
+		if (abortMs > 0 && elapsed > abortMs && !(flags&ScriptWatch::WF_ABORT)) {
+			watch->flags.fetch_or(ScriptWatch::WF_ABORT);
+			watch->hookSerial.store(serial);
+			setHook(watch, abortHook, LUA_MASKLINE | LUA_MASKCOUNT);
+			return MaxSleepMs;
+		}
+
+		if (budget > 0 && elapsed > budget && !(flags&(ScriptWatch::WF_SLOW | ScriptWatch::WF_ABORT))) {
+			watch->flags.fetch_or(ScriptWatch::WF_SLOW);
+			watch->hookSerial.store(serial);
+			setHook(watch, slowHook, LUA_MASKCOUNT);
+		}
+
+		// time to next limit of this call
+		flags = watch->flags.load();
+		double next = MaxSleepMs;
+		if (abortMs > 0 && !(flags&ScriptWatch::WF_ABORT))
+			next = FMath::Min(next, abortMs - elapsed);
+		if (budget > 0 && !(flags&(ScriptWatch::WF_SLOW | ScriptWatch::WF_ABORT)))
+			next = FMath::Min(next, budget - elapsed);
+		return next;
+	}
+
+	void LuaWatchdog::slowHook(lua_State* L, lua_Debug* ar)
+	{
+		lua_sethook(L, nullptr, 0, 0);
+		auto ls = LuaState::get(L);
+		ScriptWatch* watch = ls ? ls->scriptWatch : nullptr;
+		// hook set for a finished call
+		if (!watch || watch->hookSerial.load() != watch->serial.load())
+			return;
+		luaL_traceback(L, L, "slow script", 0);
+		watch->traceback = UTF8_TO_TCHAR(lua_tostring(L, -1));
+		lua_pop(L, 1);
+	}
+
+	void LuaWatchdog::abortHook(lua_State* L, lua_Debug* ar)
+	{
+		lua_sethook(L, nullptr, 0, 0);
+		auto ls = LuaState::get(L);
+		ScriptWatch* watch = ls ? ls->scriptWatch : nullptr;
+		if (!watch || watch->hookSerial.load() != watch->serial.load())
+			return;
+		luaL_error(L, "script exec timeout");
+	}
+}
@@ -0,0 +1,85 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "HAL/Runnable.h"
+#include "LuaState.h"
+#include <atomic>
+
+namespace NS_SLUA {
+
+	// script call state of a LuaState watched by LuaWatchdog
+	struct ScriptWatch {
+		enum Flag {
+			WF_SLOW = 1,
+			WF_ABORT = 2,
+		};
+
+		ScriptWatch(lua_State* L);
+
+		lua_State* L;
+		// depth of nested script call
+		std::atomic<int32> depth;
+		// increased by every outermost call
+		std::atomic<uint32> serial;
+		// serial of call that watchdog set hook for
+		std::atomic<uint32> hookSerial;
+		std::atomic<uint32> flags;
+		std::atomic<uint64> enterCycles;
+		std::atomic<int32> entry;
+		// budget of each entry in ms, 0 to disable, negative to use cvar slua.ScriptBudgetMs
+		std::atomic<int32> budgetMs[SE_NUM];
+		// abort script if exceed it, 0 to disable
+		std::atomic<int32> abortMs;
+		// lua stack captured on lua thread when over budget
+		FString traceback;
+	};
+
+	// one thread to watch all script calls of LuaStates,
+	// report slow script and abort dead loop
+	class LuaWatchdog : public FRunnable {
+	public:
+		static void add(ScriptWatch* watch);
+		static void remove(ScriptWatch* watch);
+
+		// called by outermost script call
+		static void scriptEnter(ScriptWatch* watch, ScriptEntry entry);
+		// return elapsed ms of outermost call, or 0 if call is nested
+		static double scriptLeave(ScriptWatch* watch);
+
+	protected:
+		uint32 Run() override;
+		void Stop() override;
+
+	private:
+		LuaWatchdog();
+		virtual ~LuaWatchdog();
+
+		// return ms to the next limit of watch
+		double check(ScriptWatch* watch, uint64 now);
+		static void setHook(ScriptWatch* watch, lua_Hook hook, int mask);
+		static int32 budgetOf(ScriptWatch* watch, int32 entry);
+		static void slowHook(lua_State* L, lua_Debug* ar);
+		static void abortHook(lua_State* L, lua_Debug* ar);
+
+		TArray<ScriptWatch*> watches;
+		FCriticalSection lock;
+		FThreadSafeCounter stopCounter;
+		FEvent* wakeEvent;
+		FRunnableThread* thread;
+
+		static LuaWatchdog* instance;
+		static FCriticalSection instanceLock;
+	};
+}
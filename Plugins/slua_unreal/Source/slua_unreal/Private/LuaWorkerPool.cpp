@@ -0,0 +1,265 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#include "LuaWorkerPool.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "Misc/ScopeLock.h"
+#include "HAL/IConsoleManager.h"
+#include "SluaUtil.h"
+#include "Log.h"
+
+namespace NS_SLUA {
+
+	static TAutoConsoleVariable<int32> CVarWorkerCount(
+		TEXT("slua.WorkerCount"),
+		2,
+		TEXT("Count of worker lua states if not given by LuaState::initWorkers"),
+		ECVF_Default);
+
+	namespace {
+		int traceback(lua_State* L) {
+			luaL_traceback(L, L, lua_tostring(L, 1), 1);
+			return 1;
+		}
+
+		void setError(TArray<uint8>& data, const char* err) {
+			int32 len = (int32)strlen(err);
+			data.SetNumUninitialized(len);
+			FMemory::Memcpy(data.GetData(), err, len);
+		}
+
+		// called by lua_pcall, unpack may raise memory error
+		int unpackArgs(lua_State* L) {
+			auto args = (const TArray<uint8>*)lua_touserdata(L, 1);
+			lua_settop(L, 0);
+			int n = LuaSerializer::unpack(L, args->GetData(), args->Num());
+			if (n < 0) return lua_error(L);
+			return n;
+		}
+	}
+
+	LuaWorkerPool::LuaWorkerPool(LuaState::LoadFileDelegate d, int32 num, const TArray<FString>& m)
+		: loadFileDelegate(d)
+		, modules(m)
+		, stopped(false)
+		, jobId(0)
+	{
+		if (num <= 0) num = CVarWorkerCount.GetValueOnAnyThread();
+		num = FMath::Max(num, 1);
+		for (int32 i = 0; i < num; i++) {
+			// lua state is created on first job, off game thread
+			Worker* worker = new Worker();
+			worker->L = nullptr;
+			workers.Add(worker);
+			idleWorkers.Add(worker);
+		}
+	}
+
+	LuaWorkerPool::~LuaWorkerPool()
+	{
+		// tasks hold shared ref, so all workers are idle here
+		for (Worker* worker : workers) {
+			if (worker->L) lua_close(worker->L);
+			delete worker;
+		}
+	}
+
+	int32 LuaWorkerPool::post(lua_State* L, const char* module, const char* func, int first)
+	{
+		argPacker.reset();
+		int top = lua_gettop(L);
+		for (int i = first; i <= top; i++) {
+			if (!argPacker.pack(L, i))
+				luaL_error(L, "can't pass argument %d to worker, %s", i, argPacker.error());
+		}
+
+		Job job;
+		job.module = UTF8_TO_TCHAR(module ? module : "");
+		job.func = UTF8_TO_TCHAR(func);
+		job.args.Append(argPacker.data(), (int32)argPacker.size());
+
+		int32 id;
+		Worker* worker = nullptr;
+		{
+			FScopeLock guard(&lock);
+			if (++jobId <= 0) jobId = 1;
+			id = job.id = jobId;
+			jobs.Add(MoveTemp(job));
+			if (idleWorkers.Num() > 0)
+				worker = idleWorkers.Pop(false);
+		}
+		if (worker) dispatch(worker);
+		return id;
+	}
+
+	void LuaWorkerPool::dispatch(Worker* worker)
+	{
+		TSharedRef<LuaWorkerPool, ESPMode::ThreadSafe> self = AsShared();
+		FFunctionGraphTask::CreateAndDispatchWhenReady([self, worker]() {
+			while (true) {
+				Job job;
+				{
+					FScopeLock guard(&self->lock);
+					if (self->stopped || self->jobs.Num() == 0) {
+						self->idleWorkers.Add(worker);
+						return;
+					}
+					job = MoveTemp(self->jobs[0]);
+					self->jobs.RemoveAt(0, 1, false);
+				}
+
+				Result result = { job.id, false };
+				self->run(worker, job, result);
+
+				FScopeLock guard(&self->lock);
+				self->results.Add(MoveTemp(result));
+			}
+		}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+	}
+
+	void LuaWorkerPool::run(Worker* worker, Job& job, Result& result)
+	{
+		if (!worker->L)
+			worker->L = createState();
+		lua_State* L = worker->L;
+		lua_settop(L, 0);
+
+		lua_pushcfunction(L, traceback);
+		int errfunc = lua_gettop(L);
+		if (job.module.Len() > 0) {
+			lua_getglobal(L, "require");
+			lua_pushstring(L, TCHAR_TO_UTF8(*job.module));
+			if (lua_pcall(L, 1, 1, errfunc)) {
+				setError(result.data, lua_tostring(L, -1));
+				lua_settop(L, 0);
+				return;
+			}
+			if (lua_type(L, -1) == LUA_TTABLE)
+				lua_getfield(L, -1, TCHAR_TO_UTF8(*job.func));
+			else
+				lua_pushnil(L);
+			lua_remove(L, -2);
+		}
+		else
+			lua_getglobal(L, TCHAR_TO_UTF8(*job.func));
+
+		if (!lua_isfunction(L, -1)) {
+			setError(result.data, TCHAR_TO_UTF8(*FString::Printf(TEXT("worker function %s.%s not found"), *job.module, *job.func)));
+			lua_settop(L, 0);
+			return;
+		}
+
+		int func = lua_gettop(L);
+		if (job.args.Num() > 0) {
+			lua_pushcfunction(L, unpackArgs);
+			lua_pushlightuserdata(L, &job.args);
+			if (lua_pcall(L, 1, LUA_MULTRET, errfunc)) {
+				setError(result.data, lua_tostring(L, -1));
+				lua_settop(L, 0);
+				return;
+			}
+		}
+		int nargs = lua_gettop(L) - func;
+		if (lua_pcall(L, nargs, LUA_MULTRET, errfunc)) {
+			setError(result.data, lua_tostring(L, -1));
+			lua_settop(L, 0);
+			return;
+		}
+
+		LuaSerializer& packer = worker->packer;
+		packer.reset();
+		int top = lua_gettop(L);
+		for (int i = func; i <= top; i++) {
+			if (!packer.pack(L, i)) {
+				setError(result.data, packer.error());
+				lua_settop(L, 0);
+				return;
+			}
+		}
+		result.ok = true;
+		result.data.Append(packer.data(), (int32)packer.size());
+		lua_settop(L, 0);
+		// keep worker memory low between jobs
+		lua_gc(L, LUA_GCSTEP, 0);
+	}
+
+	lua_State* LuaWorkerPool::createState()
+	{
+		lua_State* L = luaL_newstate();
+		luaL_openlibs(L);
+
+		// require from load delegate like main state
+		lua_getglobal(L, "package");
+		lua_getfield(L, -1, "searchers");
+		int loaderTable = lua_gettop(L);
+		for (int i = lua_rawlen(L, loaderTable) + 1; i > 2; i--) {
+			lua_rawgeti(L, loaderTable, i - 1);
+			lua_rawseti(L, loaderTable, i);
+		}
+		lua_pushlightuserdata(L, (void*)loadFileDelegate);
+		lua_pushcclosure(L, loader, 1);
+		lua_rawseti(L, loaderTable, 2);
+		lua_settop(L, 0);
+
+		// let script know it's running on worker
+		lua_pushboolean(L, 1);
+		lua_setglobal(L, "SLUA_WORKER");
+
+		lua_pushcfunction(L, traceback);
+		int errfunc = lua_gettop(L);
+		for (auto& module : modules) {
+			lua_getglobal(L, "require");
+			lua_pushstring(L, TCHAR_TO_UTF8(*module));
+			if (lua_pcall(L, 1, 0, errfunc)) {
+				Log::Error("Worker require %s failed: %s", TCHAR_TO_UTF8(*module), lua_tostring(L, -1));
+				lua_pop(L, 1);
+			}
+		}
+		lua_settop(L, 0);
+		return L;
+	}
+
+	int LuaWorkerPool::loader(lua_State* L)
+	{
+		auto loadFileDelegate = (LuaState::LoadFileDelegate)lua_touserdata(L, lua_upvalueindex(1));
+		const char* fn = lua_tostring(L, 1);
+		uint32 len;
+		FString filepath;
+		uint8* buf = loadFileDelegate ? loadFileDelegate(fn, len, filepath) : nullptr;
+		if (!buf) {
+			lua_pushfstring(L, "\n\tno file '%s' by slua worker loader", fn);
+			return 1;
+		}
+		AutoDeleteArray<uint8> defer(buf);
+		char chunk[256];
+		snprintf(chunk, 256, "@%s", TCHAR_TO_UTF8(*filepath));
+		if (luaL_loadbuffer(L, (const char*)buf, len, chunk))
+			return lua_error(L);
+		return 1;
+	}
+
+	void LuaWorkerPool::takeResults(TArray<Result>& out)
+	{
+		FScopeLock guard(&lock);
+		if (results.Num() == 0) return;
+		out.Append(MoveTemp(results));
+		results.Reset();
+	}
+
+	void LuaWorkerPool::stop()
+	{
+		FScopeLock guard(&lock);
+		stopped = true;
+		jobs.Empty();
+	}
+}
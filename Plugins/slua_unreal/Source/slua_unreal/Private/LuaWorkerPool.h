@@ -0,0 +1,76 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "LuaState.h"
+#include "LuaSerializer.h"
+
+namespace NS_SLUA {
+
+	// headless lua states run pure lua functions on task graph threads,
+	// no UObject binding in worker, arguments and results are copied by LuaSerializer
+	class LuaWorkerPool : public TSharedFromThis<LuaWorkerPool, ESPMode::ThreadSafe> {
+	public:
+		struct Result {
+			int32 id;
+			bool ok;
+			// packed return values, or error message if not ok
+			TArray<uint8> data;
+		};
+
+		// load delegate must be thread safe, it's called on worker thread,
+		// modules are required by each worker after it created, num <= 0 to use cvar slua.WorkerCount
+		LuaWorkerPool(LuaState::LoadFileDelegate loadFileDelegate, int32 num, const TArray<FString>& modules);
+		~LuaWorkerPool();
+
+		// call module.func on worker with arguments from first to top of L,
+		// module can be empty for global function, return job id
+		int32 post(lua_State* L, const char* module, const char* func, int first);
+		// take finished results, called on game thread
+		void takeResults(TArray<Result>& out);
+		// drop queued jobs, workers are closed after running jobs finished
+		void stop();
+
+	private:
+		struct Job {
+			int32 id;
+			FString module;
+			FString func;
+			TArray<uint8> args;
+		};
+
+		struct Worker {
+			lua_State* L;
+			// reused for results
+			LuaSerializer packer;
+		};
+
+		LuaState::LoadFileDelegate loadFileDelegate;
+		TArray<FString> modules;
+		TArray<Worker*> workers;
+		TArray<Worker*> idleWorkers;
+		TArray<Job> jobs;
+		TArray<Result> results;
+		FCriticalSection lock;
+		bool stopped;
+		int32 jobId;
+		// pack arguments on game thread
+		LuaSerializer argPacker;
+
+		void dispatch(Worker* worker);
+		void run(Worker* worker, Job& job, Result& result);
+		lua_State* createState();
+		static int loader(lua_State* L);
+	};
+}
@@ -507,11 +507,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FSlateFontInfo);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FSlateFontInfo*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
@@ -596,11 +596,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FSlateBrush);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FSlateBrush*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
@@ -777,11 +777,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FMargin);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FMargin*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __mul(lua_State* L) {
@@ -965,11 +965,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FGeometry);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FGeometry*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
@@ -1242,11 +1242,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FSlateColor);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FSlateColor*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
@@ -1351,11 +1351,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FRotator);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FRotator*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __add(lua_State* L) {
@@ -1934,11 +1934,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FTransform);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FTransform*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __add(lua_State* L) {
@@ -2948,11 +2948,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FLinearColor);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FLinearColor*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __add(lua_State* L) {
@@ -3575,11 +3575,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FColor);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FColor*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
@@ -3941,11 +3941,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FVector);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FVector*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __add(lua_State* L) {
@@ -5341,11 +5341,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FVector2D);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FVector2D*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __add(lua_State* L) {
@@ -5909,11 +5909,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FRandomStream);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FRandomStream*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int Initialize(lua_State* L) {
@@ -6152,11 +6152,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FGuid);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FGuid*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int get_A(lua_State* L) {
@@ -6357,11 +6357,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FBox2D);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FBox2D*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
@@ -6670,11 +6670,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FFloatRangeBound);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FFloatRangeBound*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int Exclusive(lua_State* L) {
@@ -6835,11 +6835,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FFloatRange);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FFloatRange*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int Empty(lua_State* L) {
@@ -6924,11 +6924,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FInt32RangeBound);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FInt32RangeBound*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int Exclusive(lua_State* L) {
@@ -7089,11 +7089,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FInt32Range);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FInt32Range*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int Empty(lua_State* L) {
@@ -7178,11 +7178,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FFloatInterval);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FFloatInterval*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static void bind(lua_State* L) {
@@ -7213,11 +7213,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FInt32Interval);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FInt32Interval*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static void bind(lua_State* L) {
@@ -7248,11 +7248,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FPrimaryAssetType);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FPrimaryAssetType*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
@@ -7322,11 +7322,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FPrimaryAssetId);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FPrimaryAssetId*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
@@ -7439,11 +7439,11 @@ namespace NS_SLUA {
 			return 0;
 		}
 
-		static int __gc(lua_State* L) {
-			CheckSelf(FDateTime);
+		static void __gc(lua_State* L, GenericUserData* ud) {
+			auto udptr = reinterpret_cast<UserData<FDateTime*>*>(ud);
+			if (udptr->flag & UD_HADFREE) return;
 			LuaObject::releaseLink(L, udptr);
-			if (udptr->flag & UD_AUTOGC) delete self;
-			return 0;
+			if (udptr->flag & UD_AUTOGC) delete udptr->ud;
 		}
 
 		static int __eq(lua_State* L) {
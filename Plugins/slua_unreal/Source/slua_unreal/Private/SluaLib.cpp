@@ -32,6 +32,10 @@
 #include "Engine/GameEngine.h"
 #endif
 #include "LuaMemoryProfile.h"
+#include "LuaJobRunner.h"
+#include "LuaWorkerPool.h"
+#include "LuaStructCodec.h"
+#include "LuaObjectRefs.h"
 #include "Runtime/Launch/Resources/Version.h"
 #include <chrono>
 
@@ -49,6 +53,19 @@ namespace NS_SLUA {
 		RegMetaMethod(L, loadObject);
 		RegMetaMethod(L, threadGC);
 		RegMetaMethod(L, isValid);
+		RegMetaMethod(L, wait);
+		RegMetaMethod(L, waitFrames);
+		RegMetaMethod(L, waitUntil);
+		RegMetaMethod(L, startJob);
+		RegMetaMethod(L, cancelJob);
+		RegMetaMethod(L, jobYield);
+		RegMetaMethod(L, getJobMicroseconds);
+		RegMetaMethod(L, postWorker);
+		RegMetaMethod(L, callWorker);
+		RegMetaMethod(L, pack);
+		RegMetaMethod(L, unpack);
+		RegMetaMethod(L, getMemoryUsage);
+		RegMetaMethod(L, setMemoryWarningHandler);
         lua_setglobal(L,"slua");
     }
 
@@ -101,6 +118,7 @@ namespace NS_SLUA {
 			lua_gc(L, LUA_GCSTOP, 0);
 		}
 		else if (strcmp(flag, "off") == 0) {
+			// running gc task skip stepping after flag turned off
 			state->enableMultiThreadGC = false;
 			lua_gc(L, LUA_GCRESTART, 0);
 		}
@@ -186,16 +204,153 @@ namespace NS_SLUA {
 	int SluaUtil::dumpUObjects(lua_State * L)
 	{
 		auto state = LuaState::get(L);
-		auto& map = state->cacheSet();
+		auto& refs = state->cacheSet();
 		lua_newtable(L);
 		int index = 1;
-		for (auto& it : map) {
-			LuaObject::push(L, getUObjName(it.Key));
+		refs.forEach([&](UObject* obj, GenericUserData*) {
+			LuaObject::push(L, getUObjName(obj));
 			lua_seti(L, -2, index++);
+		});
+		return 1;
+	}
+
+	int SluaUtil::wait(lua_State* L)
+	{
+		lua_Number seconds = luaL_checknumber(L, 1);
+		return LuaState::get(L)->waitSeconds(L, seconds);
+	}
+
+	int SluaUtil::waitFrames(lua_State* L)
+	{
+		lua_Integer frames = luaL_optinteger(L, 1, 1);
+		return LuaState::get(L)->waitFrames(L, (int32)FMath::Clamp<lua_Integer>(frames, 1, MAX_int32));
+	}
+
+	int SluaUtil::waitUntil(lua_State* L)
+	{
+		luaL_checktype(L, 1, LUA_TFUNCTION);
+		// return at once if condition had been satisfied
+		lua_pushvalue(L, 1);
+		lua_call(L, 0, 1);
+		if (lua_toboolean(L, -1))
+			return 0;
+		lua_pop(L, 1);
+		return LuaState::get(L)->waitUntil(L, 1);
+	}
+
+	int SluaUtil::startJob(lua_State* L)
+	{
+		int32 priority = (int32)luaL_optinteger(L, 2, 0);
+		const char* name = luaL_optstring(L, 3, nullptr);
+		int32 id = LuaState::get(L)->jobRunner->start(L, 1, priority, name);
+		lua_pushinteger(L, id);
+		return 1;
+	}
+
+	int SluaUtil::cancelJob(lua_State* L)
+	{
+		int32 id = (int32)luaL_checkinteger(L, 1);
+		lua_pushboolean(L, LuaState::get(L)->jobRunner->cancel(L, id));
+		return 1;
+	}
+
+	int SluaUtil::jobYield(lua_State* L)
+	{
+		// give back frame only if budget used up
+		if (lua_isyieldable(L) && LuaState::get(L)->jobRunner->shouldYield(L))
+			return lua_yield(L, 0);
+		return 0;
+	}
+
+	int SluaUtil::getJobMicroseconds(lua_State* L)
+	{
+		int32 id = (int32)luaL_checkinteger(L, 1);
+		auto job = LuaState::get(L)->jobRunner->find(id);
+		if (!job) return 0;
+		lua_pushnumber(L, FPlatformTime::ToMilliseconds64(job->cycles) * 1000.0);
+		lua_pushinteger(L, job->slices);
+		lua_pushinteger(L, job->frames);
+		return 3;
+	}
+
+	int SluaUtil::getMemoryUsage(lua_State* L)
+	{
+		LuaState* ls = LuaState::get(L);
+		lua_pushinteger(L, (lua_Integer)ls->memUsed);
+		lua_pushinteger(L, (lua_Integer)ls->memSoftLimit);
+		lua_pushinteger(L, (lua_Integer)ls->memHardLimit);
+		return 3;
+	}
+
+	int SluaUtil::setMemoryWarningHandler(lua_State* L)
+	{
+		// handler(used, softLimit) is called after full gc, nil to remove
+		LuaState* ls = LuaState::get(L);
+		if (lua_isnoneornil(L, 1))
+			ls->memoryWarningFunc.free();
+		else {
+			luaL_checktype(L, 1, LUA_TFUNCTION);
+			ls->memoryWarningFunc.set(L, 1);
 		}
+		return 0;
+	}
+
+	int SluaUtil::postWorker(lua_State* L)
+	{
+		// slua.postWorker(module, func, callback, ...), callback(ok, ...) is called on game thread
+		const char* module = luaL_optstring(L, 1, nullptr);
+		const char* func = luaL_checkstring(L, 2);
+		if (!lua_isnoneornil(L, 3))
+			luaL_checktype(L, 3, LUA_TFUNCTION);
+
+		LuaState* ls = LuaState::get(L);
+		int32 id = ls->getWorkerPool()->post(L, module, func, 4);
+		if (!lua_isnoneornil(L, 3)) {
+			lua_pushvalue(L, 3);
+			ls->workerWaits.Add(id, { 0, luaL_ref(L, LUA_REGISTRYINDEX) });
+		}
+		lua_pushinteger(L, id);
+		return 1;
+	}
+
+	int SluaUtil::callWorker(lua_State* L)
+	{
+		// slua.callWorker(module, func, ...) yield coroutine, return ok, ... when worker finished
+		const char* module = luaL_optstring(L, 1, nullptr);
+		const char* func = luaL_checkstring(L, 2);
+
+		LuaState* ls = LuaState::get(L);
+		// check before post, so failed call leaves no worker job
+		ls->checkWait(L);
+		int32 id = ls->getWorkerPool()->post(L, module, func, 3);
+		int threadId = ls->prepareWait(L);
+		ls->workerWaits.Add(id, { threadId, LUA_NOREF });
+		lua_settop(L, 0);
+		return lua_yield(L, 0);
+	}
+
+	int SluaUtil::pack(lua_State* L)
+	{
+		LuaSerializer& s = *LuaState::get(L)->serializer;
+		s.reset();
+		int top = lua_gettop(L);
+		for (int i = 1; i <= top; i++) {
+			if (!s.pack(L, i))
+				luaL_error(L, "can't pack argument %d, %s", i, s.error());
+		}
+		lua_pushlstring(L, (const char*)s.data(), s.size());
 		return 1;
 	}
 
+	int SluaUtil::unpack(lua_State* L)
+	{
+		size_t len;
+		const char* buf = luaL_checklstring(L, 1, &len);
+		int n = LuaSerializer::unpack(L, (const uint8_t*)buf, len, LuaStructCodec::unpack);
+		if (n < 0) return lua_error(L);
+		return n;
+	}
+
 	int SluaUtil::isValid(lua_State * L)
 	{
 		luaL_checktype(L, 1, LUA_TUSERDATA);
@@ -224,16 +379,16 @@ namespace NS_SLUA {
 	void dumpUObjects() {
 		auto state = LuaState::get();
 		CheckState(state);
-		auto& map = state->cacheSet();
-		for (auto& it : map) {
-			Log::Log("Pushed UObject %s", TCHAR_TO_UTF8(*getUObjName(it.Key)));
-		}
+		auto& refs = state->cacheSet();
+		refs.forEach([](UObject* obj, GenericUserData*) {
+			Log::Log("Pushed UObject %s", TCHAR_TO_UTF8(*getUObjName(obj)));
+		});
 	}
 
 	void garbageCollect() {
 		auto state = LuaState::get();
 		CheckState(state);
-		lua_gc(state->getLuaState(), LUA_GCCOLLECT, 0);
+		state->fullGC();
 		Log::Log("Performed full lua gc");
 	}
 
@@ -242,6 +397,21 @@ namespace NS_SLUA {
 		CheckState(state);
 		int kb = lua_gc(state->getLuaState(), LUA_GCCOUNT, 0);
 		Log::Log("Lua use memory %d kb",kb);
+		state->dumpPoolAlloc();
+	}
+
+	void dumpJobs() {
+		auto state = LuaState::get();
+		CheckState(state);
+		state->dumpJobs();
+	}
+
+	void trimMemory() {
+		auto state = LuaState::get();
+		CheckState(state);
+		size_t before = state->getMemoryUsed();
+		state->trimMemory();
+		Log::Log("Lua heap %d KB, %d KB before trim", (int)(state->getMemoryUsed() / 1024), (int)(before / 1024));
 	}
 
 	void doString(const TArray<FString>& Args) {
@@ -269,6 +439,18 @@ namespace NS_SLUA {
 		FConsoleCommandDelegate::CreateStatic(memUsed),
 		ECVF_Cheat);
 
+	static FAutoConsoleCommand CVarJobs(
+		TEXT("slua.Jobs"),
+		TEXT("Print running lua jobs and their time used"),
+		FConsoleCommandDelegate::CreateStatic(dumpJobs),
+		ECVF_Cheat);
+
+	static FAutoConsoleCommand CVarTrimMemory(
+		TEXT("slua.TrimMemory"),
+		TEXT("Release lua caches and collect all garbage"),
+		FConsoleCommandDelegate::CreateStatic(trimMemory),
+		ECVF_Cheat);
+
 	static FAutoConsoleCommand CVarDo(
 		TEXT("slua.Do"),
 		TEXT("Run lua script"),
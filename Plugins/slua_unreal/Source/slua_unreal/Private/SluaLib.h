@@ -38,6 +38,24 @@ namespace NS_SLUA {
 		static int dumpUObjects(lua_State* L);
 		// return whether an userdata is valid?
 		static int isValid(lua_State* L);
+		// yield running coroutine, resumed by LuaState::Tick
+		static int wait(lua_State* L);
+		static int waitFrames(lua_State* L);
+		static int waitUntil(lua_State* L);
+		// time sliced jobs, resumed by LuaState::Tick in frame budget
+		static int startJob(lua_State* L);
+		static int cancelJob(lua_State* L);
+		static int jobYield(lua_State* L);
+		static int getJobMicroseconds(lua_State* L);
+		// call pure lua function on worker state, arguments and results are copied
+		static int postWorker(lua_State* L);
+		static int callWorker(lua_State* L);
+		// pack values into binary string, and unpack it
+		static int pack(lua_State* L);
+		static int unpack(lua_State* L);
+		// heap used by state and its limits, and handler called over soft limit
+		static int getMemoryUsage(lua_State* L);
+		static int setMemoryWarningHandler(lua_State* L);
     };
 
 }
\ No newline at end of file
@@ -31,6 +31,11 @@ protected: \
 		Super::BeginPlay(); \
 		PrimaryActorTick.SetTickFunctionEnable(postInit("bCanEverTick")); \
 	} \
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override { \
+		Super::EndPlay(EndPlayReason); \
+		classOverrides.Reset(); \
+		overrideFuncs.Empty(); \
+	} \
 	virtual void Tick(float DeltaTime) override { \
 		tick(DeltaTime); \
 	} \
@@ -191,6 +196,8 @@ protected:
 		Super::EndPlay(EndPlayReason);
 		if (!GetClass()->HasAnyClassFlags(CLASS_CompiledFromBlueprint))
 			ReceiveEndPlay(EndPlayReason);
+		classOverrides.Reset();
+		overrideFuncs.Empty();
 	}
 	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction) override {
 		tickTmpArgs.deltaTime = DeltaTime;
@@ -200,6 +207,7 @@ protected:
 			superTick();
 			return;
 		}
+		NS_SLUA::LuaScriptEntryScope entry(tickFunction.getState(), NS_SLUA::SE_TICK);
 		tickFunction.call(luaSelfTable, DeltaTime);
 	}
 public:
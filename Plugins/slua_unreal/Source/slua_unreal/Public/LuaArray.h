@@ -21,6 +21,8 @@
 
 namespace NS_SLUA {
 
+    struct GenericUserData;
+
     class SLUA_UNREAL_API LuaArray : public FGCObject {
     public:
         static void reg(lua_State* L);
@@ -90,7 +92,7 @@ namespace NS_SLUA {
         void destructItems(int index,int count);      
 
         static int setupMT(lua_State* L);
-        static int gc(lua_State* L);
+        static void finalize(lua_State* L, GenericUserData* ud);
 
 		struct Enumerator {
 			LuaArray* arr = nullptr;
@@ -25,6 +25,8 @@ namespace NS_SLUA {
 // special tick function
 #define UFUNCTION_TICK ((UFunction*)-1)
 
+	struct LuaFunctionPlan;
+
 	struct LuaSuperOrRpc {
 		class LuaBase* base;
 		LuaSuperOrRpc(class LuaBase* pBase) :base(pBase) {}
@@ -38,6 +40,21 @@ namespace NS_SLUA {
 		LuaRpc(class LuaBase* pBase) :LuaSuperOrRpc(pBase) {}
 	};
 
+	// lua script shared by LuaBase instances with same lua file path,
+	// script is loaded once and cached by LuaState until it's run again by doFile or require.
+	// instance table only holds fields set to self, others are read from table returned by script,
+	// so table fields of it are shared by all instances
+	struct LuaScriptClass {
+		typedef TMap<UFunction*, LuaVar> OverrideMap;
+
+		// table returned by script
+		LuaVar table;
+		// metatable of instance table, search table before cpp instance
+		LuaVar metaTable;
+		// override functions for each blueprint class use this script
+		TMap<TWeakObjectPtr<UClass>, TSharedPtr<OverrideMap>> overrides;
+	};
+
 	class SLUA_UNREAL_API LuaBase {
 	public:
 		enum IndexFlag {
@@ -92,48 +109,24 @@ namespace NS_SLUA {
 			if (stateName.Len() != 0) ls = LuaState::get(stateName);
 			if (!ls) return false;
 
-			luaSelfTable = ls->doFile(TCHAR_TO_UTF8(*luaPath));
-			if (!luaSelfTable.isTable())
-				return false;
-
-			context = ptrT;
-			auto L = ls->getLuaState();
-			// setup __cppinst
-			// we use rawpush to bind objptr and SLUA_CPPINST
-			luaSelfTable.push(L);
-			LuaObject::push(L, ptrT, true);
-			lua_setfield(L, -2, SLUA_CPPINST);
-
-			LuaObject::pushType(L, new LuaSuper(this) , "LuaSuper", supermt, genericGC<LuaSuper>);
-			lua_setfield(L, -2, "Super");
-
-			LuaObject::pushType(L, new LuaRpc(this), "LuaRpc", rpcmt, genericGC<LuaRpc>);
-			lua_setfield(L, -2, "Rpc");
-
-			int top = lua_gettop(L);
-			bindOverrideFunc(ptrT);
-			int newtop = lua_gettop(L);
-
-			// setup metatable
-			if (!metaTable.isValid()) {
-				luaL_newmetatable(L, typeName);
-				lua_pushcfunction(L, __index);
-				lua_setfield(L, -2, "__index");
-				lua_pushcfunction(L, __newindex);
-				lua_setfield(L, -2, "__newindex");
-				metaTable.set(L, -1);
-				lua_pop(L, 1);
-			}
-			metaTable.push(L);
-			lua_setmetatable(L, -2);
-
-			// pop luaSelfTable
-			lua_pop(L, 1);
-			return true;
+			return initInstance(ls, ptrT, typeName, luaPath);
 		}
+
+		// create instance table inherit from script class
+		bool initInstance(LuaState* ls, UObject* obj, const char* typeName, const FString& luaPath);
+		// load script class from luaPath, or get it from cache
+		static LuaScriptClass* getScriptClass(LuaState* ls, const char* typeName, const FString& luaPath);
+		// get field from instance table, if rawget and not found, try to get from class table
+		LuaVar getSelfField(const char* key, bool rawget = true) const;
+		// override set to instance first, then override of script class
+		const LuaVar* findOverrideFunc(UFunction* func) const;
 		
 		static void hookBpScript(UFunction* func, FNativeFuncPtr hookfunc);
-		void bindOverrideFunc(UObject* obj);
+		// find LuaBase of obj by cached offset, return nullptr if obj isn't a LuaBase
+		static LuaBase* getLuaBase(UObject* obj);
+		void bindOverrideFunc(UObject* obj, LuaScriptClass* scriptClass);
+		// called if function field named name of self table changed, return true if name is a blueprint event
+		bool updateOverrideFunc(UClass* cls, const char* name, const LuaVar& lfunc);
 		DECLARE_FUNCTION(luaOverrideFunc);
 
 		static int supermt(lua_State* L);
@@ -150,7 +143,7 @@ namespace NS_SLUA {
 		// should override this function to support super::tick
 		virtual void superTick(lua_State* L);
 		virtual void superTick() = 0;
-		virtual int superOrRpcCall(lua_State* L, UFunction* func);
+		virtual int superOrRpcCall(lua_State* L, const LuaFunctionPlan* plan);
 		static int __index(lua_State* L);
 		static int __newindex(lua_State* L);
 		static int __superIndex(lua_State* L);
@@ -160,9 +153,14 @@ namespace NS_SLUA {
 		static int __rpcCall(lua_State* L);
 
 		LuaVar luaSelfTable;
+		// table of script class, luaSelfTable inherit from it
+		LuaVar classTable;
 		LuaVar tickFunction;
+		// blueprint event -> lua function overrided it, shared by script class
+		TSharedPtr<LuaScriptClass::OverrideMap> classOverrides;
+		// override functions set to instance table
+		LuaScriptClass::OverrideMap overrideFuncs;
 		FWeakObjectPtr context;
-		LuaVar metaTable;
 		IndexFlag indexFlag = IF_NONE;
 		UFunction* currentFunction = nullptr;
 	};
@@ -19,6 +19,7 @@
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "Kismet/KismetSystemLibrary.h"
 #include "LuaVar.h"
+#include "LuaPathHandle.h"
 #include "LuaBlueprintLibrary.generated.h"
 
 USTRUCT(BlueprintType)
@@ -34,6 +35,16 @@ public:
 	static int checkValue(NS_SLUA::lua_State* L, UStructProperty* p, uint8* params, int i);
 };
 
+USTRUCT(BlueprintType)
+struct SLUA_UNREAL_API FLuaBPPathHandle {
+	GENERATED_USTRUCT_BODY()
+public:
+	FLuaBPPathHandle(const NS_SLUA::LuaPathHandle& h) :handle(h) {}
+	FLuaBPPathHandle() {}
+
+	NS_SLUA::LuaPathHandle handle;
+};
+
 UCLASS()
 class SLUA_UNREAL_API ULuaBlueprintLibrary : public UBlueprintFunctionLibrary
 {
@@ -48,6 +59,13 @@ public:
 	UFUNCTION(BlueprintCallable, meta=( DisplayName="Call To Lua", WorldContext = "WorldContextObject"), Category="slua")
 	static FLuaBPVar CallToLua(UObject* WorldContextObject, FString FunctionName,FString StateName);
 
+	/** Parse function path once, call it by Call Lua Path Handle */
+	UFUNCTION(BlueprintCallable, meta=( DisplayName="Make Lua Path Handle", WorldContext = "WorldContextObject"), Category="slua")
+	static FLuaBPPathHandle MakeLuaPathHandle(UObject* WorldContextObject, FString FunctionName, FString StateName);
+
+	UFUNCTION(BlueprintCallable, meta=( DisplayName="Call Lua Path Handle"), Category="slua")
+	static FLuaBPVar CallLuaPathHandle(const FLuaBPPathHandle& Handle, const TArray<FLuaBPVar>& Args);
+
 	UFUNCTION(BlueprintCallable, Category="slua")
 	static FLuaBPVar CreateVarFromInt(int Value);
 
@@ -0,0 +1,65 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+
+namespace NS_SLUA {
+
+	// read-only bundle of lua files, indexed by hash of file name
+	// bundle is mapped to memory once, content returned by find is valid until bundle closed
+	class SLUA_UNREAL_API LuaBundle {
+	public:
+		LuaBundle();
+		~LuaBundle();
+
+		bool open(const FString& path);
+		void close();
+		bool isOpen() const { return base != nullptr; }
+
+		// find file content by name, return nullptr if not found
+		// returned buffer is owned by bundle, don't delete it
+		const uint8* find(const char* fn, uint32& len) const;
+
+		// write files to bundle, file name -> source or bytecode
+		static bool write(const FString& path, const TMap<FString, TArray<uint8>>& files);
+
+	private:
+		struct Header {
+			uint32 magic;
+			uint32 version;
+			uint32 count;
+			uint32 reserved;
+		};
+		struct Entry {
+			uint64 hash;
+			uint32 offset;
+			uint32 len;
+		};
+
+		static uint64 hashOf(const char* fn);
+
+		IMappedFileHandle* handle;
+		IMappedFileRegion* region;
+		// used if platform can't map file
+		TArray<uint8> data;
+		const uint8* base;
+		int64 size;
+		// sorted by hash
+		const Entry* entries;
+		uint32 count;
+	};
+}
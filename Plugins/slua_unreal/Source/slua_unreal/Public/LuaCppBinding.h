@@ -379,10 +379,8 @@ namespace NS_SLUA {
         } \
     
     #define __DefLuaClassTail(CLS) \
-        static int Lua##CLS##_gc(lua_State* L) { \
-            UserData<CLS*>* UD = reinterpret_cast<UserData<CLS*>*>(lua_touserdata(L,1)); \
-            if(UD->flag & UD_AUTOGC) delete UD->ud; \
-            return 0;\
+        static void Lua##CLS##_gc(lua_State* L, GenericUserData* UD) { \
+            if(UD->flag & UD_AUTOGC) delete reinterpret_cast<CLS*>(UD->ud); \
         } \
         static int Lua##CLS##_tostring(lua_State* L) { \
             void* p = lua_touserdata(L,1); \
@@ -96,7 +96,7 @@ namespace NS_SLUA {
 			using T = LuaDelegateWrapT<R, ARGS...>;
 			auto wrapobj = new T(delegate);
  			return LuaObject::pushType<T*>(L, wrapobj,
-				TypeName<T>::value().c_str(), setupMTT<R,ARGS...>, gcT<R,ARGS...>);
+				LuaObject::typeNameOf<T>(), setupMTT<R,ARGS...>, gcT<R,ARGS...>);
 		}
 
 	private:
@@ -21,6 +21,8 @@
 
 namespace NS_SLUA {
 
+	struct GenericUserData;
+
 	template<typename T>
 	struct TPairTraits;
 
@@ -120,7 +122,7 @@ namespace NS_SLUA {
 		bool shouldFree;
 
 		static int setupMT(lua_State* L);
-		static int gc(lua_State* L);
+		static void finalize(lua_State* L, GenericUserData* ud);
 
 		uint8* getKeyPtr(uint8* pairPtr);
 		uint8* getValuePtr(uint8* pairPtr);
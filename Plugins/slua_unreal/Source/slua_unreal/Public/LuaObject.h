@@ -61,6 +61,7 @@ class ULatentDelegate;
 namespace NS_SLUA {
 
     class LuaVar;
+    struct LuaFunctionPlan;
 
     struct AutoStack {
         AutoStack(lua_State* l) {
@@ -78,8 +79,10 @@ namespace NS_SLUA {
         uint8* buf;
         uint32 size;
         UScriptStruct* uss;
+        // buf is owned by parent of view, not freed by LuaStruct
+        bool isView;
 
-        LuaStruct(uint8* buf,uint32 size,UScriptStruct* uss);
+        LuaStruct(uint8* buf,uint32 size,UScriptStruct* uss,bool isView=false);
         ~LuaStruct();
 
 		virtual void AddReferencedObjects(FReferenceCollector& Collector) override;
@@ -103,9 +106,12 @@ namespace NS_SLUA {
 	#define UD_USTRUCT 1<<7 // flag it's an UStruct
 	#define UD_WEAKUPTR 1<<8 // flag it's a weak UObject ptr
 	#define UD_REFERENCE 1<<9
+	#define UD_VIEW 1<<10 // it's a view of memory owned by parent userdata, see LuaObject::pushStructView
 
 	struct UDBase {
 		uint32 flag;
+		// id of type name, see LuaObject::typeIdOf
+		uint32 typeId;
 		void* parent;
 	};
 
@@ -200,7 +206,7 @@ namespace NS_SLUA {
         template<typename T>
         static typename std::enable_if<std::is_base_of<UObject,T>::value && !std::is_same<UObject,T>::value, T*>::type 
 		testudata(lua_State* L,int p, bool checkfree=true) {
-            UserData<UObject*>* ptr = (UserData<UObject*>*)luaL_testudata(L,p,"UObject");
+            UserData<UObject*>* ptr = (UserData<UObject*>*)testudataById(L,p,typeIdOf<UObject>());
 			CHECK_UD_VALID(ptr);
 			T* t = nullptr;
 			// if it's a weak UObject, rawget it
@@ -236,7 +242,7 @@ namespace NS_SLUA {
         template<typename T>
         static typename std::enable_if<std::is_same<UObject,T>::value, T*>::type 
 		testudata(lua_State* L,int p, bool checkfree=true) {
-            auto ptr = (UserData<T*>*)luaL_testudata(L,p,"UObject");
+            auto ptr = (UserData<T*>*)testudataById(L,p,typeIdOf<UObject>());
 			CHECK_UD_VALID(ptr);
 			if (!ptr) return maybeAnUDTable<T>(L, p, checkfree);
 			// if it's a weak UObject ptr
@@ -283,7 +289,7 @@ namespace NS_SLUA {
         template<typename T>
         static typename std::enable_if<!std::is_base_of<UObject,T>::value && !std::is_same<UObject,T>::value, T*>::type 
 		testudata(lua_State* L,int p,bool checkfree=true) {
-            auto ptr = (UserData<T*>*)luaL_testudata(L,p,TypeName<T>::value().c_str());
+            auto ptr = (UserData<T*>*)testudataById(L,p,typeIdOf<T>());
 			CHECK_UD_VALID(ptr);
 			// ptr is boxed shared ptr?
 			if (ptr) {
@@ -310,6 +316,32 @@ namespace NS_SLUA {
 
 		static bool matchType(lua_State* L, int p, const char* tn, bool noprefix=false);
 
+		// integer id of type name, assigned at first use and shared by all states,
+		// it's saved in userdata header, 0 is invalid
+		static uint32 typeIdOf(const char* tn);
+		template<class T>
+		static uint32 typeIdOf() {
+			// TypeName builds a string, resolve it once
+			static const uint32 id = typeIdOf(TypeName<T>::value().c_str());
+			return id;
+		}
+		static const char* typeNameOf(uint32 id);
+		template<class T>
+		static const char* typeNameOf() {
+			return typeNameOf(typeIdOf<T>());
+		}
+		// push metatable of type id, it's cached in registry slot of state,
+		// push nil if type isn't exported
+		static void pushMetatable(lua_State* L, uint32 id);
+		// return userdata at p if its type is id, otherwise nullptr
+		static void* testudataById(lua_State* L, int p, uint32 id);
+		// return type id of binding userdata at p, 0 if it isn't
+		static uint32 typeIdAt(lua_State* L, int p);
+		// record bases of type id, see newTypeWithBase
+		static void setTypeBases(uint32 id, std::initializer_list<const char*> bases);
+		// merge bases into metatable of type id, return false if any base isn't finished
+		static bool flattenType(lua_State* L, uint32 id);
+
 		static int classIndex(lua_State* L);
 		static int classNewindex(lua_State* L);
 
@@ -319,7 +351,18 @@ namespace NS_SLUA {
 		static void addGlobalMethod(lua_State* L, const char* name, lua_CFunction func);
 		static void addField(lua_State* L, const char* name, lua_CFunction getter, lua_CFunction setter, bool isInstance = true);
 		static void addOperator(lua_State* L, const char* name, lua_CFunction func);
+		// flatten members of bases into metatable of tn, and record ancestors of tn
 		static void finishType(lua_State* L, const char* tn, lua_CFunction ctor, lua_CFunction gc, lua_CFunction strHint=nullptr);
+
+		// native finalizer of binding userdata, called in batch after gc step instead of __gc,
+		// it shouldn't call lua api, userdata memory is freed after it returned
+		typedef void (*UDFinalizer)(lua_State* L, GenericUserData* ud);
+		static void finishType(lua_State* L, const char* tn, lua_CFunction ctor, UDFinalizer gc, lua_CFunction strHint=nullptr);
+		// set tag of finalizer as __gc of metatable at top
+		static void setFinalizer(lua_State* L, UDFinalizer gc);
+		// registered to lua vm, dispatch collected userdata to finalizer by tag
+		static void finalizeUD(lua_State* L, int tag, void* ud);
+
 		static void fillParam(lua_State* L, int i, UFunction* func, uint8* params);
 		static int returnValue(lua_State* L, UFunction* func, uint8* params);
 
@@ -364,22 +407,25 @@ namespace NS_SLUA {
             T* ret = testudata<T>(L,p, checkfree);
             if(ret) return ret;
 
-            const char *typearg = nullptr;
-            if (luaL_getmetafield(L, p, "__name") == LUA_TSTRING)
-                typearg = lua_tostring(L, -1);
-                
-            lua_pop(L,1);
-
-            if(checkfree && !typearg)
-                luaL_error(L,"expect userdata at %d, if you passed an UObject, maybe it's unreachable",p);
-
-			if (LuaObject::isBaseTypeOf(L, typearg, TypeName<T>::value().c_str())) {
+			// userdata of derived type, checked by ancestors of its type id
+			uint32 tid = typeIdAt(L, p);
+			if (tid && isBaseTypeOf(tid, typeIdOf<T>())) {
 				UserData<T*> *udptr = reinterpret_cast<UserData<T*>*>(lua_touserdata(L, p));
 				CHECK_UD_VALID(udptr);
 				return udptr->ud;
 			}
-            if(checkfree) 
-				luaL_error(L,"expect userdata %s, but got %s, if you passed an UObject, maybe it's unreachable",TypeName<T>::value().c_str(),typearg);
+
+            if(!checkfree) return nullptr;
+
+            const char *typearg = typeNameOf(tid);
+            if (!typearg && luaL_getmetafield(L, p, "__name") != LUA_TNIL) {
+                typearg = lua_tostring(L, -1);
+                lua_pop(L,1);
+            }
+
+            if(!typearg)
+                luaL_error(L,"expect userdata at %d, if you passed an UObject, maybe it's unreachable",p);
+			luaL_error(L,"expect userdata %s, but got %s, if you passed an UObject, maybe it's unreachable",typeNameOf<T>(),typearg);
             return nullptr;
         }
 
@@ -402,10 +448,10 @@ namespace NS_SLUA {
 				UserData<LuaStruct*> *structptr = reinterpret_cast<UserData<LuaStruct*>*>(udptr);
 				LuaStruct* ls = structptr->ud;
 				// skip first prefix like 'F','U','A'
-				if (sizeof(typename std::remove_pointer<T>::type) == ls->size && strcmp(TypeName<T>::value().c_str()+1, TCHAR_TO_UTF8(*ls->uss->GetName())) == 0)
+				if (sizeof(typename std::remove_pointer<T>::type) == ls->size && strcmp(typeNameOf<T>()+1, TCHAR_TO_UTF8(*ls->uss->GetName())) == 0)
 					return (T)(ls->buf);
 				else
-					luaL_error(L, "checkValue error, type dismatched, expect %s", TypeName<T>::value().c_str());
+					luaL_error(L, "checkValue error, type dismatched, expect %s", typeNameOf<T>());
 			}
 			return udptr->ud;
 		}
@@ -421,10 +467,10 @@ namespace NS_SLUA {
 				UserData<LuaStruct*> *structptr = reinterpret_cast<UserData<LuaStruct*>*>(udptr);
 				LuaStruct* ls = structptr->ud;
 				// skip first prefix like 'F','U','A'
-				if (sizeof(T) == ls->size && strcmp(TypeName<T>::value().c_str() + 1, TCHAR_TO_UTF8(*ls->uss->GetName())) == 0)
+				if (sizeof(T) == ls->size && strcmp(typeNameOf<T>() + 1, TCHAR_TO_UTF8(*ls->uss->GetName())) == 0)
 					return *((T*)(ls->buf));
 				else
-					luaL_error(L, "checkValue error, type dismatched, expect %s", TypeName<T>::value().c_str());
+					luaL_error(L, "checkValue error, type dismatched, expect %s", typeNameOf<T>());
 			}
 			return *(udptr->ud);
 		}
@@ -500,27 +546,33 @@ namespace NS_SLUA {
 				uint8* buf = (uint8*)FMemory::Malloc(size);
 				uss->InitializeStruct(buf);
 				uss->CopyScriptStruct(buf, v);
-				cacheObj(L, void_cast(v));
 				return push(L, new LuaStruct(buf, size, uss));
 			}
 			NewUD(T, v, flag);
+			udptr->typeId = typeIdOf(fn);
 			lua_pushvalue(L, -2);
 			lua_setmetatable(L, -2);
 			lua_remove(L, -2); // remove metatable of fn
-            cacheObj(L,void_cast(v));
+            cacheObj(L,void_cast(v),fn);
             return 1;
 		}
 
 		static void releaseLink(lua_State* L, void* prop);
 		static void linkProp(lua_State* L, void* parent, void* prop);
+		// flag props linked to parent and props linked to them freed, called if memory of parent is freed or moved
+		static void unlinkProps(lua_State* L, void* parent);
+		// push struct at parms as view of memory owned by userdata at parent, write to view changes parent,
+		// push a copy if struct view of state is disabled, or struct is wrapped
+		static int pushStructView(lua_State* L, UStructProperty* prop, uint8* parms, int parent);
 
 		template<class T>
 		static int pushAndLink(lua_State* L, const void* parent, const char* tn, const T* v) {
 			if (getFromCache(L, void_cast(v), tn)) return 1;
 			NewUD(T, v, UD_NOFLAG);
+			udptr->typeId = typeIdOf(tn);
 			luaL_getmetatable(L, tn);
 			lua_setmetatable(L, -2);
-			cacheObj(L, void_cast(v));
+			cacheObj(L, void_cast(v), tn);
 			linkProp(L, void_cast(parent), void_cast(udptr));
 			return 1;
 		}
@@ -537,40 +589,30 @@ namespace NS_SLUA {
 			ud->parent = nullptr;
             ud->ud = cls;
             ud->flag = gc!=nullptr?UD_AUTOGC:UD_NOFLAG;
+			ud->typeId = typeIdOf(tn);
 			if (F) ud->flag |= UD_UOBJECT;
             setupMetaTable(L,tn,setupmt,gc);
             return 1;
         }
 
-		// for weak UObject
-
-		static int gcWeakUObject(lua_State* L) {
-			luaL_checktype(L, 1, LUA_TUSERDATA);
-			UserData<WeakUObjectUD*>* ud = reinterpret_cast<UserData<WeakUObjectUD*>*>(lua_touserdata(L, 1));
-			ensure(ud->flag&UD_WEAKUPTR);
-			ud->flag |= UD_HADFREE;
-			SafeDelete(ud->ud);
-			return 0;
-		}
+		// for weak UObject, it shares metatable and finalizer with UObject
 
 		static int pushWeakType(lua_State* L, WeakUObjectUD* cls) {
 			UserData<WeakUObjectUD*>* ud = reinterpret_cast<UserData<WeakUObjectUD*>*>(lua_newuserdata(L, sizeof(UserData<WeakUObjectUD*>)));
 			ud->parent = nullptr;
 			ud->ud = cls;
 			ud->flag = UD_WEAKUPTR | UD_AUTOGC;
-			setupMetaTable(L, "UObject", setupInstanceMT, gcWeakUObject);
+			ud->typeId = typeIdOf<UObject>();
+			setupMetaTable(L, "UObject", setupInstanceMT, finalizeObject);
 			return 1;
 		}
 
 		// for TSharePtr version
 
 		template<class T, ESPMode mode>
-		static int gcSharedUD(lua_State* L) {
-			luaL_checktype(L, 1, LUA_TUSERDATA);
-			UserData<T*>* ud = reinterpret_cast<UserData<T*>*>(lua_touserdata(L, 1));
+		static void finalizeSharedUD(lua_State* L, GenericUserData* ud) {
 			ud->flag |= UD_HADFREE;
-			SafeDelete(ud->ud);
-			return 0;
+			delete reinterpret_cast<T*>(ud->ud);
 		}
 
 		template<class BOXPUD, ESPMode mode, bool F>
@@ -579,9 +621,10 @@ namespace NS_SLUA {
 			ud->parent = nullptr;
 			ud->ud = cls;
 			ud->flag = UD_AUTOGC | flag;
+			ud->typeId = typeIdOf(tn);
 			if (F) ud->flag |= UD_UOBJECT;
 			if (mode == ESPMode::ThreadSafe) ud->flag |= UD_THREADSAFEPTR;
-			setupMetaTable(L, tn, gcSharedUD<BOXPUD, mode>);
+			setupMetaTable(L, tn, finalizeSharedUD<BOXPUD, mode>);
 			return 1;
 		}
 
@@ -609,15 +652,12 @@ namespace NS_SLUA {
         static void removeRef(lua_State* L,UObject* obj);
 
         template<typename T>
-        static int pushGCObject(lua_State* L,T obj,const char* tn,lua_CFunction setupmt,lua_CFunction gc,bool ref) {
+        static int pushGCObject(lua_State* L,T obj,const char* tn,lua_CFunction setupmt,UDFinalizer gc,bool ref) {
             if(getFromCache(L,obj,tn)) return 1;
-            lua_pushcclosure(L,gc,0);
-            int f = lua_gettop(L);
-            int r = pushType<T>(L,obj,tn,setupmt,f);
-            lua_remove(L,f); // remove wraped gc function
+            int r = pushType<T>(L,obj,tn,setupmt,gc);
 			if (r) {
 				addRef(L, obj, lua_touserdata(L, -1), ref);
-				cacheObj(L, obj);
+				cacheObj(L, obj, tn);
 			}
             return r;
         }
@@ -626,7 +666,7 @@ namespace NS_SLUA {
         static int pushObject(lua_State* L,T obj,const char* tn,lua_CFunction setupmt=nullptr) {
             if(getFromCache(L,obj,tn)) return 1;
             int r = pushType<T>(L,obj,tn,setupmt,nullptr);
-            if(r) cacheObj(L,obj);
+            if(r) cacheObj(L,obj,tn);
             return r;
         }
 
@@ -666,17 +706,19 @@ namespace NS_SLUA {
 
         // check tn is base of base
         static bool isBaseTypeOf(lua_State* L,const char* tn,const char* base);
+		// check base is an ancestor of type id, it's valid after type finished
+		static bool isBaseTypeOf(uint32 id, uint32 base);
 
         template<typename T>
         static int push(lua_State* L,T* ptr,typename std::enable_if<!std::is_base_of<UObject,T>::value && !Has_LUA_typename<T>::value>::type* = nullptr) {
-            return push(L, TypeName<T>::value().c_str(), ptr);
+            return push(L, typeNameOf<T>(), ptr);
         }
 
 		// it's an override for non-uobject, non-ptr, only accept struct or class value
 		template<typename T>
 		static int push(lua_State* L, const T& v, typename std::enable_if<!std::is_base_of<UObject, T>::value && std::is_class<T>::value>::type* = nullptr) {
 			T* newPtr = new T(v);
-			return push<T>(L, TypeName<T>::value().c_str(), newPtr, UD_AUTOGC);
+			return push<T>(L, typeNameOf<T>(), newPtr, UD_AUTOGC);
 		}
 
 		// if T has a member function named LUA_typename,
@@ -693,7 +735,7 @@ namespace NS_SLUA {
 
 		template<typename T>
 		static int push(lua_State* L, LuaOwnedPtr<T> ptr, typename std::enable_if<!std::is_base_of<UObject, T>::value && !Has_LUA_typename<T>::value>::type* = nullptr) {
-			return push(L, TypeName<T>::value().c_str(), ptr.ptr, UD_AUTOGC);
+			return push(L, typeNameOf<T>(), ptr.ptr, UD_AUTOGC);
 		}
 
 		static int gcSharedPtr(lua_State *L) {
@@ -705,10 +747,10 @@ namespace NS_SLUA {
 			// get raw ptr from sharedptr
 			T* rawptr = ptr.Get();
 			// get typename 
-			auto tn = TypeName<T>::value();
-			if (getFromCache(L, rawptr, tn.c_str())) return 1;
-			int r = pushType<T>(L, new SharedPtrUD<T, mode>(ptr), tn.c_str());
-			if (r) cacheObj(L, rawptr);
+			auto tn = typeNameOf<T>();
+			if (getFromCache(L, rawptr, tn)) return 1;
+			int r = pushType<T>(L, new SharedPtrUD<T, mode>(ptr), tn);
+			if (r) cacheObj(L, rawptr, tn);
 			return r;
 		}
 
@@ -717,10 +759,10 @@ namespace NS_SLUA {
 			// get raw ptr from sharedptr
 			T& rawref = ref.Get();
 			// get typename 
-			auto tn = TypeName<T>::value();
-			if (getFromCache(L, &rawref, tn.c_str())) return 1;
-			int r = pushType<T>(L, new SharedRefUD<T, mode>(ref), tn.c_str());
-			if (r) cacheObj(L, &rawref);
+			auto tn = typeNameOf<T>();
+			if (getFromCache(L, &rawref, tn)) return 1;
+			int r = pushType<T>(L, new SharedRefUD<T, mode>(ref), tn);
+			if (r) cacheObj(L, &rawref, tn);
 			return r;
 		}
 
@@ -754,35 +796,24 @@ namespace NS_SLUA {
 		static void addExtensionMethod(UClass* cls, const char* n, lua_CFunction func, bool isStatic = false);
 		static void addExtensionProperty(UClass* cls, const char* n, lua_CFunction getter, lua_CFunction setter, bool isStatic = false);
 
-        static UFunction* findCacheFunction(lua_State* L,UClass* cls,const char* fname);
-        static void cacheFunction(lua_State* L, UClass* cls,const char* fame,UFunction* func);
-
         static UProperty* findCacheProperty(lua_State* L, UClass* cls, const char* pname);
         static void cacheProperty(lua_State* L, UClass* cls, const char* pname, UProperty* property);
+        // push cached members table of cls, see LuaState::ClassCache::pushMembers
+        static void pushCacheMembers(lua_State* L, UClass* cls, bool isStatic);
+        // get call plan of func cached by LuaState
+        static const LuaFunctionPlan* findCachePlan(lua_State* L, UFunction* func);
 
         static bool getFromCache(lua_State* L, void* obj, const char* tn, bool check = true);
+		// cache userdata at top of stack as pushed obj of type tn
+		static void cacheObj(lua_State* L, void* obj, const char* tn);
 		static void cacheObj(lua_State* L, void* obj);
 		static void removeFromCache(lua_State* L, void* obj);
 		static ULatentDelegate* getLatentDelegate(lua_State* L);
 		static void deleteFGCObject(lua_State* L,FGCObject* obj);
-    private:
-        static int setupClassMT(lua_State* L);
-        static int setupInstanceMT(lua_State* L);
-        static int setupInstanceStructMT(lua_State* L);
-        static int setupStructMT(lua_State* L);
-
-        static int gcObject(lua_State* L);
-        static int gcClass(lua_State* L);
-        static int gcStructClass(lua_State* L);
-		static int gcStruct(lua_State* L);
-        static int objectToString(lua_State* L);
-        static void setupMetaTable(lua_State* L,const char* tn,lua_CFunction setupmt,lua_CFunction gc);
-		static void setupMetaTable(lua_State* L, const char* tn, lua_CFunction setupmt, int gc);
-		static void setupMetaTable(lua_State* L, const char* tn, lua_CFunction gc);
-		static void callRpc(lua_State* L, UObject* obj, UFunction* func, uint8* params);
 
+        // push cls with native finalizer gc, see finishType
         template<class T, bool F = IsUObject<T>::value>
-        static int pushType(lua_State* L,T cls,const char* tn,lua_CFunction setupmt,int gc) {
+        static int pushType(lua_State* L,T cls,const char* tn,lua_CFunction setupmt,UDFinalizer gc) {
             if(!cls) {
                 lua_pushnil(L);
                 return 1;
@@ -792,10 +823,26 @@ namespace NS_SLUA {
 			ud->parent = nullptr;
             ud->ud = cls;
             ud->flag = F|UD_AUTOGC;
+			ud->typeId = typeIdOf(tn);
 			if (F) ud->flag |= UD_UOBJECT;
             setupMetaTable(L,tn,setupmt,gc);
             return 1;
         }
+    private:
+        static int setupClassMT(lua_State* L);
+        static int setupInstanceMT(lua_State* L);
+        static int setupInstanceStructMT(lua_State* L);
+        static int setupStructMT(lua_State* L);
+
+        // UObject, UClass and UScriptStruct, or weak UObject
+        static void finalizeObject(lua_State* L, GenericUserData* ud);
+		static void finalizeStruct(lua_State* L, GenericUserData* ud);
+        static int objectToString(lua_State* L);
+        static void setupMetaTable(lua_State* L,const char* tn,lua_CFunction setupmt,lua_CFunction gc);
+		static void setupMetaTable(lua_State* L, const char* tn, lua_CFunction setupmt, UDFinalizer gc);
+		static void setupMetaTable(lua_State* L, const char* tn, UDFinalizer gc);
+		static void callRpc(lua_State* L, UObject* obj, UFunction* func, uint8* params);
+
 		static void createTable(lua_State* L, const char* tn);
     };
 
@@ -910,7 +957,7 @@ namespace NS_SLUA {
 
 	template<>
 	inline int LuaObject::pushType<LuaStruct*, false>(lua_State* L, LuaStruct* cls,
-		const char* tn, lua_CFunction setupmt, lua_CFunction gc) {
+		const char* tn, lua_CFunction setupmt, UDFinalizer gc) {
 		if (!cls) {
 			lua_pushnil(L);
 			return 1;
@@ -920,6 +967,7 @@ namespace NS_SLUA {
 		ud->ud = cls;
 		ud->flag = gc != nullptr ? UD_AUTOGC : UD_NOFLAG;
 		ud->flag |= UD_USTRUCT;
+		ud->typeId = typeIdOf(tn);
 		setupMetaTable(L, tn, setupmt, gc);
 		return 1;
 	}
@@ -0,0 +1,73 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+
+#pragma once
+#include "CoreMinimal.h"
+#include "UObject/UObjectArray.h"
+#include "UObject/GCObject.h"
+
+namespace NS_SLUA {
+
+	struct GenericUserData;
+
+	// UObjects pushed to lua, keyed by index in GUObjectArray.
+	// entries are in dense slots reused by a free list, so referenced objects are handed to gc in one call,
+	// and a bit per object index rejects deleted objects never pushed to lua without hashing
+	class SLUA_UNREAL_API LuaObjectRefs {
+	public:
+		static int32 indexOf(const UObjectBase* obj) {
+			return GUObjectArray.ObjectToIndex(obj);
+		}
+
+		bool mayContain(int32 index) const {
+			uint32 word = (uint32)index >> 5;
+			return index >= 0 && word < (uint32)filter.Num() && (filter[word] & (1u << (index & 31)));
+		}
+		// ud of object at index, nullptr if object isn't pushed, ud itself may be nullptr
+		GenericUserData** find(int32 index);
+		// add or replace ud of obj, obj is referenced until removed if ref is true
+		void add(UObject* obj, int32 index, GenericUserData* ud, bool ref);
+		void remove(int32 index);
+		void empty();
+		int32 num() const { return slots.Num(); }
+
+		// report referenced objects to engine gc
+		void addReferencedObjects(FReferenceCollector& collector);
+
+		// call f(UObject*, GenericUserData*) for each entry
+		template<typename F>
+		void forEach(F&& f) const {
+			for (const Entry& e : entries) {
+				if (e.index != INDEX_NONE) f(e.obj, e.ud);
+			}
+		}
+
+	private:
+		struct Entry {
+			UObject* obj;
+			GenericUserData* ud;
+			// INDEX_NONE if slot is free
+			int32 index;
+		};
+
+		TArray<Entry> entries;
+		// slot -> obj if it's referenced, otherwise nullptr, same size as entries
+		TArray<UObject*> referenced;
+		TArray<int32> freeSlots;
+		// object index -> slot
+		TMap<int32, int32> slots;
+		// bit of object index, set if it's in slots
+		TArray<uint32> filter;
+	};
+}
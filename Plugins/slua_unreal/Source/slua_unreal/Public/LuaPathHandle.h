@@ -0,0 +1,60 @@
+// Tencent is pleased to support the open source community by making sluaunreal available.
+
+// Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+// Licensed under the BSD 3-Clause License (the "License"); 
+// you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+// https://opensource.org/licenses/BSD-3-Clause
+
+// Unless required by applicable law or agreed to in writing, 
+// software distributed under the License is distributed on an "AS IS" BASIS, 
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. 
+// See the License for the specific language governing permissions and limitations under the License.
+
+#pragma once
+#include "CoreMinimal.h"
+#include "LuaVar.h"
+
+namespace NS_SLUA {
+
+	// dotted global path like "Module.Sub.func" parsed once,
+	// keys are interned lua strings and resolved tables are cached,
+	// cache is checked by raw compare each level and resolved again if any field reassigned,
+	// path through __index isn't cached and resolved by every get
+	class SLUA_UNREAL_API LuaPathHandle {
+	public:
+		LuaPathHandle();
+		LuaPathHandle(lua_State* L, const char* path);
+
+		// path resolved to non-nil value and no field on path reassigned
+		bool isValid() const;
+		// get value at path, same as LuaState::get
+		LuaVar get() const;
+		// set value at path, create sub tables like LuaState::set
+		bool set(const LuaVar& v);
+		const FString& getPath() const { return path; }
+
+		template<class ...ARGS>
+		LuaVar call(ARGS&& ...args) const {
+			LuaVar f = get();
+			if (!f.isFunction()) {
+				Log::Error("Can't find lua function named %s to call", TCHAR_TO_UTF8(*path));
+				return LuaVar();
+			}
+			return f.call(std::forward<ARGS>(args)...);
+		}
+
+	private:
+		FString path;
+		int32 depth;
+		// table in registry, keys at [1, depth], value of each level at [depth+1, depth*2]
+		LuaVar cache;
+		// resolved value at last level, updated by get
+		mutable LuaVar target;
+		// some level got by __index, raw compare can't check it
+		mutable bool uncached;
+
+		bool checkCache(lua_State* L) const;
+		void resolve(lua_State* L) const;
+	};
+}
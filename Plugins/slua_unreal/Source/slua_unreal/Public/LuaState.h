@@ -16,10 +16,13 @@
 #include "CoreMinimal.h"
 #include "Components/SceneComponent.h"
 #include "LuaVar.h"
+#include "LuaPathHandle.h"
+#include "LuaObjectRefs.h"
 #include <string>
 #include <memory>
 #include <atomic>
 #include "HAL/Runnable.h"
+#include "Async/TaskGraphInterfaces.h"
 #include "Tickable.h"
 
 #define SLUA_LUACODE "[sluacode]"
@@ -31,43 +34,68 @@ class ULatentDelegate;
 
 namespace NS_SLUA {
 
-	struct ScriptTimeoutEvent {
-		virtual void onTimeout() = 0;
+	struct LuaFunctionPlan;
+	struct LuaScriptClass;
+	class LuaChunkCache;
+	class LuaPreloader;
+	class LuaGCScheduler;
+	class LuaPoolAlloc;
+	class LuaTimerWheel;
+	class LuaJobRunner;
+	class LuaWorkerPool;
+	class LuaSerializer;
+	class LuaObjectCache;
+	struct ScriptWatch;
+
+	// where script call come from, each entry has its own time budget
+	enum ScriptEntry {
+		SE_CALL,
+		SE_TICK,
+		SE_EVENT,
+		SE_DELEGATE,
+		SE_NUM,
 	};
 
-	class FDeadLoopCheck : public FRunnable
-	{
-	public:
-		FDeadLoopCheck();
-		~FDeadLoopCheck();
+	// script call exceed time budget of its entry
+	struct SlowScriptEvent {
+		ScriptEntry entry;
+		double ms;
+		// lua stack when call exceed budget
+		FString traceback;
+	};
 
-		int scriptEnter(ScriptTimeoutEvent* pEvent);
-		int scriptLeave();
+	DECLARE_MULTICAST_DELEGATE_OneParam(FLuaSlowScriptEvent, const SlowScriptEvent&);
+	// lua heap exceed soft limit, params are heap bytes after full gc and soft limit
+	DECLARE_MULTICAST_DELEGATE_TwoParams(FLuaMemoryWarningEvent, uint64, uint64);
 
-	protected:
-		uint32 Run() override;
-		void Stop() override;
-		void onScriptTimeout();
+	// watch lua script call, report slow script and abort dead loop
+	class LuaScriptCallGuard {
+	public:
+		LuaScriptCallGuard(lua_State* L);
+		~LuaScriptCallGuard();
 	private:
-		std::atomic<ScriptTimeoutEvent*> timeoutEvent;
-		FThreadSafeCounter timeoutCounter;
-		FThreadSafeCounter stopCounter;
-		FThreadSafeCounter frameCounter;
-		FRunnableThread* thread;
+		lua_State* L;
 	};
 
-	// check lua script dead loop
-	class LuaScriptCallGuard : public ScriptTimeoutEvent {
+	// mark script calls in scope come from entry
+	class SLUA_UNREAL_API LuaScriptEntryScope {
 	public:
-		LuaScriptCallGuard(lua_State* L);
-		virtual ~LuaScriptCallGuard();
-		void onTimeout() override;
+		LuaScriptEntryScope(lua_State* L, ScriptEntry entry);
+		~LuaScriptEntryScope();
 	private:
-		lua_State* L;
-		static void scriptTimeout(lua_State *L, lua_Debug *ar);
+		class LuaState* ls;
+		ScriptEntry old;
 	};
 
-	typedef TMap<UObject*, GenericUserData*> UObjectRefMap;
+	// lock lua state if background gc enabled,
+	// hold it before calling into lua from engine
+	class SLUA_UNREAL_API LuaStateLock {
+	public:
+		LuaStateLock(lua_State* L);
+		~LuaStateLock();
+	private:
+		FCriticalSection* cs;
+	};
 
     class SLUA_UNREAL_API LuaState 
 		: public FUObjectArray::FUObjectDeleteListener
@@ -85,6 +113,12 @@ namespace NS_SLUA {
          * you must delete[] buf returned by function for free memory.
          */
 		typedef uint8* (*LoadFileDelegate) (const char* fn, uint32& len, FString& filepath);
+		/*
+		 * same as LoadFileDelegate, but returned buf is owned by delegate and won't be deleted,
+		 * it must be valid until LuaState closed, e.g. memory of a mapped LuaBundle.
+		 * if return nullptr, LoadFileDelegate will be tried.
+		 */
+		typedef const uint8* (*LoadFileViewDelegate) (const char* fn, uint32& len, FString& filepath);
 		typedef void (*ErrorDelegate) (const char* err);
 
         inline static LuaState* get(lua_State* l=nullptr) {
@@ -111,6 +145,20 @@ namespace NS_SLUA {
         
         // init lua state
         virtual bool init(bool enableMultiThreadGC=false);
+		// use small object pool allocator for lua vm, call it before init
+		// off by default, lua_alloc_bench doesn't show it faster than the default allocator,
+		// only enable it if your workload is measured faster with it
+		void setUsePoolAlloc(bool use) { usePoolAlloc = use; }
+		// log memory used by pool allocator
+		void dumpPoolAlloc() const;
+
+		// report script call from entry exceed ms, 0 to disable, negative to use cvar slua.ScriptBudgetMs
+		// budget and timeout should be set after init
+		void setScriptBudget(ScriptEntry entry, int32 ms);
+		// abort script call exceed ms, 0 to disable, default is 5000
+		void setScriptTimeout(int32 ms);
+		// recent slow script events
+		const TArray<SlowScriptEvent>& getSlowScripts() const { return slowScripts; }
 		// attach this luaState to UGameInstance
 		// this function just store UGameInstance pointer for search future
 		void attach(UGameInstance* pGI);
@@ -140,11 +188,37 @@ namespace NS_SLUA {
         LuaVar get(const char* key);
 		// set field to _G, support "x.x.x.x" to create sub table recursive
 		bool set(const char* key, LuaVar v);
+		// path handle cached by state, parse path once for frequent get or call,
+		// shared with the cache, so it's still valid after cache is cleared
+		TSharedPtr<LuaPathHandle> getPathHandle(const FString& path);
 
         // set load delegation function to load lua code
 		void setLoadFileDelegate(LoadFileDelegate func);
+		// set load delegation function to load lua code without copy
+		void setLoadFileViewDelegate(LoadFileViewDelegate func);
 		// set error delegation function to handle error
 		void setErrorDelegate(ErrorDelegate func);
+		// save compiled bytecode of lua file to dir, reuse it if source not changed
+		// strip debug info of bytecode if strip is true
+		void setChunkCacheDir(const FString& dir, bool strip = false);
+
+		// read and compile modules on thread pool, they are loaded when required
+		// load delegate must be thread safe to preload modules
+		// dependencies in module manifest are preloaded too
+		// return count of modules start preloading
+		int32 preloadModules(const TArray<FString>& modules);
+		// count of modules still preloading
+		int32 pendingPreloads() const;
+		// set dependencies of modules, module name -> modules required by it
+		// manifest is reset by setLoadFileDelegate
+		void setModuleManifest(const TMap<FString, TArray<FString>>& deps);
+		// load manifest from lua file, which return table like { mod = { "dep1", "dep2" } }
+		bool loadModuleManifest(const char* fn);
+
+		// start headless worker states for slua.postWorker and slua.callWorker,
+		// load delegate must be thread safe, modules are required by each worker,
+		// num <= 0 to use cvar slua.WorkerCount, default workers are started on first post
+		void initWorkers(int32 num, const TArray<FString>& modules);
 
 		lua_State* getLuaState() const
 		{
@@ -160,16 +234,46 @@ namespace NS_SLUA {
 		// create named table, support "x.x.x.x", put table to _G
 		LuaVar createTable(const char* key);
 
-		const UObjectRefMap& cacheSet() const {
-			return objRefs;
+		// UObjects pushed to lua, iterate by forEach
+		const LuaObjectRefs& cacheSet() const {
+			return *objRefs;
 		}
         
 		void setTickFunction(LuaVar func);
 
+		// lua gc time budget per frame in microseconds, negative to use cvar slua.GCBudgetUs
+		void setGCBudget(int32 us);
+		// percent of memory allocated since last frame to collect, negative to use cvar slua.GCPacing
+		void setGCPacing(int32 percent);
+		// on idle frames or loading screen, gc step until cycle finished in slua.GCIdleBudgetUs
+		void setGCIdle(bool idle);
+		// collect all garbage now
+		void fullGC();
+
+		// time budget of lua jobs per frame in microseconds, negative to use cvar slua.JobBudgetUs
+		void setJobBudget(int32 us);
+		// log running jobs and their time used
+		void dumpJobs() const;
+
+		// bytes of lua heap allocated by this state
+		size_t getMemoryUsed() const { return memUsed; }
+		// heap exceed soft limit run full gc on next tick and broadcast onMemoryWarning,
+		// allocation exceed hard limit fails and raise memory error in lua,
+		// limits in bytes, 0 to disable, negative to use cvar slua.MemorySoftLimitMB and slua.MemoryHardLimitMB
+		void setMemoryLimit(int64 soft, int64 hard);
+		// release cached chunks and path handles, then collect all garbage
+		void trimMemory();
+		// read struct property of UObject, struct or container element as view instead of copy,
+		// view is freed with its parent or by changing the container in lua,
+		// don't keep it if the container may be changed by native code
+		void setStructView(bool enable) { structView = enable; }
+		bool isStructView() const { return structView; }
+
 		// add obj to ref, tell Engine don't collect this obj
 		void addRef(UObject* obj,void* ud,bool ref);
-		// unlink UObject, flag Object had been free, and remove from cache and objRefs
-		void unlinkUObject(const UObject * Object);
+		// unlink UObject, flag Object had been free, and remove from cache and objRefs,
+		// index is index of Object in GUObjectArray, INDEX_NONE to look it up
+		void unlinkUObject(const UObject * Object, int32 Index = INDEX_NONE);
 
 		// if obj be deleted, call this function
 		virtual void NotifyUObjectDeleted(const class UObjectBase *Object, int32 Index) override;
@@ -188,42 +292,91 @@ namespace NS_SLUA {
 		virtual bool IsTickable() const override { return true; }
 #endif
 
+		// coroutine waiting latent action is hold by slot,
+		// return slot id passed to latent callback
 		int addThread(lua_State *thread);
-		void resumeThread(int threadRef);
+		// nargs values had been pushed to the coroutine, passed to resume
+		void resumeThread(int threadRef, int nargs = 0);
 		int findThread(lua_State *thread);
+		// release slot of coroutine, e.g. coroutine finished
+		void releaseThread(lua_State *thread);
 		void cleanupThreads();
+		// yield thread and resume it from Tick after seconds, frames,
+		// or once function at fn returns true
+		int waitSeconds(lua_State *thread, double seconds);
+		int waitFrames(lua_State *thread, int32 frames);
+		int waitUntil(lua_State *thread, int fn);
 		ULatentDelegate* getLatentDelegate() const;
 
 		// call this function on script error
 		void onError(const char* err);
     protected:
 		LoadFileDelegate loadFileDelegate;
+		LoadFileViewDelegate loadFileViewDelegate;
 		ErrorDelegate errorDelegate;
         uint8* loadFile(const char* fn,uint32& len,FString& filepath);
+		const uint8* loadFileView(const char* fn, uint32& len, FString& filepath);
+		// load file by delegates and push function or error message
+		// found is false if no delegate can load fn
+		bool loadModule(const char* fn, bool& found);
+		// compile buf or get it from chunk cache, push function or error message
+		bool loadChunk(const uint8* buf, uint32 len, const FString& filepath);
+		// load module compiled by preloader, push function or error message
+		bool loadPreloaded(const char* fn, bool& found);
+		LuaPreloader* getPreloader();
 		static int loader(lua_State* L);
 		static int getStringFromMD5(lua_State* L);
 
 	public:
 		FLuaStateInitEvent onInitEvent;
+		// script call exceed its budget, broadcast on thread calling script
+		FLuaSlowScriptEvent onSlowScript;
+		// heap exceed soft limit, broadcast from Tick after full gc
+		FLuaMemoryWarningEvent onMemoryWarning;
 
     private:
         friend class LuaObject;
+        friend class LuaVar;
+        friend class LuaBase;
         friend class SluaUtil;
 		friend struct LuaEnums;
 		friend class LuaScriptCallGuard;
+		friend class LuaScriptEntryScope;
+		friend class LuaWatchdog;
+		friend class LuaStateLock;
+		friend class LuaMemoryProfile;
         lua_State* L;
+        // pushed objects -> userdata, entry removed when userdata finalized
+        LuaObjectCache* objCache;
+        // weak table for userdata can't be tracked by objCache, e.g. with lua __gc
         int cacheObjRef;
+        bool weakCacheUsed;
 		// init enums lua code
         int _pushErrorHandler(lua_State* L);
         static int _atPanic(lua_State* L);
 		void linkProp(void* parent, void* prop);
 		void releaseLink(void* prop);
+		void unlinkProps(void* parent);
 		void releaseAllLink();
 		// unreal gc will call this funciton
 		void onEngineGC();
 		// on world cleanup
 		void onWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
 		void freeDeferObject();
+		void freeScriptClasses();
+		// script of fn is run again, instances created later load new class
+		void freeScriptClass(const char* fn);
+		// step gc on background thread
+		void startBackgroundGC();
+		void waitBackgroundGC();
+		// called on entry of lua api while background gc step is pending
+		static void apiSync(lua_State* L);
+		// gc cycle finished, release empty slabs of pool allocator
+		void onGCCycleFinished();
+		// call native finalizer of binding userdata and __gc deferred by background gc
+		void finalizeUserdata();
+		// record slow script event
+		void onScriptSlow(ScriptEntry entry, double ms, const FString& traceback);
 
 
 		TMap<void*, TArray<void*>> propLinks;
@@ -231,33 +384,77 @@ namespace NS_SLUA {
         int si;
         FString stateName;
 
-		// cache ufunction/uproperty ptr if index by lua
+		// cache uproperty ptr, members and call plans if index by lua
 		struct ClassCache {
-			typedef TMap<FString, TWeakObjectPtr<UFunction>> CacheFuncItem;
-			typedef TMap<TWeakObjectPtr<UClass>, CacheFuncItem> CacheFuncMap;
-
 			typedef TMap<FString, TWeakObjectPtr<UProperty>> CachePropItem;
 			typedef TMap<TWeakObjectPtr<UClass>, CachePropItem> CachePropMap;
 			
-			UFunction* findFunc(UClass* uclass, const char* fname);
 			UProperty* findProp(UClass* uclass, const char* pname);
-			void cacheFunc(UClass* uclass, const char* fname, UFunction* func);
 			void cacheProp(UClass* uclass, const char* pname, UProperty* prop);
-			void clear() {
-				cacheFuncMap.Empty();
-				cachePropMap.Empty();
-			}
+			// push lua table of uclass members to stack, table key is member name,
+			// value is ufunction closure or lightuserdata of uproperty
+			void pushMembers(lua_State* L, UClass* uclass, bool isStatic);
+			// get call plan of ufunction, create it if not exists
+			const LuaFunctionPlan* findPlan(UFunction* func);
+			void clear();
+
+			// uclass -> registry ref of members table
+			typedef TMap<TWeakObjectPtr<UClass>, int> CacheMemberMap;
+			typedef TMap<TWeakObjectPtr<UFunction>, LuaFunctionPlan*> CachePlanMap;
 
-			CacheFuncMap cacheFuncMap;
 			CachePropMap cachePropMap;
+			CacheMemberMap cacheMemberMap;
+			CacheMemberMap cacheStaticMemberMap;
+			CachePlanMap cachePlanMap;
 		} classMap;
 
-		FDeadLoopCheck* deadLoopCheck;
+		ScriptWatch* scriptWatch;
+		ScriptEntry currentEntry;
+		TArray<SlowScriptEvent> slowScripts;
 
 		// hold UObjects pushed to lua
-		UObjectRefMap objRefs;
+		LuaObjectRefs* objRefs;
 		// hold FGcObject to defer delete
 		TArray<FGCObject*> deferDelete;
+		// lua file path -> script class of LuaBase
+		TMap<FString, LuaScriptClass*> scriptClasses;
+		LuaChunkCache* chunkCache;
+		LuaGCScheduler* gcScheduler;
+		LuaJobRunner* jobRunner;
+		// reused by slua.pack and LuaVar::serialize on game thread
+		LuaSerializer* serializer;
+		bool usePoolAlloc;
+		LuaPoolAlloc* poolAlloc;
+		// heap accounted by LuaMemoryProfile::alloc, written by background gc too
+		std::atomic<size_t> memUsed;
+		size_t memSoftLimit;
+		size_t memHardLimit;
+		// raised over soft limit if heap still large after gc, avoid full gc every frame
+		size_t memSoftTrigger;
+		// heap exceed memSoftTrigger, handled on next tick
+		std::atomic<bool> memSoftHit;
+		// set by engine memory trim delegate
+		std::atomic<bool> memTrimPending;
+		FDelegateHandle mtHandler;
+		// lua function set by slua.setMemoryWarningHandler
+		LuaVar memoryWarningFunc;
+		void onMemoryTrim();
+		void checkMemory();
+		TSharedPtr<LuaPreloader, ESPMode::ThreadSafe> preloader;
+		TSharedPtr<LuaWorkerPool, ESPMode::ThreadSafe> workerPool;
+		// worker job id -> coroutine or callback waiting result
+		struct WorkerWait {
+			int32 threadId;
+			int callbackRef;
+		};
+		TMap<int32, WorkerWait> workerWaits;
+		TMap<FString, TSharedPtr<LuaPathHandle>> pathHandles;
+		// type id -> registry ref of its metatable, see LuaObject::pushMetatable
+		TArray<int32> typeMetatableRefs;
+		// cppbinding types waiting for bases to be finished, see LuaObject::finishType
+		TArray<uint32> pendingFlatTypes;
+		LuaWorkerPool* getWorkerPool();
+		void tickWorkers();
 		// store UGameInstance ptr to search LuaState
 		// we don't hold referrence
 		UGameInstance* pGI;
@@ -267,6 +464,13 @@ namespace NS_SLUA {
 		FDelegateHandle wcHandler;
 
 		bool enableMultiThreadGC;
+		// held by background gc task and entries into lua
+		FCriticalSection stateLock;
+		FGraphEventRef gcTask;
+		// background gc step dispatched but not run, guarded by stateLock
+		bool gcPending = false;
+		// game thread called into lua before background step run
+		bool gcSkipped = false;
 		LuaVar stateTickFunc;
 
         static LuaState* mainState;
@@ -276,8 +480,38 @@ namespace NS_SLUA {
 		TMap<FString, FString> debugStringMap;
         #endif
 
-		TMap<lua_State*, int> threadToRef;                                // coroutine -> ref
-		TMap<int, lua_State*> refToThread;                                // coroutine -> ref
+		enum WaitKind : uint8 {
+			WK_NONE,
+			WK_TIME,
+			WK_FRAME,
+		};
+		struct ThreadSlot {
+			lua_State* thread;
+			// increased when slot released, avoid resuming new thread by stale id
+			int32 generation;
+			// which wheel the coroutine is waiting on, and handle of the timer
+			WaitKind waitKind;
+			int32 waitHandle;
+		};
+		TArray<ThreadSlot> threadSlots;
+		TArray<int32> freeThreadSlots;
+		// table in registry, coroutine -> slot id, keep coroutine alive
+		int threadTableRef;
+		int32 makeThreadId(int32 index) const;
+		bool isThreadId(int32 threadId) const;
+		void freeThreadSlot(int32 index);
+		// timers of slua.wait in milliseconds, slua.waitFrames and slua.waitUntil in frames
+		LuaTimerWheel* timeWheel;
+		LuaTimerWheel* frameWheel;
+		double waitClock;
+		// see setStructView
+		bool structView;
+		// raise error if thread can't wait
+		void checkWait(lua_State *thread);
+		int prepareWait(lua_State *thread);
+		void cancelWait(ThreadSlot& slot);
+		void tickWaits(float dtime);
+		bool pollWaitUntil(int fnRef, bool& done);
 		ULatentDelegate* latentDelegate;
 
     };
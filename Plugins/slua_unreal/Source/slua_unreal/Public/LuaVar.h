@@ -101,7 +101,7 @@ namespace NS_SLUA {
         T* asUserdata(const char* t) const {
             auto L = getState();
             push(L);
-            UserData<T*>* ud = reinterpret_cast<UserData<T*>*>(luaL_testudata(L, -1, t));
+            UserData<T*>* ud = reinterpret_cast<UserData<T*>*>(LuaObject::testudataById(L, -1, LuaObject::typeIdOf(t)));
             lua_pop(L,1);
             return ud?ud->ud:nullptr;
         }
@@ -238,6 +238,12 @@ namespace NS_SLUA {
             return ret;
         }
 
+        // pack value(s) into compact binary, same format as slua.pack
+        // wrapped struct like FVector is supported, return false if value can't be packed
+        bool serialize(TArray<uint8>& out) const;
+        // unpack data from serialize or slua.pack, return tuple if more than one value
+        static LuaVar deserialize(lua_State* L, const uint8* buf, uint32 len);
+
         bool toProperty(UProperty* p,uint8* ptr);
         bool callByUFunction(UFunction* ufunc,uint8* parms,LuaVar* pSelf = nullptr,FOutParmRec* OutParms = nullptr);
 
@@ -339,7 +345,6 @@ namespace NS_SLUA {
         }
 
         int docall(int argn) const;
-        int pushArgByParms(UProperty* prop,uint8* parms);
 
         void clone(const LuaVar& other);
         void move(LuaVar&& other);
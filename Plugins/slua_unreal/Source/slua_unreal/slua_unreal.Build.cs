@@ -24,56 +24,13 @@ public class slua_unreal : ModuleRules
         bEnforceIWYU = false;
         bEnableUndefinedIdentifierWarnings = false;
 
-        var externalSource = Path.Combine(ModuleDirectory, "../../External");
-        var externalLib = Path.Combine(ModuleDirectory, "../../Library");
-
-        PublicIncludePaths.AddRange(
-            new string[] {
-                externalSource,
-                Path.Combine(externalSource, "lua"),
-				// ... add public include paths required here ...
-			}
-            );
-
-        if (Target.Platform == UnrealTargetPlatform.IOS)
-        {
-            PublicAdditionalLibraries.Add(Path.Combine(externalLib, "iOS/liblua.a"));
-        }
-        else if (Target.Platform == UnrealTargetPlatform.Android)
-        {
-#if UE_4_24_OR_LATER
-            PublicAdditionalLibraries.Add(Path.Combine(externalLib, "Android/armeabi-arm64/liblua.a"));
-            PublicAdditionalLibraries.Add(Path.Combine(externalLib, "Android/armeabi-v7a/liblua.a"));
-            PublicAdditionalLibraries.Add(Path.Combine(externalLib, "Android/x86/liblua.a"));
-#else
-            PublicLibraryPaths.Add(Path.Combine(externalLib, "Android/armeabi-arm64"));
-            PublicLibraryPaths.Add(Path.Combine(externalLib, "Android/armeabi-v7a"));
-            PublicLibraryPaths.Add(Path.Combine(externalLib, "Android/x86"));
-            PublicAdditionalLibraries.Add("lua");
-#endif
-        }
-        else if (Target.Platform == UnrealTargetPlatform.Win32 )
-        {
-            PublicAdditionalLibraries.Add(Path.Combine(externalLib, "Win32/lua.lib"));
-        }
-        else if (Target.Platform == UnrealTargetPlatform.Win64)
-        {
-            PublicAdditionalLibraries.Add(Path.Combine(externalLib, "Win64/lua.lib"));
-        }
-        else if (Target.Platform == UnrealTargetPlatform.Mac)
-        {
-            PublicAdditionalLibraries.Add(Path.Combine(externalLib, "Mac/liblua.a"));
-        }
-        else if (Target.Platform == UnrealTargetPlatform.Linux)
-        {
-            PublicAdditionalLibraries.Add(Path.Combine(externalLib, "Linux/liblua.a"));
-        }
-
     PublicDependencyModuleNames.AddRange(
             new string[]
             {
                 "Core",
 				"UMG",
+				// lua vm built from External
+				"slua_lua",
 				// ... add other public dependencies that you statically link with here ...
 			}
             );
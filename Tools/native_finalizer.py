@@ -0,0 +1,58 @@
+# Tencent is pleased to support the open source community by making sluaunreal available.
+
+# Copyright (C) 2018 THL A29 Limited, a Tencent company. All rights reserved.
+# Licensed under the BSD 3-Clause License (the "License");
+# you may not use this file except in compliance with the License. You may obtain a copy of the License at
+
+# https://opensource.org/licenses/BSD-3-Clause
+
+# Unless required by applicable law or agreed to in writing,
+# software distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and limitations under the License.
+
+# run it on LuaWrapper.cpp after lua-wrapper exported it,
+# __gc generated as lua_CFunction is replaced by native finalizer (LuaObject::UDFinalizer),
+# so wrapped structs are finalized in batch like other binding userdata,
+# finishType picks the overload by type of __gc, it's not changed
+#
+# usage: python native_finalizer.py [path/to/LuaWrapper.cpp]
+
+import os
+import re
+import sys
+
+GC_PATTERN = re.compile(
+    r'static int __gc\(lua_State\* L\) \{\n'
+    r'\t\t\tCheckSelf\((\w+)\);\n'
+    r'\t\t\tLuaObject::releaseLink\(L, udptr\);\n'
+    r'\t\t\tif \(udptr->flag & UD_AUTOGC\) delete self;\n'
+    r'\t\t\treturn 0;\n')
+
+GC_NATIVE = (
+    'static void __gc(lua_State* L, GenericUserData* ud) {\n'
+    '\t\t\tauto udptr = reinterpret_cast<UserData<{0}*>*>(ud);\n'
+    '\t\t\tif (udptr->flag & UD_HADFREE) return;\n'
+    '\t\t\tLuaObject::releaseLink(L, udptr);\n'
+    '\t\t\tif (udptr->flag & UD_AUTOGC) delete udptr->ud;\n')
+
+
+def main():
+    path = sys.argv[1] if len(sys.argv) > 1 else os.path.join(
+        os.path.dirname(os.path.abspath(__file__)),
+        '../Plugins/slua_unreal/Source/slua_unreal/Private/LuaWrapper.cpp')
+    with open(path, 'rb') as f:
+        text = f.read().decode('utf-8')
+    # generated body is LF, keep CRLF of license header as it is
+    text, count = GC_PATTERN.subn(lambda m: GC_NATIVE.replace('{0}', m.group(1)), text)
+    with open(path, 'wb') as f:
+        f.write(text.encode('utf-8'))
+    print('%d __gc replaced by native finalizer in %s' % (count, path))
+    if count == 0 and 'static int __gc(lua_State* L)' in text:
+        print('generated __gc not recognized, check lua-wrapper output')
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())